@@ -0,0 +1,1308 @@
+/**
+*	Headless culling benchmark for VDLIB.
+*	Builds the same teapot scene as the example viewer and replays a camera path through the cullers.
+*	Results are written to standard output as CSV.
+*	date:   16-Oct-2026
+*/
+
+#include <vdlib/BoxFactory.h>
+#include <vdlib/Statistics.h>
+#include <vdlib/SceneData.h>
+#include <vdlib/TreeBuilder.h>
+#include <vdlib/FrustumCuller.h>
+#include <vdlib/MultiFrustumCuller.h>
+#include <vdlib/BatchFrustumCuller.h>
+#include <vdlib/OcclusionCuller.h>
+#include <vdlib/SoftwareRasterizer.h>
+#include <vdlib/SoftwareQueryBackend.h>
+#include <vdlib/LatencyQueryBackend.h>
+#include <vdlib/FlatTree.h>
+#include <vdlib/TreeRefitter.h>
+#include <vdlib/Intersection.h>
+#include <vdlib/Geometry.h>
+#include <vdlib/Node.h>
+
+#include <vr/random.h>
+#include <vr/timer.h>
+#include <vector>
+#include <algorithm>
+#include "../example/Teapot.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+#include <cstdlib>
+
+/************************************************************************/
+/* Classes and types                                                    */
+/************************************************************************/
+
+// Per-frame measurements
+class FrameResult
+{
+public:
+	double cullTime;
+	int testedNodes; // Node boxes tested against the view frustum
+	int visibleNodes;
+	int visibleGeometries;
+	int queries;
+	int savedQueries;
+};
+
+typedef std::vector<FrameResult> FrameResultVector;
+
+// Hierarchy representation and traversal used for frustum culling
+enum FrustumMode
+{
+	Frustum_Node,
+	Frustum_FlatSkip,
+	Frustum_FlatBatch,
+	Frustum_FlatBatchGeometries,
+	Frustum_NodeParallel,
+	Frustum_FlatBatchParallel
+};
+
+// Occlusion culling benchmark rows
+class OcclusionRow
+{
+public:
+	const char* name;
+	bool flat;
+	vdlib::OcclusionCuller::TraversalMode mode;
+	float confidence;
+};
+
+// Collects ids of geometries in visible nodes whose own box also intersects the frustum.
+// Any hierarchy whose node boxes enclose the same geometry boxes gives the same ids.
+class GeometryIdCallback : public vdlib::IFrustumCallback
+{
+public:
+	void reset( const float* viewProj )
+	{
+		vdlib::FrustumCuller::extractPlanes( viewProj, _planes );
+		ids.clear();
+	}
+
+	virtual void inside( vdlib::Node* node )
+	{
+		const vdlib::GeometryVector& geometries = node->getGeometries();
+		for( unsigned int i = 0; i < geometries.size(); ++i )
+		{
+			bool outside = false;
+			for( int p = 0; p < 6 && !outside; ++p )
+				outside = ( vdlib::Intersection::between( _planes[p], geometries[i]->getBoundingBox() ) < 0 );
+
+			if( !outside )
+				ids.push_back( geometries[i]->getId() );
+		}
+	}
+
+	std::vector<int> ids;
+
+private:
+	vdlib::Plane _planes[6];
+};
+
+// Counts traversal results instead of rendering
+class CountCallback : public vdlib::IFrustumCallback
+{
+public:
+	void reset()
+	{
+		visibleNodes = 0;
+		visibleGeometries = 0;
+	}
+
+	virtual void inside( vdlib::Node* node )
+	{
+		++visibleNodes;
+		visibleGeometries += node->getGeometries().size();
+	}
+
+	// Same as above, without touching hierarchy nodes
+	virtual void inside( const vdlib::FlatTree& tree, int index )
+	{
+		++visibleNodes;
+		visibleGeometries += tree.getFlatNode( index ).geometryCount;
+	}
+
+	// Leaves crossing frustum boundaries, when geometry culling is enabled
+	virtual void insideGeometries( const vdlib::FlatTree& tree, int index, const std::vector<int>& geometries )
+	{
+		++visibleNodes;
+		visibleGeometries += geometries.size();
+	}
+
+	int visibleNodes;
+	int visibleGeometries;
+};
+
+// Renders visible teapots into the software depth buffer as occluders and counts traversal results
+class OcclusionCountCallback : public vdlib::IOcclusionCallback
+{
+public:
+	OcclusionCountCallback( vdlib::SoftwareRasterizer* rasterizer ) : _rasterizer( rasterizer ) {}
+
+	void reset( const vr::mat4f& viewProj )
+	{
+		_viewProj = viewProj;
+		testedNodes = 0;
+		visibleNodes = 0;
+		visibleGeometries = 0;
+	}
+
+	virtual void draw( vdlib::Node* node )
+	{
+		const vdlib::GeometryVector& geometries = node->getGeometries();
+
+		++visibleNodes;
+		for( unsigned int i = 0; i < geometries.size(); ++i )
+			drawGeometry( geometries[i]->getId() );
+	}
+
+	// Same as above, works with mapped trees
+	virtual void draw( const vdlib::FlatTree& tree, int index )
+	{
+		const vdlib::FlatTree::FlatNode& node = tree.getFlatNode( index );
+
+		++visibleNodes;
+		for( int i = 0; i < node.geometryCount; ++i )
+			drawGeometry( tree.getGeometryId( node.geometryStart + i ) );
+	}
+
+	// Called for every node the traversal visits, so the count includes nodes it then culls
+	virtual bool isValid( vdlib::Node* node )
+	{
+		++testedNodes;
+		return true;
+	}
+
+	virtual bool isValid( const vdlib::FlatTree& tree, int index )
+	{
+		++testedNodes;
+		return true;
+	}
+
+	int testedNodes;
+	int visibleNodes;
+	int visibleGeometries;
+
+private:
+	void drawGeometry( int id );
+
+	vdlib::SoftwareRasterizer* _rasterizer;
+	vr::mat4f _viewProj;
+};
+
+/************************************************************************/
+/* Global variables                                                     */
+/************************************************************************/
+
+// Scene parameters, same defaults as the example viewer
+static int s_geometryCount = 10;
+static float s_geometryScale = 5.0f;
+static unsigned int s_randomSeed = 1;
+static vdlib::BoxFactory::BoxType s_boxType = vdlib::BoxFactory::Type_Aabb;
+
+// Hierarchy split heuristic
+static vdlib::TreeBuilder::SplitHeuristic s_splitHeuristic = vdlib::TreeBuilder::Split_Average_Center;
+
+// Node bounds computation
+static vdlib::TreeBuilder::BoundsMode s_boundsMode = vdlib::TreeBuilder::Bounds_Vertices;
+
+// Parallel hierarchy construction, vertex cutoff (0 = sequential)
+static int s_parallelCutoff = 0;
+
+// How teapot vertices are sent to SceneData
+enum IngestMode
+{
+	Ingest_Vertices,  // Vertex array, each vertex once
+	Ingest_Triangles, // Unindexed triangle list, shared vertices repeated
+	Ingest_Indexed    // Triangle indices over shared vertices
+};
+static IngestMode s_ingestMode = Ingest_Vertices;
+
+// Teapot placement, also needed to render occluders when the hierarchy is loaded from cache
+static std::vector<vr::mat4f> s_geometryTransforms;
+
+// Teapot displacement applied by refit rows, and how many teapots move
+static std::vector<vr::vec3f> s_geometryMotion;
+static const int Moving_Geometry_Stride = 8;
+static const float Motion_Step = 0.1f;
+
+// Teapots in the scene during refit rows. The insert/remove row takes this many out each frame and puts them back the next.
+static std::vector<bool> s_geometryPresent;
+static const int Replaced_Geometry_Count = 4;
+
+// Teapot triangle list for software occlusion culling, converted from triangle strips
+static std::vector<int> s_teapotTriangles;
+
+// Simulated occlusion query latency, in backend calls (0 = results available immediately)
+static int s_queryLatency = 0;
+
+// Confidence used by occlusion_predicted rows, see OcclusionCuller::setPredictionConfidence()
+static float s_predictionConfidence = 0.9f;
+
+// Camera path, viewport is the same as the example viewer's default window
+static const int Viewport_Width = 640;
+static const int Viewport_Height = 480;
+static const float Stereo_Eye_Separation = 0.5f;
+static const char* s_pathFile = NULL;
+static int s_generatedFrameCount = 1000;
+static std::vector<vr::mat4f> s_cameraPath;
+static vr::mat4f s_projMatrix;
+
+// Optional per-frame output
+static const char* s_frameFile = NULL;
+
+// Optional hierarchy cache file
+static const char* s_cacheFile = NULL;
+
+// Scene columns of the CSV output (box,split,bounds,ingest,geometries), taken from the hierarchy description
+static char s_sceneColumns[vdlib::FlatTree::Description_Size];
+
+// Main hierarchy root
+static vr::ref_ptr<vdlib::Node> s_sceneRoot;
+static vdlib::TreeBuilder::Statistics s_treeStats;
+static vdlib::FlatTree s_flatTree;
+
+// Construction timings in milliseconds
+static double s_ingestTime = 0.0;
+static double s_buildTime = 0.0;
+
+// Memory allocated for scene vertices during ingestion, in megabytes
+static double s_vertexMemory = 0.0;
+
+// Sum of node and geometry box volumes, lower means tighter boxes
+static double s_nodeVolume = 0.0;
+static double s_geometryVolume = 0.0;
+
+// Size of the vertex array used to measure statistics throughput, in megabytes (0 = run culling benchmark)
+static int s_throughputSize = 0;
+
+// Number of views culled at once by the batch frustum culler (0 = run culling benchmark)
+static int s_viewBatchSize = 0;
+
+/************************************************************************/
+/* Utility functions                                                    */
+/************************************************************************/
+static void printUsage()
+{
+	std::cerr << "Usage: vdbench [options]" << std::endl
+	          << "  -n <count>     number of geometries (default 10)" << std::endl
+	          << "  -s <scale>     individual geometry scale (default 5)" << std::endl
+	          << "  -box aabb|obb|obb_tight  bounding box type (default aabb)" << std::endl
+	          << "  -refine <n>    local search iterations of obb_tight boxes (default 0)" << std::endl
+	          << "  -seed <value>  random seed for scene generation (default 1)" << std::endl
+	          << "  -split average|sah  hierarchy split heuristic (default average)" << std::endl
+	          << "  -bounds vertices|merged  node bounds from vertices or merged geometry boxes (default vertices)" << std::endl
+	          << "  -ingest vertices|triangles|indexed  send teapots as vertex array, unindexed triangles or indexed triangles (default vertices)" << std::endl
+	          << "  -parallel <n>  parallel hierarchy construction for nodes with at least n vertex floats (default off)" << std::endl
+	          << "  -throughput <mb>  only measure vertex statistics throughput in GB/s over an array of this size" << std::endl
+	          << "  -views <n>     only measure batch frustum culling throughput of n views, cycling through the camera path" << std::endl
+	          << "  -latency <n>   simulated occlusion query latency, in query backend calls (default 0)" << std::endl
+	          << "  -confidence <c>  query prediction confidence of occlusion_predicted rows (default 0.9)" << std::endl
+	          << "  -path <file>   camera path recorded by the viewer (default: generated fly-through)" << std::endl
+	          << "  -frames <n>    frame count for the generated fly-through (default 1000)" << std::endl
+	          << "  -out <file>    also write per-frame measurements as CSV" << std::endl
+	          << "  -cache <file>  map hierarchy from cache file if present, else build and write it." << std::endl
+	          << "                 A cache written with other scene options is rebuilt." << std::endl;
+}
+
+static bool parseArguments( int argc, char* argv[] )
+{
+	for( int i = 1; i < argc; ++i )
+	{
+		const char* arg = argv[i];
+		const char* value = ( i + 1 < argc ) ? argv[i+1] : NULL;
+
+		if( value == NULL )
+			return false;
+
+		if( strcmp( arg, "-n" ) == 0 )
+			s_geometryCount = atoi( value );
+		else if( strcmp( arg, "-s" ) == 0 )
+			s_geometryScale = (float)atof( value );
+		else if( strcmp( arg, "-seed" ) == 0 )
+			s_randomSeed = (unsigned int)atoi( value );
+		else if( strcmp( arg, "-parallel" ) == 0 )
+			s_parallelCutoff = atoi( value );
+		else if( strcmp( arg, "-throughput" ) == 0 )
+			s_throughputSize = atoi( value );
+		else if( strcmp( arg, "-views" ) == 0 )
+			s_viewBatchSize = atoi( value );
+		else if( strcmp( arg, "-latency" ) == 0 )
+			s_queryLatency = atoi( value );
+		else if( strcmp( arg, "-refine" ) == 0 )
+			vdlib::BoxFactory::setTightObbRefinement( atoi( value ) );
+		else if( strcmp( arg, "-confidence" ) == 0 )
+			s_predictionConfidence = (float)atof( value );
+		else if( strcmp( arg, "-path" ) == 0 )
+			s_pathFile = value;
+		else if( strcmp( arg, "-frames" ) == 0 )
+			s_generatedFrameCount = atoi( value );
+		else if( strcmp( arg, "-out" ) == 0 )
+			s_frameFile = value;
+		else if( strcmp( arg, "-cache" ) == 0 )
+			s_cacheFile = value;
+		else if( strcmp( arg, "-split" ) == 0 && strcmp( value, "average" ) == 0 )
+			s_splitHeuristic = vdlib::TreeBuilder::Split_Average_Center;
+		else if( strcmp( arg, "-split" ) == 0 && strcmp( value, "sah" ) == 0 )
+			s_splitHeuristic = vdlib::TreeBuilder::Split_Sah;
+		else if( strcmp( arg, "-bounds" ) == 0 && strcmp( value, "vertices" ) == 0 )
+			s_boundsMode = vdlib::TreeBuilder::Bounds_Vertices;
+		else if( strcmp( arg, "-bounds" ) == 0 && strcmp( value, "merged" ) == 0 )
+			s_boundsMode = vdlib::TreeBuilder::Bounds_Merged;
+		else if( strcmp( arg, "-ingest" ) == 0 && strcmp( value, "vertices" ) == 0 )
+			s_ingestMode = Ingest_Vertices;
+		else if( strcmp( arg, "-ingest" ) == 0 && strcmp( value, "triangles" ) == 0 )
+			s_ingestMode = Ingest_Triangles;
+		else if( strcmp( arg, "-ingest" ) == 0 && strcmp( value, "indexed" ) == 0 )
+			s_ingestMode = Ingest_Indexed;
+		else if( strcmp( arg, "-box" ) == 0 && strcmp( value, "aabb" ) == 0 )
+			s_boxType = vdlib::BoxFactory::Type_Aabb;
+		else if( strcmp( arg, "-box" ) == 0 && strcmp( value, "obb" ) == 0 )
+			s_boxType = vdlib::BoxFactory::Type_Obb;
+		else if( strcmp( arg, "-box" ) == 0 && strcmp( value, "obb_tight" ) == 0 )
+			s_boxType = vdlib::BoxFactory::Type_Obb_Tight;
+		else
+			return false;
+
+		++i;
+	}
+	return ( s_geometryCount > 0 );
+}
+
+static const char* splitHeuristicName()
+{
+	return ( s_splitHeuristic == vdlib::TreeBuilder::Split_Sah ) ? "sah" : "average";
+}
+
+static const char* boundsModeName()
+{
+	return ( s_boundsMode == vdlib::TreeBuilder::Bounds_Merged ) ? "merged" : "vertices";
+}
+
+static const char* ingestModeName()
+{
+	switch( s_ingestMode )
+	{
+	case Ingest_Triangles:
+		return "triangles";
+	case Ingest_Indexed:
+		return "indexed";
+	default:
+		return "vertices";
+	}
+}
+
+static const char* boxTypeName()
+{
+	switch( s_boxType )
+	{
+	case vdlib::BoxFactory::Type_Aabb:
+		return "aabb";
+	case vdlib::BoxFactory::Type_Obb:
+		return "obb";
+	case vdlib::BoxFactory::Type_Obb_Tight:
+		return "obb_tight";
+	default:
+		return "unknown";
+	}
+}
+
+// Options that determine the hierarchy, stored in its cache file.
+// Starts with the scene columns of the CSV output, followed by the options that only change teapot placement.
+static void sceneDescription( char* description )
+{
+	sprintf( description, "%s,%s,%s,%s,%d scale=%g seed=%u", boxTypeName(), splitHeuristicName(), boundsModeName(), ingestModeName(),
+	         s_geometryCount, s_geometryScale, s_randomSeed );
+}
+
+// Camera path file: one view matrix per line, 16 floats in OpenGL (column-major) order.
+// This is the format written by the example viewer when recording is active.
+static bool loadCameraPath( const char* filename )
+{
+	std::ifstream file( filename );
+	if( !file )
+		return false;
+
+	float values[16];
+	while( true )
+	{
+		for( int i = 0; i < 16; ++i )
+			file >> values[i];
+
+		if( !file )
+			break;
+
+		s_cameraPath.push_back( vr::mat4f( values ) );
+	}
+
+	return !s_cameraPath.empty();
+}
+
+// Deterministic fly-through: walk from the viewer's start position towards the far end of the scene
+// while slowly turning left and right, so that visibility changes every frame.
+static void generateCameraPath( int frameCount )
+{
+	s_cameraPath.resize( frameCount );
+
+	for( int i = 0; i < frameCount; ++i )
+	{
+		float t = (float)i / (float)vr::max( frameCount - 1, 1 );
+
+		vr::vec3f eye( 0.0f, 0.0f, 20.0f - 140.0f * t );
+		float angle = 0.75f * sinf( t * 4.0f * vr::Mathf::PI );
+		vr::vec3f center = eye + vr::vec3f( sinf( angle ), 0.0f, -cosf( angle ) );
+
+		s_cameraPath[i].makeLookAt( eye, center, vr::vec3f( 0.0f, 1.0f, 0.0f ) );
+	}
+}
+
+// Sum of box volumes
+static double totalVolume( const vdlib::BoxArray& boxes )
+{
+	double volume = 0.0;
+	for( int i = 0; i < boxes.size(); ++i )
+		volume += 8.0 * boxes.extents[0][i] * boxes.extents[1][i] * boxes.extents[2][i];
+	return volume;
+}
+
+// Returns value at given percentile [0,1] of already sorted values
+static double percentile( const std::vector<double>& sorted, double p )
+{
+	if( sorted.empty() )
+		return 0.0;
+
+	return sorted[(unsigned int)( p * (double)( sorted.size() - 1 ) )];
+}
+
+/************************************************************************/
+/* Main functions                                                       */
+/************************************************************************/
+
+// Same random teapot placement as createScene() in the example viewer
+static void createTransforms()
+{
+	vr::Random::seed( s_randomSeed );
+
+	vr::mat4f aux;
+	s_geometryTransforms.resize( s_geometryCount );
+
+	for( int i = 0; i < s_geometryCount; ++i )
+	{
+		vr::mat4f& transform = s_geometryTransforms[i];
+
+		// Constant scale
+		transform.makeScale( s_geometryScale, s_geometryScale, s_geometryScale );
+
+		// Random rotation in local coordinates
+		float angle = vr::Random::real( 0.0, 2.0 * vr::Mathd::PI );
+		aux.makeRotation( angle, vr::Random::realInIn(),
+			                     vr::Random::realInIn(),
+								 vr::Random::realInIn() );
+
+		transform.product( transform, aux );
+
+		// Random translation
+		aux.makeTranslation( vr::Random::real( -10.0,   10.0 ),
+							 vr::Random::real( -10.0,   10.0 ),
+							 vr::Random::real(   0.0, -100.0 ) );
+
+		transform.product( transform, aux );
+	}
+}
+
+// Convert teapot triangle strips to a triangle list, skipping degenerate triangles
+static void createTeapotTriangles()
+{
+	s_teapotTriangles.clear();
+
+	int stripStart = 0;
+	for( int i = 0; i < vdlib::NUM_TEAPOT_INDICES; ++i )
+	{
+		if( vdlib::TEAPOT_INDICES[i] == vdlib::STRIP_END )
+		{
+			stripStart = i + 1;
+			continue;
+		}
+
+		if( i - stripStart < 2 )
+			continue;
+
+		int a = vdlib::TEAPOT_INDICES[i-2];
+		int b = vdlib::TEAPOT_INDICES[i-1];
+		int c = vdlib::TEAPOT_INDICES[i];
+
+		if( a == b || b == c || a == c )
+			continue;
+
+		s_teapotTriangles.push_back( a );
+		s_teapotTriangles.push_back( b );
+		s_teapotTriangles.push_back( c );
+	}
+}
+
+// Same scene generation as createScene() in the example viewer
+static void createScene()
+{
+	vdlib::BoxFactory::setDefaultBoxType( s_boxType );
+
+	vr::Timer timer;
+	timer.restart();
+
+	// Triangle list in the form expected by each ingestion mode
+	std::vector<unsigned int> indices( s_teapotTriangles.begin(), s_teapotTriangles.end() );
+	std::vector<float> triangleVertices;
+	if( s_ingestMode == Ingest_Triangles )
+	{
+		triangleVertices.resize( s_teapotTriangles.size() * 3 );
+		for( unsigned int i = 0; i < s_teapotTriangles.size(); ++i )
+			std::copy( vdlib::TEAPOT_VERTICES + s_teapotTriangles[i] * 3, vdlib::TEAPOT_VERTICES + s_teapotTriangles[i] * 3 + 3, &triangleVertices[i*3] );
+	}
+
+	vdlib::SceneData sceneData;
+
+	sceneData.beginScene();
+	sceneData.setSharedVertices( vdlib::TEAPOT_VERTICES, vdlib::NUM_TEAPOT_VERTICES * 3 );
+
+	for( int i = 0; i < s_geometryCount; ++i )
+	{
+		vdlib::Geometry* geom = new vdlib::Geometry();
+		geom->setId( i );
+
+		switch( s_ingestMode )
+		{
+		case Ingest_Triangles:
+			sceneData.beginGeometry( geom );
+			sceneData.addVertices( &triangleVertices[0], (vr::int64)triangleVertices.size() );
+			break;
+		case Ingest_Indexed:
+			sceneData.beginGeometry( geom, &indices[0], (vr::int64)indices.size() );
+			break;
+		default:
+			sceneData.beginGeometry( geom );
+			sceneData.addVertices( vdlib::TEAPOT_VERTICES, vdlib::NUM_TEAPOT_VERTICES * 3 );
+			break;
+		}
+
+		sceneData.transformVertices( s_geometryTransforms[i].ptr() );
+		sceneData.endGeometry();
+	}
+
+	sceneData.endScene();
+
+	s_ingestTime = timer.restart() * 1000.0;
+	s_vertexMemory = (double)sceneData.getSceneNode()->getVertexPool().getCapacity() * sizeof( float ) / ( 1024.0 * 1024.0 );
+
+	// Build hierarchy
+	vdlib::TreeBuilder builder;
+	builder.setSplitHeuristic( s_splitHeuristic );
+	builder.setBoundsMode( s_boundsMode );
+	if( s_parallelCutoff > 0 )
+	{
+		builder.setParallelBuild( true );
+		builder.setParallelCutoff( s_parallelCutoff );
+	}
+	s_sceneRoot = builder.createTree( sceneData );
+	s_treeStats = builder.getStatistics();
+
+	s_buildTime = timer.elapsed() * 1000.0;
+
+	// Linear copy for flat traversals, not included in build time
+	s_flatTree.build( s_sceneRoot.get(), s_treeStats );
+
+	s_nodeVolume = totalVolume( s_flatTree.getBoxes() );
+	s_geometryVolume = totalVolume( s_flatTree.getGeometryBoxes() );
+}
+
+// Map previously written hierarchy instead of creating the scene.
+// Only flat traversals are possible, since there are no Node objects.
+static bool loadCachedScene()
+{
+	vr::Timer timer;
+	timer.restart();
+
+	if( !s_flatTree.load( s_cacheFile ) )
+		return false;
+
+	// Cache written for another scene: its statistics and geometry ids do not belong to this run
+	char description[vdlib::FlatTree::Description_Size];
+	sceneDescription( description );
+	if( strcmp( s_flatTree.getDescription(), description ) != 0 )
+	{
+		std::cerr << "Warning: hierarchy cache " << s_cacheFile << " was written for another scene ("
+		          << s_flatTree.getDescription() << "), rebuilding it" << std::endl;
+		s_flatTree.clear();
+		return false;
+	}
+
+	// Geometry ids index teapot placements when rendering occluders
+	for( int i = 0; i < s_flatTree.getGeometryCount(); ++i )
+	{
+		const int id = s_flatTree.getGeometryId( i );
+		if( id < 0 || id >= (int)s_geometryTransforms.size() )
+		{
+			std::cerr << "Warning: hierarchy cache " << s_cacheFile << " has invalid geometry ids, rebuilding it" << std::endl;
+			s_flatTree.clear();
+			return false;
+		}
+	}
+
+	s_treeStats = s_flatTree.getStatistics();
+	s_ingestTime = 0.0;
+	s_vertexMemory = 0.0;
+	s_buildTime = timer.elapsed() * 1000.0;
+
+	s_nodeVolume = totalVolume( s_flatTree.getBoxes() );
+	s_geometryVolume = totalVolume( s_flatTree.getGeometryBoxes() );
+	return true;
+}
+
+static void runFrustumCulling( FrameResultVector& results, FrustumMode mode )
+{
+	vdlib::FrustumCuller culler;
+	culler.init( s_treeStats );
+	culler.setBatchTesting( mode == Frustum_FlatBatch || mode == Frustum_FlatBatchGeometries || mode == Frustum_FlatBatchParallel );
+	culler.setGeometryCulling( mode == Frustum_FlatBatchGeometries );
+	culler.setParallelTraversal( mode == Frustum_NodeParallel || mode == Frustum_FlatBatchParallel );
+
+	CountCallback callback;
+	vr::mat4f viewProj;
+	vr::Timer timer;
+
+	results.resize( s_cameraPath.size() );
+
+	for( unsigned int i = 0; i < s_cameraPath.size(); ++i )
+	{
+		callback.reset();
+
+		timer.restart();
+		viewProj.product( s_cameraPath[i], s_projMatrix );
+		culler.updateFrustumPlanes( viewProj.ptr() );
+		if( mode == Frustum_Node || mode == Frustum_NodeParallel )
+			culler.traverse( s_sceneRoot.get(), &callback );
+		else
+			culler.traverse( s_flatTree, &callback );
+		results[i].cullTime = timer.elapsed() * 1000.0;
+
+		results[i].testedNodes = culler.getTestedNodeCount();
+		results[i].visibleNodes = callback.visibleNodes;
+		results[i].visibleGeometries = callback.visibleGeometries;
+		results[i].queries = 0;
+		results[i].savedQueries = 0;
+	}
+}
+
+// Stereo pair culled by one frustum culler per eye, or by a single multi-frustum traversal
+static void runStereoCulling( FrameResultVector& results, bool multi )
+{
+	vdlib::FrustumCuller cullers[2];
+	cullers[0].init( s_treeStats );
+	cullers[1].init( s_treeStats );
+
+	vdlib::MultiFrustumCuller multiCuller;
+	multiCuller.setViewCount( 2 );
+
+	CountCallback callback;
+	vr::mat4f eyeOffset;
+	vr::mat4f eyeView;
+	vr::mat4f viewProj;
+	vr::Timer timer;
+
+	results.resize( s_cameraPath.size() );
+
+	for( unsigned int i = 0; i < s_cameraPath.size(); ++i )
+	{
+		callback.reset();
+
+		timer.restart();
+		for( int eye = 0; eye < 2; ++eye )
+		{
+			eyeOffset.makeTranslation( ( eye == 0 ? 0.5f : -0.5f ) * Stereo_Eye_Separation, 0.0f, 0.0f );
+			eyeView.product( s_cameraPath[i], eyeOffset );
+			viewProj.product( eyeView, s_projMatrix );
+
+			if( multi )
+			{
+				multiCuller.updateFrustumPlanes( eye, viewProj.ptr() );
+			}
+			else
+			{
+				cullers[eye].updateFrustumPlanes( viewProj.ptr() );
+				cullers[eye].traverse( s_flatTree, &callback );
+			}
+		}
+
+		if( multi )
+		{
+			multiCuller.traverse( s_flatTree );
+			for( int eye = 0; eye < 2; ++eye )
+			{
+				const std::vector<int>& visible = multiCuller.getVisibleIndices( eye );
+				for( unsigned int n = 0; n < visible.size(); ++n )
+					callback.inside( s_flatTree, visible[n] );
+			}
+		}
+		results[i].cullTime = timer.elapsed() * 1000.0;
+
+		results[i].testedNodes = multi ? multiCuller.getTestedNodeCount() : cullers[0].getTestedNodeCount() + cullers[1].getTestedNodeCount();
+		results[i].visibleNodes = callback.visibleNodes;
+		results[i].visibleGeometries = callback.visibleGeometries;
+		results[i].queries = 0;
+		results[i].savedQueries = 0;
+	}
+}
+
+// Geometries are drawn in object space, with their placement combined into the view-projection
+void OcclusionCountCallback::drawGeometry( int id )
+{
+	vr::mat4f modelViewProj;
+	modelViewProj.product( s_geometryTransforms[id], _viewProj );
+
+	_rasterizer->setViewProjection( modelViewProj.ptr() );
+	_rasterizer->drawTriangles( vdlib::TEAPOT_VERTICES, &s_teapotTriangles[0], (int)s_teapotTriangles.size() );
+	_rasterizer->setViewProjection( _viewProj.ptr() );
+
+	++visibleGeometries;
+}
+
+// Coherent Hierarchical Culling with software queries, cull time includes occluder rasterization
+static void runOcclusionCulling( FrameResultVector& results, const OcclusionRow& row )
+{
+	vdlib::SoftwareRasterizer rasterizer;
+	rasterizer.setViewport( Viewport_Width, Viewport_Height );
+
+	vdlib::SoftwareQueryBackend softwareBackend( &rasterizer );
+	vdlib::LatencyQueryBackend latencyBackend( &softwareBackend, s_queryLatency );
+
+	vdlib::OcclusionCuller culler;
+	culler.setTraversalMode( row.mode );
+	culler.setPredictionConfidence( row.confidence );
+	if( s_queryLatency > 0 )
+		culler.setQueryBackend( &latencyBackend );
+	else
+		culler.setQueryBackend( &softwareBackend );
+	culler.init( s_treeStats );
+
+	OcclusionCountCallback callback( &rasterizer );
+	vr::mat4f viewProj;
+	vr::Timer timer;
+
+	results.resize( s_cameraPath.size() );
+
+	for( unsigned int i = 0; i < s_cameraPath.size(); ++i )
+	{
+		timer.restart();
+		viewProj.product( s_cameraPath[i], s_projMatrix );
+		callback.reset( viewProj );
+		rasterizer.setViewProjection( viewProj.ptr() );
+		rasterizer.clear();
+		culler.updateViewerParameters( s_cameraPath[i].ptr(), s_projMatrix.ptr() );
+		if( row.flat )
+			culler.traverse( s_flatTree, &callback );
+		else
+			culler.traverse( s_sceneRoot.get(), &callback );
+		results[i].cullTime = timer.elapsed() * 1000.0;
+
+		results[i].testedNodes = callback.testedNodes;
+		results[i].visibleNodes = callback.visibleNodes;
+		results[i].visibleGeometries = callback.visibleGeometries;
+		results[i].queries = culler.getQueryCount();
+		results[i].savedQueries = culler.getSavedQueryCount();
+	}
+}
+
+// Hierarchy built from scratch over the teapots at their moved positions.
+// Node boxes are merged from geometry boxes, so that they enclose them like refit node boxes do.
+static vr::ref_ptr<vdlib::Node> createMovedScene( vdlib::TreeBuilder::Statistics& stats )
+{
+	vdlib::SceneData sceneData;
+	vr::mat4f translation;
+	vr::mat4f transform;
+
+	sceneData.beginScene();
+	sceneData.setSharedVertices( vdlib::TEAPOT_VERTICES, vdlib::NUM_TEAPOT_VERTICES * 3 );
+
+	for( int i = 0; i < s_geometryCount; ++i )
+	{
+		if( !s_geometryPresent[i] )
+			continue;
+
+		vdlib::Geometry* geom = new vdlib::Geometry();
+		geom->setId( i );
+
+		translation.makeTranslation( s_geometryMotion[i] );
+		transform.product( s_geometryTransforms[i], translation );
+
+		sceneData.beginGeometry( geom );
+		sceneData.addVertices( vdlib::TEAPOT_VERTICES, vdlib::NUM_TEAPOT_VERTICES * 3 );
+		sceneData.transformVertices( transform.ptr() );
+		sceneData.endGeometry();
+	}
+
+	sceneData.endScene();
+
+	vdlib::TreeBuilder builder;
+	builder.setSplitHeuristic( s_splitHeuristic );
+	builder.setBoundsMode( vdlib::TreeBuilder::Bounds_Merged );
+	vr::ref_ptr<vdlib::Node> root = builder.createTree( sceneData );
+	stats = builder.getStatistics();
+	return root;
+}
+
+// Number of camera path frames where both hierarchies find different visible geometries
+static int compareVisibleGeometries( vdlib::Node* root, const vdlib::TreeBuilder::Statistics& stats,
+                                     vdlib::Node* reference, const vdlib::TreeBuilder::Statistics& referenceStats )
+{
+	vdlib::FrustumCuller culler;
+	vdlib::FrustumCuller referenceCuller;
+	culler.init( stats );
+	referenceCuller.init( referenceStats );
+
+	GeometryIdCallback callback;
+	GeometryIdCallback referenceCallback;
+	vr::mat4f viewProj;
+	int differentFrames = 0;
+
+	for( unsigned int i = 0; i < s_cameraPath.size(); ++i )
+	{
+		viewProj.product( s_cameraPath[i], s_projMatrix );
+
+		callback.reset( viewProj.ptr() );
+		culler.updateFrustumPlanes( viewProj.ptr() );
+		culler.traverse( root, &callback );
+
+		referenceCallback.reset( viewProj.ptr() );
+		referenceCuller.updateFrustumPlanes( viewProj.ptr() );
+		referenceCuller.traverse( reference, &referenceCallback );
+
+		std::sort( callback.ids.begin(), callback.ids.end() );
+		std::sort( referenceCallback.ids.begin(), referenceCallback.ids.end() );
+		if( callback.ids != referenceCallback.ids )
+			++differentFrames;
+	}
+
+	return differentFrames;
+}
+
+// Some teapots drift every frame and their own hierarchy is refit, cull time includes refit.
+// Optionally, a few teapots are also removed and inserted back every frame: the culler is then initialized again
+// with the node capacity and the changed ids are reset, as clients of TreeRefitter must do.
+// Afterwards, visible geometries along the path are compared against a hierarchy built from scratch.
+static bool runRefitCulling( FrameResultVector& results, bool insertRemove )
+{
+	s_geometryMotion.assign( s_geometryCount, vr::vec3f( 0.0f, 0.0f, 0.0f ) );
+	s_geometryPresent.assign( s_geometryCount, true );
+
+	vdlib::TreeBuilder::Statistics stats;
+	vr::ref_ptr<vdlib::Node> root = createMovedScene( stats );
+
+	// Removed geometries are kept alive here
+	vdlib::GeometryVector geometries( s_geometryCount );
+	for( vdlib::PreOrderIterator it( root.get() ); !it.done(); it.next() )
+	{
+		vdlib::GeometryVector& leafGeometries = it->getGeometries();
+		for( unsigned int g = 0; g < leafGeometries.size(); ++g )
+			geometries[leafGeometries[g]->getId()] = leafGeometries[g];
+	}
+
+	const int replacedCount = insertRemove ? vr::min( Replaced_Geometry_Count, s_geometryCount ) : 0;
+	std::vector<int> removed;
+	std::vector<int> changedIds;
+
+	vdlib::TreeRefitter refitter;
+	refitter.init( root.get() );
+
+	vdlib::FrustumCuller culler;
+	culler.init( stats );
+
+	CountCallback callback;
+	vr::mat4f viewProj;
+	vr::Timer timer;
+
+	results.resize( s_cameraPath.size() );
+
+	for( unsigned int i = 0; i < s_cameraPath.size(); ++i )
+	{
+		callback.reset();
+
+		timer.restart();
+		if( replacedCount > 0 )
+		{
+			for( unsigned int r = 0; r < removed.size(); ++r )
+			{
+				refitter.insertGeometry( geometries[removed[r]].get() );
+				s_geometryPresent[removed[r]] = true;
+			}
+
+			removed.clear();
+			for( int r = 0; r < replacedCount; ++r )
+			{
+				const int g = ( i * replacedCount + r ) % s_geometryCount;
+				refitter.removeGeometry( geometries[g].get() );
+				s_geometryPresent[g] = false;
+				removed.push_back( g );
+			}
+		}
+
+		for( int g = 0; g < s_geometryCount; g += Moving_Geometry_Stride )
+		{
+			if( !s_geometryPresent[g] )
+				continue;
+
+			// Sideways oscillation, different phase for each teapot
+			const float phase = 0.05f * (float)i + (float)g;
+			const vr::vec3f step( Motion_Step * cosf( phase ), Motion_Step * sinf( phase ), 0.0f );
+
+			vdlib::Box box = geometries[g]->getBoundingBox();
+			box.center += step;
+			refitter.updateGeometry( geometries[g].get(), box );
+			s_geometryMotion[g] += step;
+		}
+		refitter.refit();
+
+		if( replacedCount > 0 )
+		{
+			stats.nodeCount = refitter.getNodeCapacity();
+			culler.init( stats );
+			refitter.takeChangedIds( changedIds );
+			culler.resetNodes( changedIds );
+		}
+
+		viewProj.product( s_cameraPath[i], s_projMatrix );
+		culler.updateFrustumPlanes( viewProj.ptr() );
+		culler.traverse( root.get(), &callback );
+		results[i].cullTime = timer.elapsed() * 1000.0;
+
+		results[i].testedNodes = culler.getTestedNodeCount();
+		results[i].visibleNodes = callback.visibleNodes;
+		results[i].visibleGeometries = callback.visibleGeometries;
+		results[i].queries = 0;
+		results[i].savedQueries = 0;
+	}
+
+	vdlib::TreeBuilder::Statistics referenceStats;
+	vr::ref_ptr<vdlib::Node> reference = createMovedScene( referenceStats );
+
+	stats.nodeCount = refitter.getNodeCapacity();
+	const int differentFrames = compareVisibleGeometries( root.get(), stats, reference.get(), referenceStats );
+	if( differentFrames > 0 )
+	{
+		std::cerr << "Error: " << ( insertRemove ? "refit_insert_remove" : "refit" ) << " hierarchy finds different visible geometries than a rebuilt one in "
+		          << differentFrames << " frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static void printSummaryHeader()
+{
+	std::cout << "algorithm,box,split,bounds,ingest,geometries,frames,ingest_ms,vertex_mb,build_ms,nodes,leaves,depth,sah_cost,node_volume,geometry_volume,"
+	          << "cull_p50_ms,cull_p90_ms,cull_p99_ms,cull_max_ms,"
+	          << "avg_tested_nodes,avg_visible_nodes,avg_visible_geometries,avg_queries,avg_saved_queries" << std::endl;
+}
+
+static void printSummary( const char* algorithm, const FrameResultVector& results )
+{
+	std::vector<double> times( results.size() );
+	double tested = 0.0;
+	double visibleNodes = 0.0;
+	double visibleGeometries = 0.0;
+	double queries = 0.0;
+	double savedQueries = 0.0;
+
+	for( unsigned int i = 0; i < results.size(); ++i )
+	{
+		times[i] = results[i].cullTime;
+		tested += results[i].testedNodes;
+		visibleNodes += results[i].visibleNodes;
+		visibleGeometries += results[i].visibleGeometries;
+		queries += results[i].queries;
+		savedQueries += results[i].savedQueries;
+	}
+
+	std::sort( times.begin(), times.end() );
+
+	double invCount = results.empty() ? 0.0 : 1.0 / (double)results.size();
+
+	printf( "%s,%s,%u,%.3f,%.1f,%.3f,%d,%d,%d,%.2f,%.1f,%.1f,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+	        algorithm, s_sceneColumns, (unsigned int)results.size(),
+	        s_ingestTime, s_vertexMemory, s_buildTime, s_treeStats.nodeCount, s_treeStats.leafCount, s_treeStats.treeDepth, s_treeStats.sahCost,
+	        s_nodeVolume, s_geometryVolume,
+	        percentile( times, 0.5 ), percentile( times, 0.9 ), percentile( times, 0.99 ), percentile( times, 1.0 ),
+	        tested * invCount, visibleNodes * invCount, visibleGeometries * invCount, queries * invCount, savedQueries * invCount );
+}
+
+// Statistics kernels measured by runThroughput()
+enum StatisticsKernel
+{
+	Kernel_MinMax,
+	Kernel_MinMaxParallel,
+	Kernel_AverageCovariance,
+	Kernel_AxisMinMax
+};
+
+// Best time of a few repetitions, so that the first pass does not include page faults
+static double measureKernel( StatisticsKernel kernel, const vdlib::VertexRange& range )
+{
+	const vr::int64 sequentialThreshold = vdlib::Statistics::getParallelThreshold();
+	if( kernel == Kernel_MinMax )
+		vdlib::Statistics::setParallelThreshold( (vr::int64)1 << 62 );
+	else if( kernel == Kernel_MinMaxParallel )
+		vdlib::Statistics::setParallelThreshold( 0 );
+
+	vdlib::MinMax minMax;
+	vr::vec3f average;
+	float covariance[3][3];
+	vr::vec3f axis[3] = { vr::vec3f::UNIT_X(), vr::vec3f::UNIT_Y(), vr::vec3f::UNIT_Z() };
+
+	vr::Timer timer;
+	double best = 0.0;
+
+	for( int repeat = 0; repeat < 5; ++repeat )
+	{
+		timer.restart();
+		switch( kernel )
+		{
+		case Kernel_AverageCovariance:
+			vdlib::Statistics::averageAndCovariance( average, covariance, &range, 1 );
+			break;
+		case Kernel_AxisMinMax:
+			vdlib::Statistics::axisMinMaxValues( minMax, axis, vr::vec3f( 0.0f, 0.0f, 0.0f ), &range, 1 );
+			break;
+		default:
+			vdlib::Statistics::minMaxVertices( minMax, &range, 1 );
+			break;
+		}
+		double elapsed = timer.elapsed() * 1000.0;
+
+		if( repeat == 0 || elapsed < best )
+			best = elapsed;
+	}
+
+	vdlib::Statistics::setParallelThreshold( sequentialThreshold );
+	return best;
+}
+
+// Vertex statistics throughput, as used by box fitting
+static void runThroughput()
+{
+	std::vector<float> vertices( (size_t)s_throughputSize * 1024 * 1024 / sizeof( float ) / 3 * 3 );
+
+	vr::Random::seed( s_randomSeed );
+	for( unsigned int i = 0; i < vertices.size(); ++i )
+		vertices[i] = (float)vr::Random::real( -100.0, 100.0 );
+
+	vdlib::VertexRange range;
+	range.vertices = &vertices[0];
+	range.size = (vr::int64)vertices.size();
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	const char* names[] = { "minmax", "minmax_parallel", "average_covariance", "axis_minmax" };
+	const double gigabytes = (double)vertices.size() * sizeof( float ) / ( 1024.0 * 1024.0 * 1024.0 );
+
+	std::cout << "kernel,threads,mb,best_ms,gb_per_s" << std::endl;
+
+	for( int kernel = Kernel_MinMax; kernel <= Kernel_AxisMinMax; ++kernel )
+	{
+		double ms = measureKernel( (StatisticsKernel)kernel, range );
+		printf( "%s,%d,%d,%.3f,%.2f\n", names[kernel], ( kernel == Kernel_MinMaxParallel ) ? threads : 1,
+		        s_throughputSize, ms, ( ms > 0.0 ) ? gigabytes / ( ms / 1000.0 ) : 0.0 );
+	}
+}
+
+// Cull many views at once against the shared linear hierarchy, as a visibility server would
+static void runViewBatch()
+{
+	std::vector<float> matrices( (size_t)s_viewBatchSize * 16 );
+	vr::mat4f viewProj;
+
+	for( int v = 0; v < s_viewBatchSize; ++v )
+	{
+		viewProj.product( s_cameraPath[v % s_cameraPath.size()], s_projMatrix );
+		std::copy( viewProj.ptr(), viewProj.ptr() + 16, &matrices[16 * v] );
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	// Best of several runs
+	vdlib::BatchFrustumCuller culler;
+	double bestMs = 0.0;
+	for( int run = 0; run < 5; ++run )
+	{
+		culler.cull( s_flatTree, &matrices[0], s_viewBatchSize );
+		if( run == 0 || culler.getCullTime() < bestMs )
+			bestMs = culler.getCullTime();
+	}
+
+	double ranges = 0.0;
+	double rangeNodes = 0.0;
+	for( int v = 0; v < s_viewBatchSize; ++v )
+	{
+		const vdlib::VisibleRange* visible = culler.getRanges( v );
+		ranges += culler.getRangeCount( v );
+		for( int r = 0; r < culler.getRangeCount( v ); ++r )
+			rangeNodes += visible[r].end - visible[r].begin;
+	}
+
+	std::cout << "views,threads,nodes,best_ms,views_per_s,avg_ranges,avg_range_nodes" << std::endl;
+	printf( "%d,%d,%d,%.3f,%.1f,%.1f,%.1f\n", s_viewBatchSize, threads, s_flatTree.getNodeCount(), bestMs,
+	        ( bestMs > 0.0 ) ? s_viewBatchSize / ( bestMs / 1000.0 ) : 0.0, ranges / s_viewBatchSize, rangeNodes / s_viewBatchSize );
+}
+
+static void writeFrames( std::ofstream& file, const char* algorithm, const FrameResultVector& results )
+{
+	for( unsigned int i = 0; i < results.size(); ++i )
+	{
+		file << algorithm << "," << i << "," << results[i].cullTime << "," << results[i].testedNodes << ","
+		     << results[i].visibleNodes << "," << results[i].visibleGeometries << "," << results[i].queries << "," << results[i].savedQueries << std::endl;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Main entry point
+//////////////////////////////////////////////////////////////////////////
+int main( int argc, char* argv[] )
+{
+	if( !parseArguments( argc, argv ) )
+	{
+		printUsage();
+		return 1;
+	}
+
+	if( s_throughputSize > 0 )
+	{
+		runThroughput();
+		return 0;
+	}
+
+	// Camera path
+	if( s_pathFile != NULL )
+	{
+		if( !loadCameraPath( s_pathFile ) )
+		{
+			std::cerr << "Error: could not read camera path from " << s_pathFile << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		generateCameraPath( s_generatedFrameCount );
+	}
+
+	// Same projection as the example viewer's default window
+	s_projMatrix.makePerspective( 65.0, (double)Viewport_Width / (double)Viewport_Height, 0.1, 1000.0 );
+
+	createTransforms();
+	createTeapotTriangles();
+
+	if( s_cacheFile == NULL || !loadCachedScene() )
+	{
+		createScene();
+
+		char description[vdlib::FlatTree::Description_Size];
+		sceneDescription( description );
+		s_flatTree.setDescription( description );
+
+		if( s_cacheFile != NULL && !s_flatTree.save( s_cacheFile ) )
+			std::cerr << "Warning: could not write hierarchy cache to " << s_cacheFile << std::endl;
+	}
+
+	// Rows are labeled with the scene the hierarchy was built for
+	strcpy( s_sceneColumns, s_flatTree.getDescription() );
+	char* placementOptions = strchr( s_sceneColumns, ' ' );
+	if( placementOptions != NULL )
+		*placementOptions = '\0';
+
+	if( s_viewBatchSize > 0 )
+	{
+		runViewBatch();
+		return 0;
+	}
+
+	std::ofstream frameFile;
+	if( s_frameFile != NULL )
+	{
+		frameFile.open( s_frameFile );
+		frameFile << "algorithm,frame,cull_ms,tested_nodes,visible_nodes,visible_geometries,queries,saved_queries" << std::endl;
+	}
+
+	printSummaryHeader();
+
+	FrameResultVector results;
+
+	const char* frustumNames[] = { "frustum", "frustum_flat", "frustum_batch", "frustum_batch_geometry", "frustum_parallel", "frustum_batch_parallel" };
+
+	for( int mode = Frustum_Node; mode <= Frustum_FlatBatchParallel; ++mode )
+	{
+		if( ( mode == Frustum_Node || mode == Frustum_NodeParallel ) && !s_sceneRoot.valid() )
+			continue;
+
+		runFrustumCulling( results, (FrustumMode)mode );
+		printSummary( frustumNames[mode], results );
+		if( frameFile.is_open() )
+			writeFrames( frameFile, frustumNames[mode], results );
+	}
+
+	const char* stereoNames[] = { "frustum_stereo", "frustum_multi_stereo" };
+
+	for( int multi = 0; multi < 2; ++multi )
+	{
+		runStereoCulling( results, multi != 0 );
+		printSummary( stereoNames[multi], results );
+		if( frameFile.is_open() )
+			writeFrames( frameFile, stereoNames[multi], results );
+	}
+
+	const char* refitNames[] = { "refit", "refit_insert_remove" };
+
+	bool valid = true;
+	for( int insertRemove = 0; insertRemove < 2; ++insertRemove )
+	{
+		if( !runRefitCulling( results, insertRemove != 0 ) )
+			valid = false;
+
+		printSummary( refitNames[insertRemove], results );
+		if( frameFile.is_open() )
+			writeFrames( frameFile, refitNames[insertRemove], results );
+	}
+
+	const OcclusionRow occlusionRows[] =
+	{
+		{ "occlusion",                false, vdlib::OcclusionCuller::Traversal_Chc,          1.0f },
+		{ "occlusion_flat",           true,  vdlib::OcclusionCuller::Traversal_Chc,          1.0f },
+		{ "occlusion_chcpp",          false, vdlib::OcclusionCuller::Traversal_ChcPlusPlus,  1.0f },
+		{ "occlusion_chcpp_flat",     true,  vdlib::OcclusionCuller::Traversal_ChcPlusPlus,  1.0f },
+		{ "occlusion_nohc",           false, vdlib::OcclusionCuller::Traversal_NearOptimal,  1.0f },
+		{ "occlusion_nohc_flat",      true,  vdlib::OcclusionCuller::Traversal_NearOptimal,  1.0f },
+		{ "occlusion_predicted",      false, vdlib::OcclusionCuller::Traversal_Chc,          s_predictionConfidence },
+		{ "occlusion_predicted_flat", true,  vdlib::OcclusionCuller::Traversal_Chc,          s_predictionConfidence }
+	};
+
+	for( unsigned int row = 0; row < sizeof( occlusionRows ) / sizeof( occlusionRows[0] ); ++row )
+	{
+		if( !occlusionRows[row].flat && !s_sceneRoot.valid() )
+			continue;
+
+		runOcclusionCulling( results, occlusionRows[row] );
+		printSummary( occlusionRows[row].name, results );
+		if( frameFile.is_open() )
+			writeFrames( frameFile, occlusionRows[row].name, results );
+	}
+
+	return valid ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 #include <vdlib/TreeBuilder.h>
 #include <vdlib/FrustumCuller.h>
 #include <vdlib/OcclusionCuller.h>
+#include <vdlib/OpenGLQueryBackend.h>
 
 #include <vr/random.h>
 #include <vr/timer.h>
@@ -21,6 +22,7 @@
 #include <gl/wglew.h>
 
 #include <iostream>
+#include <fstream>
 
 /************************************************************************/
 /* Classes and types                                                    */
@@ -131,6 +133,7 @@ static vr::ref_ptr<vdlib::Node> s_sceneRoot;
 // Acceleration algorithms
 static vdlib::FrustumCuller   s_frustumCuller;
 static vdlib::OcclusionCuller s_occlusionCuller;
+static vdlib::OpenGLQueryBackend s_queryBackend;
 
 // My rendering callback
 static RenderCallback s_renderCallback;
@@ -163,6 +166,10 @@ static double s_lastRenderTime = 0.0;
 // Miscellaneous
 static bool s_wireframeActive = false;
 
+// Camera path recording for the benchmark
+static const char* s_cameraPathFile = "camera.path";
+static std::ofstream s_cameraPathStream;
+
 /************************************************************************/
 /* Utility functions                                                    */
 /************************************************************************/
@@ -314,6 +321,17 @@ static void updateCameraMovement()
 	moveCamera( translationMatrix );
 }
 
+static void recordCameraPath()
+{
+	if( !s_cameraPathStream.is_open() )
+		return;
+
+	// One view matrix per line, 16 floats in OpenGL order
+	const float* matrix = s_viewMatrix.ptr();
+	for( unsigned int i = 0; i < 16; ++i )
+		s_cameraPathStream << matrix[i] << ( i < 15 ? " " : "\n" );
+}
+
 static void displayTextLine( const char* s, float x, float y )
 {
 	glRasterPos3d( x, y, 0.8 );
@@ -364,6 +382,10 @@ static void displayScreenMessage()
 
 	displayTextLine( debugString.toCharArray(), -0.95f, 0.70f );
 
+	// Show camera path recording
+	if( s_cameraPathStream.is_open() )
+		displayTextLine( "Recording camera path", -0.95f, 0.60f );
+
 	glEnable( GL_DEPTH_TEST );
 	glEnable( GL_LIGHTING );
 	glMatrixMode( GL_PROJECTION );
@@ -454,6 +476,7 @@ static void createScene()
 
 	// Get stats and setup frustum & occlusion culling
 	s_frustumCuller.init( builder.getStatistics() );
+	s_occlusionCuller.setQueryBackend( &s_queryBackend );
 	s_occlusionCuller.init( builder.getStatistics() );
 }
 
@@ -535,6 +558,7 @@ static void display()
 
 	// Set view matrix
 	updateCameraMovement();
+	recordCameraPath();
 
 	// Draw scene
 	drawScene();
@@ -682,6 +706,14 @@ static void keyDown( unsigned char key, int x, int y )
 			break;
 		}
 
+	// Camera path recording
+	case 'p':
+		if( s_cameraPathStream.is_open() )
+			s_cameraPathStream.close();
+		else
+			s_cameraPathStream.open( s_cameraPathFile );
+		break;
+
 	// Space key: reset viewer
 	case 32:
 		resetCamera();
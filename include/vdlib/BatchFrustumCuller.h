@@ -0,0 +1,83 @@
+/**
+*	Culls a batch of views in parallel against one shared, read-only linear hierarchy.
+*	Meant for servers computing visibility for many clients at once: unlike FrustumCuller,
+*	there is no per-node state, so memory does not grow with clients times nodes.
+*	Each view only keeps its visible set, stored as ranges of pre-order node indices:
+*	a subtree totally inside the frustum is a single range, and consecutive ranges are merged.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_BATCHFRUSTUMCULLER_H_
+#define _VDLIB_BATCHFRUSTUMCULLER_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/Plane.h>
+#include <vdlib/FlatTree.h>
+
+namespace vdlib {
+
+// Nodes [begin, end) of a FlatTree, in pre-order. Leaves in this range are visible.
+class VisibleRange
+{
+public:
+	int begin;
+	int end;
+};
+
+class BatchFrustumCuller
+{
+public:
+	BatchFrustumCuller();
+
+	// Cull each view-projection matrix against tree (16 floats each, same layout as FrustumCuller::updateFrustumPlanes).
+	// Views are split among OpenMP threads, tree is only read.
+	void cull( const FlatTree& tree, const float* matrices, int viewCount );
+
+	// Visible set of a view culled by last call
+	int getRangeCount( int view ) const;
+	const VisibleRange* getRanges( int view ) const;
+
+	// Number of views, wall-clock time in milliseconds and views per second of last call
+	int getViewCount() const;
+	double getCullTime() const;
+	double getViewsPerSecond() const;
+
+private:
+	// Node waiting to be tested, with the planes it still has to test
+	class Pending
+	{
+	public:
+		int index;
+		unsigned int planeMask;
+	};
+
+	// Per-thread traversal stack and visible ranges of all views culled by that thread
+	class ThreadState
+	{
+	public:
+		std::vector<Pending> stack;
+		std::vector<VisibleRange> ranges;
+	};
+
+	// Where the ranges of a view are stored
+	class ViewResult
+	{
+	public:
+		int thread;
+		int begin;
+		int end;
+	};
+
+	// Batched traversal of one view, appending visible ranges to state
+	static void cullView( const FlatTree& tree, const Plane* planes, ThreadState& state );
+
+	// Append range, merging it with the last one when consecutive and from the same view
+	static void addRange( std::vector<VisibleRange>& ranges, int firstRange, int begin, int end );
+
+	std::vector<ThreadState> _threads;
+	std::vector<ViewResult> _views;
+	double _cullTime;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_BATCHFRUSTUMCULLER_H_
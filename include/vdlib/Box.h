@@ -35,6 +35,47 @@ public:
 	const vr::vec3f& getLongestAxis() const;
 };
 
+// Structure-of-arrays storage for many boxes.
+// Each box component is kept in its own contiguous array, indexed by box.
+// All arrays live in a single block of memory, either owned or external (e.g. a mapped file).
+class BoxArray
+{
+public:
+	// Number of float arrays in a block
+	enum { Component_Count = 15 };
+
+	BoxArray();
+
+	// Allocate owned memory
+	void resize( int size );
+
+	// Use external memory, must hold Component_Count * size floats in getData() layout
+	void attach( float* data, int size );
+
+	int size() const;
+
+	// Memory block: center[0..2], axis[0][0..2], axis[1][0..2], axis[2][0..2], extents[0..2]
+	const float* getData() const;
+
+	void set( int index, const Box& box );
+	void get( int index, Box& box ) const;
+
+	float* center[3];  // center[c][i]  = component c of box i center
+	float* axis[3][3]; // axis[a][c][i] = component c of box i axis a
+	float* extents[3]; // extents[a][i] = box i half-length along axis a
+
+private:
+	// Pointers refer to own memory, no copies allowed
+	BoxArray( const BoxArray& );
+	BoxArray& operator=( const BoxArray& );
+
+	void setPointers( float* data, int size );
+
+	std::vector<float> _storage;
+	float* _data;
+	int _size;
+};
+
 } // namespace vdlib
 
 #endif // VDLIB_BOX_H_
@@ -16,20 +16,49 @@ public:
 	enum BoxType
 	{
 		Type_Aabb,
-		Type_Obb
+		Type_Obb,
+		Type_Obb_Tight  // Extremal points fit (DiTO-14), never looser than the AABB
 	};
 
 	// Set default box type to be built
 	static void setDefaultBoxType( BoxType type );
+	static BoxType getDefaultBoxType();
+
+	// Local search iterations applied to Type_Obb_Tight axes (default 0, no refinement).
+	// Each iteration costs two more passes over the vertices.
+	static void setTightObbRefinement( int iterations );
+	static int getTightObbRefinement();
 
 	// Create box according to default type
-	static void createBox( Box& result, const float* vertices, int size );
+	static void createBox( Box& result, const float* vertices, vr::int64 size );
 
 	// Create box of a specific type
-	static void createBox( Box& result, const float* vertices, int size, BoxType BoxType );
+	static void createBox( Box& result, const float* vertices, vr::int64 size, BoxType BoxType );
+
+	// Create box enclosing only the given ranges of vertices
+	static void createBox( Box& result, const VertexRange* ranges, int rangeCount );
+	static void createBox( Box& result, const VertexRange* ranges, int rangeCount, BoxType BoxType );
+
+	// Create box enclosing the given boxes, without reading any vertices.
+	// Moments are those of the vertices inside each box, only used by Type_Obb to find box axes.
+	// Resulting AABB is exact, resulting OBBs may be looser than ones computed from vertices.
+	static void createBox( Box& result, const Box* boxes, const Moments* moments, int count );
+	static void createBox( Box& result, const Box* boxes, const Moments* moments, int count, BoxType BoxType );
+
+	// Create one box of default type per range, results[i] encloses ranges[i].
+	// OBB axes of all boxes are found with a single batched eigen solve.
+	static void createBoxes( Box* const* results, const VertexRange* ranges, int count );
+	static void createBoxes( Box* const* results, const VertexRange* ranges, int count, BoxType BoxType );
+
+	// Keep box axes, recompute center and extents to tightly enclose the given vertices
+	static void refitBox( Box& box, const VertexRange* ranges, int rangeCount );
+
+	// Keep box axes, recompute center and extents to tightly enclose the given boxes
+	static void refitBox( Box& box, const Box* boxes, int count );
 
 private:
 	static BoxType s_defaultType;
+	static int s_tightObbRefinement;
 };
 
 } // namespace vdlib
@@ -10,30 +10,55 @@
 #include <vr/refcounting.h>
 #include <vr/stl_utils.h>
 
+// SIMD kernels: SSE on x86 compilers, AVX when enabled by the compiler.
+// Define VDLIB_NO_SIMD to force scalar code.
+#if !defined( VDLIB_NO_SIMD )
+	#if defined( __SSE__ ) || defined( _M_IX86 ) || defined( _M_X64 )
+		#define VDLIB_SSE
+	#endif
+	#if defined( __AVX__ )
+		#define VDLIB_AVX
+	#endif
+#endif
+
 namespace vdlib
 {
 	// Forward declarations
+	class BatchFrustumCuller;
 	class Box;
+	class BoxArray;
 	class BoxFactory;
 	class Distance;
 	class EigenSolver;
+	class FlatTree;
 	class FrustumCuller;
 	class Geometry;
 	class GeometryInfo;
 	class IFrustumCallback;
 	class IOcclusionCallback;
+	class IOcclusionQueryBackend;
 	class Intersection;
+	class LatencyQueryBackend;
 	class MinMax;
+	class Moments;
+	class MultiFrustumCuller;
 	class Node;
 	class OcclusionCuller;
 	class OcclusionQueryManager;
 	class OpenGL;
+	class OpenGLQueryBackend;
 	class Plane;
 	class PreOrderIterator;
 	class RawNode;
 	class SceneData;
+	class SoftwareQueryBackend;
+	class SoftwareRasterizer;
 	class Statistics;
 	class TreeBuilder;
+	class TreeRefitter;
+	class VertexPool;
+	class VertexRange;
+	class VisibleRange;
 
 } // namespace vdlib
 
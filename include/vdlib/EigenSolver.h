@@ -19,6 +19,9 @@ namespace vdlib {
 
 /**
 *	Extracts eigenvectors and eigenvalues from a symmetric 3x3 matrix.
+*	Batches of matrices are solved in closed form, see solveBatch().
+*	See "A Robust Eigensolver for 3x3 Symmetric Matrices"
+*		David Eberly
 */
 class EigenSolver
 {
@@ -43,6 +46,12 @@ public:
 	// Get eigenvectors
 	vr::vec3f getEigenVector( int i ) const;
 
+	// Solve several symmetric matrices in closed form, without iterations.
+	// Same results as incrSortEigenSolve3(): eigenvalues are sorted increasingly and
+	// the eigenvectors of each matrix form a rotation (determinant +1).
+	// Eigenvectors of matrix i are eigenVectors[i][0..2].
+	static void solveBatch( const float matrices[][3][3], int count, float eigenValues[][3], vr::vec3f eigenVectors[][3] );
+
 private:
 	float _matrix[3][3];
 	float _diag[3];
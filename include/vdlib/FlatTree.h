@@ -0,0 +1,182 @@
+/**
+*	Linear, cache-friendly copy of the main hierarchy used for fast traversal.
+*	Nodes are stored in depth-first (pre-order) order, so that the left child always follows its parent
+*	and a whole subtree can be skipped by jumping to its skip index.
+*	Can be saved to a binary cache file and later mapped back into memory, without rebuilding the hierarchy.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_FLATTREE_H_
+#define _VDLIB_FLATTREE_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/Box.h>
+#include <vdlib/Geometry.h>
+#include <vdlib/TreeBuilder.h>
+#include <vdlib/MappedFile.h>
+
+namespace vdlib {
+
+// Warning: flat index equals node id, assumes ids follow pre-order and
+// interior nodes have both children (TreeBuilder guarantees this).
+// Therefore per-node culling information is shared between Node and FlatTree traversals.
+class FlatTree
+{
+public:
+	// Longest client description stored in a cache file, including terminating zero
+	enum
+	{
+		Description_Size = 256
+	};
+
+	// Compact node, boxes are stored separately
+	class FlatNode
+	{
+	public:
+		int parent;        // Index of parent node, -1 for root
+		int rightChild;    // Index of right child, -1 for leaf. Left child is always at index + 1.
+		int skip;          // Index of the next node after this node's subtree
+		int geometryStart; // First geometry in global geometry array
+		int geometryCount; // Number of geometries stored in this node
+	};
+
+	FlatTree();
+
+	// Create linear arrays from TreeBuilder output.
+	// Original hierarchy is kept alive, since callbacks may still use Node pointers.
+	// Return false if node ids do not follow pre-order.
+	bool build( Node* root, const TreeBuilder::Statistics& stats );
+
+	// Write current tree to a binary cache file. Return false on failure.
+	bool save( const char* filename ) const;
+
+	// Map a cache file written by save(). Return false if missing, invalid or from another version.
+	// A loaded tree has no Node or Geometry objects: getHierarchyNode() returns NULL,
+	// getGeometries() is empty and callbacks must use FlatTree indices and geometry ids.
+	bool load( const char* filename );
+
+	// Free all memory
+	void clear();
+
+	// Client description of the scene (e.g. the options used to create it), written by save() and restored by load().
+	// Lets clients reject a cache file written for another scene. Longer text is truncated.
+	void setDescription( const char* description );
+	const char* getDescription() const;
+
+	// Was this tree loaded from a cache file?
+	bool isMapped() const;
+
+	// Statistics of the hierarchy this tree was built from
+	const TreeBuilder::Statistics& getStatistics() const;
+
+	int getNodeCount() const;
+
+	const FlatNode& getFlatNode( int index ) const;
+	bool isLeaf( int index ) const;
+
+	// Original hierarchy node, NULL if tree was loaded from file
+	Node* getHierarchyNode( int index ) const;
+
+	// Node bounding boxes
+	const BoxArray& getBoxes() const;
+
+	// Number of geometries in all nodes
+	int getGeometryCount() const;
+
+	// Client-side identifier of geometry, see Geometry::getId(). Same indexing as below.
+	int getGeometryId( int geometryIndex ) const;
+
+	// All geometries, grouped by node. See FlatNode::geometryStart.
+	const GeometryVector& getGeometries() const;
+
+	// Geometry bounding boxes, same indexing as above
+	const BoxArray& getGeometryBoxes() const;
+
+private:
+	// Point arrays at owned storage
+	void useOwnedStorage();
+
+	TreeBuilder::Statistics _stats;
+	char _description[Description_Size];
+
+	// Arrays used by traversals, either owned or inside mapped file
+	const FlatNode* _nodes;
+	const int* _geometryIds;
+	int _nodeCount;
+	int _geometryCount;
+	BoxArray _boxes;
+	BoxArray _geometryBoxes;
+
+	// Owned storage, when built from hierarchy
+	vr::ref_ptr<Node> _root;
+	std::vector<FlatNode> _ownedNodes;
+	std::vector<int> _ownedGeometryIds;
+	std::vector<Node*> _hierarchyNodes;
+	GeometryVector _geometries;
+
+	// Mapped storage, when loaded from file
+	MappedFile _file;
+};
+
+inline bool FlatTree::isMapped() const
+{
+	return _file.isOpen();
+}
+
+inline const TreeBuilder::Statistics& FlatTree::getStatistics() const
+{
+	return _stats;
+}
+
+inline const char* FlatTree::getDescription() const
+{
+	return _description;
+}
+
+inline int FlatTree::getNodeCount() const
+{
+	return _nodeCount;
+}
+
+inline const FlatTree::FlatNode& FlatTree::getFlatNode( int index ) const
+{
+	return _nodes[index];
+}
+
+inline bool FlatTree::isLeaf( int index ) const
+{
+	return _nodes[index].rightChild < 0;
+}
+
+inline Node* FlatTree::getHierarchyNode( int index ) const
+{
+	return _hierarchyNodes.empty() ? NULL : _hierarchyNodes[index];
+}
+
+inline const BoxArray& FlatTree::getBoxes() const
+{
+	return _boxes;
+}
+
+inline int FlatTree::getGeometryCount() const
+{
+	return _geometryCount;
+}
+
+inline int FlatTree::getGeometryId( int geometryIndex ) const
+{
+	return _geometryIds[geometryIndex];
+}
+
+inline const GeometryVector& FlatTree::getGeometries() const
+{
+	return _geometries;
+}
+
+inline const BoxArray& FlatTree::getGeometryBoxes() const
+{
+	return _geometryBoxes;
+}
+
+} // namespace vdlib
+
+#endif // _VDLIB_FLATTREE_H_
@@ -10,6 +10,7 @@
 #include <vdlib/TreeBuilder.h>
 #include <vdlib/Plane.h>
 #include <vdlib/PreOrderIterator.h>
+#include <vdlib/FlatTree.h>
 
 namespace vdlib {
 
@@ -19,29 +20,81 @@ class IFrustumCallback
 public:
 	// Called for every node that is found inside the view frustum
 	virtual void inside( Node* node ) = 0;
+
+	// Called for every FlatTree node that is found inside the view frustum.
+	// By default, forwards the corresponding hierarchy node to the method above.
+	// Trees loaded from a cache file have no hierarchy nodes, so this must be overridden (asserts otherwise).
+	virtual void inside( const FlatTree& tree, int index );
+
+	// Called instead of the method above for FlatTree leaves that cross the frustum boundaries, 
+	// when geometry culling is enabled. Receives indices of visible geometries in FlatTree::getGeometries().
+	// By default, reports the whole node to the method above.
+	virtual void insideGeometries( const FlatTree& tree, int index, const std::vector<int>& geometries );
 };
 
 // Main frustum culling algorithms
-// Warning: assumes node ids are consecutive and start with zero (TreeBuilder guarantees this).
+// Warning: assumes node ids are smaller than the node count given to init() (TreeBuilder and TreeRefitter guarantee this).
 class FrustumCuller
 {
 public:
-	// Reallocate per-node culling information.
+	FrustumCuller();
+
+	// Reallocate per-node culling information. Information of existing ids is kept.
+	// A node id reused by TreeRefitter starts with the culling plane of its previous node:
+	// results are still correct, but its first test may check more planes than needed.
 	void init( const TreeBuilder::Statistics& stats );
 
+	// Forget culling information of given node ids, see TreeRefitter::takeChangedIds()
+	void resetNodes( const std::vector<int>& ids );
+
 	// Extracts all 6 frustum planes from matrix.
 	// If matrix equals Projection, planes will be defined in Eye Space.
 	// If matrix equals View * Projection, planes will be defined in World Space.
 	void updateFrustumPlanes( const float* matrix );
 
+	// Same as above, storing the 6 planes in the given array
+	static void extractPlanes( const float* matrix, Plane* planes );
+
 	// Tests frustum planes in the following order: near, left, right, bottom, top, far.
 	// Implements spatial coherence (don't test planes that parent node was found to be totally inside).
 	// Implements temporal coherence (tests each node against its respective previous culling plane).
 	bool contains( Node* node );
+	bool contains( const FlatTree& tree, int index );
 
 	// Traverse hierarchy performing view-frustum culling
 	void traverse( Node* node, IFrustumCallback* callback );
 
+	// Same as above, using the linear hierarchy
+	void traverse( const FlatTree& tree, IFrustumCallback* callback );
+
+	// Number of node boxes tested against frustum planes since the last traverse() began, including contains() calls.
+	// Nodes below a node totally inside the frustum are reported without tests and are not counted.
+	int getTestedNodeCount() const;
+
+	// Linear hierarchy traversal options.
+	// Batch testing classifies pending nodes in groups with SIMD box tests (default on).
+	// When off, nodes are tested one at a time following skip indices (no stack needed).
+	// Batched traversal does not report nodes in pre-order.
+	void setBatchTesting( bool enabled );
+	bool getBatchTesting() const;
+
+	// Also test geometry boxes of leaves that cross the frustum boundaries (default off).
+	// Requires batch testing. See IFrustumCallback::insideGeometries.
+	void setGeometryCulling( bool enabled );
+	bool getGeometryCulling() const;
+
+	// Parallel traversal of both hierarchy representations, requires OpenMP (default off).
+	// The calling thread culls the top of the hierarchy until there are enough subtrees,
+	// which are then culled concurrently, each by one thread with its own stack.
+	// Callbacks are only called from the calling thread, after all subtrees are done.
+	// Nodes are not reported in pre-order, and geometry culling is not applied inside subtrees.
+	void setParallelTraversal( bool enabled );
+	bool getParallelTraversal() const;
+
+	// Minimum number of subtrees handed to threads (default 64)
+	void setParallelTaskCount( int count );
+	int getParallelTaskCount() const;
+
 private:
 	class CullingInfo
 	{
@@ -52,11 +105,76 @@ private:
 		unsigned int planeMask;
 	};
 
+	// Where linear hierarchy traversals report visible nodes
+	class CallbackOutput;
+	class BufferOutput;
+
+	// Per-thread traversal stack and visible nodes
+	class ThreadState
+	{
+	public:
+		PreOrderIterator iterator;
+		std::vector<int> stack;
+		std::vector<Node*> nodes;
+		std::vector<int> indices;
+		int testedNodes;
+	};
+
+	// Subtree culled by one thread. Its visible nodes are [begin, end) in that thread's buffer.
+	class Task
+	{
+	public:
+		Node* node;
+		int index;
+		int thread;
+		int begin;
+		int end;
+	};
+
 	unsigned int getParentCullingMask( Node* node ) const;
 
+	// Same as public contains(), counting tested boxes in given counter (one per thread)
+	bool contains( Node* node, int& testedNodes );
+	bool contains( const FlatTree& tree, int index, int& testedNodes );
+
+	// Main plane tests shared by both hierarchy representations
+	template<class BoxTest>
+	bool contains( CullingInfo& nodeInfo, unsigned int planeMask, const BoxTest& boxTest, int& testedNodes );
+
+	// Linear hierarchy traversals of subtree at given index
+	template<class Output>
+	void traverseSkip( const FlatTree& tree, int root, Output& output, int& testedNodes );
+	template<class Output>
+	void traverseBatch( const FlatTree& tree, int root, std::vector<int>& stack, Output& output, int& testedNodes );
+
+	// Report whole subtree as inside, without testing
+	template<class Output>
+	void insideSubtree( const FlatTree& tree, int index, Output& output );
+
+	// Parallel traversals: split top of hierarchy into tasks, cull them concurrently, then report results
+	void traverseParallel( Node* node, IFrustumCallback* callback, int threadCount );
+	void traverseParallel( const FlatTree& tree, IFrustumCallback* callback, int threadCount );
+
+	// Test geometry boxes of a leaf against remaining planes
+	void cullGeometries( const FlatTree& tree, int index, unsigned int planeMask, IFrustumCallback* callback );
+
 	Plane _planes[6];
 	std::vector<CullingInfo> _cullingInfo;
 	PreOrderIterator _itr;
+	int _testedNodeCount;
+
+	// Linear hierarchy traversal
+	bool _batchTesting;
+	bool _geometryCulling;
+	std::vector<int> _batchStack;
+	std::vector<int> _visibleGeometries;
+
+	// Parallel traversal
+	bool _parallelTraversal;
+	int _parallelTaskCount;
+	std::vector<Task> _tasks;
+	std::vector<Task> _nextTasks;
+	std::vector<ThreadState> _threads;
 };
 
 } // namespace vdlib
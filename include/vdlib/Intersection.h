@@ -10,6 +10,18 @@
 
 namespace vdlib {
 
+// Result of a batch box classification, one entry per box
+class BoxBatchResult
+{
+public:
+	enum { Batch_Size = 8 };
+
+	unsigned int insidePlanes[Batch_Size];  // Bit p is set if box is totally inside plane p
+	unsigned int outsidePlanes[Batch_Size]; // Bit p is set if box is totally outside plane p
+	unsigned int insideMask;                // Bit i is set if box i is totally inside all planes
+	unsigned int outsideMask;               // Bit i is set if box i is totally outside any plane
+};
+
 class Intersection
 {
 public:
@@ -22,6 +34,18 @@ public:
 	 *	Plane must be in Hessian Normal Form.
 	 */
 	static int between( const Plane& plane, const Box& box );
+
+	// Same test for box at given index of a structure-of-arrays box storage
+	static int between( const Plane& plane, const BoxArray& boxes, int index );
+
+	/**
+	 *	Batch test of up to BoxBatchResult::Batch_Size boxes against up to 32 planes.
+	 *	Boxes are taken from given indices of the box storage.
+	 *	Boxes that are neither in result.insideMask nor in result.outsideMask are intersected.
+	 *	Uses SSE (4 boxes) or AVX (8 boxes) kernels when available.
+	 */
+	static void between( const Plane* planes, int planeCount, const BoxArray& boxes, 
+	                     const int* indices, int count, BoxBatchResult& result );
 };
 
 } // namespace vdlib
@@ -0,0 +1,51 @@
+/**
+*	Delays results of another backend to simulate asynchronous queries.
+*	Time is counted in backend calls: each issued query and each availability check advance the clock by one.
+*	Traversals are therefore deterministic and can be tested and benchmarked headless,
+*	e.g. with a SoftwareQueryBackend whose results would otherwise be available immediately.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_LATENCYQUERYBACKEND_H_
+#define _VDLIB_LATENCYQUERYBACKEND_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/OcclusionQueryBackend.h>
+
+namespace vdlib {
+
+class LatencyQueryBackend : public IOcclusionQueryBackend
+{
+public:
+	// Backend is owned by client
+	LatencyQueryBackend( IOcclusionQueryBackend* backend, int latency );
+
+	// Number of calls before a result becomes available
+	void setLatency( int latency );
+	int getLatency() const;
+
+	// Results fetched before they were available, i.e. times the traversal would have stalled
+	int getStallCount() const;
+	void resetStallCount();
+
+	virtual void init( int queryCount );
+	virtual void setExactCounts( bool enabled );
+	virtual void beginFrame( unsigned int visibilityThreshold );
+
+	virtual void issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount );
+	virtual void beginGeometryQuery( int queryId, const Box& box );
+	virtual void endGeometryQuery( int queryId );
+
+	virtual bool isResultAvailable( int queryId );
+	virtual unsigned int getResult( int queryId );
+
+private:
+	IOcclusionQueryBackend* _backend;
+	int _latency;
+	int _clock;
+	int _stallCount;
+	std::vector<int> _issueTimes;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_LATENCYQUERYBACKEND_H_
@@ -0,0 +1,46 @@
+/**
+*	Read-only file mapped into memory.
+*	Pages are mapped copy-on-write: modifying the memory never changes the file.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_MAPPEDFILE_H_
+#define _VDLIB_MAPPEDFILE_H_
+
+#include <vdlib/Common.h>
+
+namespace vdlib {
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Map entire file, return false on failure
+	bool open( const char* filename );
+
+	// Unmap file, previous data pointer becomes invalid
+	void close();
+
+	bool isOpen() const;
+
+	char* getData() const;
+	size_t getSize() const;
+
+private:
+	// Owns the mapping, no copies allowed
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+
+	char* _data;
+	size_t _size;
+
+#ifdef _WIN32
+	void* _file;    // HANDLE
+	void* _mapping; // HANDLE
+#endif
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_MAPPEDFILE_H_
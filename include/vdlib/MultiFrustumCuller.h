@@ -0,0 +1,90 @@
+/**
+*	Culls several view-frusta in one hierarchy traversal: stereo pairs, shadow map cascades, cube map faces.
+*	Each node box is read once and tested against all views that still need it.
+*	Plane masks are kept per view (spatial coherence), and a subtree is skipped once every view has rejected it.
+*	There is no per-node state, so memory does not grow with the number of views or nodes.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_MULTIFRUSTUMCULLER_H_
+#define _VDLIB_MULTIFRUSTUMCULLER_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/Plane.h>
+#include <vdlib/FlatTree.h>
+
+namespace vdlib {
+
+class MultiFrustumCuller
+{
+public:
+	enum
+	{
+		Max_Views = 8
+	};
+
+	MultiFrustumCuller();
+
+	// Number of views culled by each traversal, up to Max_Views (default 1)
+	void setViewCount( int count );
+	int getViewCount() const;
+
+	// Same as FrustumCuller::updateFrustumPlanes, for given view
+	void updateFrustumPlanes( int view, const float* matrix );
+
+	// Traverse hierarchy once, culling all views. Visible nodes of each view are reported in pre-order.
+	void traverse( Node* root );
+
+	// Same as above, using the linear hierarchy.
+	// Pending nodes are classified in groups with SIMD box tests, so nodes are not reported in pre-order.
+	void traverse( const FlatTree& tree );
+
+	// Results of last traversal
+	const std::vector<Node*>& getVisibleNodes( int view ) const;
+	const std::vector<int>& getVisibleIndices( int view ) const;
+
+	// Number of node boxes tested by last traversal. A box tested against several views counts once.
+	int getTestedNodeCount() const;
+
+private:
+	// Node waiting to be tested, with the planes each view still has to test.
+	// Views not in viewMask have rejected an ancestor.
+	class Pending
+	{
+	public:
+		Node* node;
+		int index;
+		unsigned int viewMask;
+		unsigned char planeMasks[Max_Views];
+	};
+
+	// Views of a pending node that still have planes to test
+	unsigned int getTestedViews( const Pending& pending ) const;
+
+	// Test box against remaining planes of one view, clearing planes the box is totally inside
+	bool contains( const Box& box, int view, unsigned char& planeMask ) const;
+
+	// Add node to visible list of each view in viewMask
+	void reportIndex( int index, unsigned int viewMask );
+
+	// Report whole subtree of linear hierarchy, without testing
+	void insideSubtree( const FlatTree& tree, int index, unsigned int viewMask );
+
+	void clearResults();
+
+	int _viewCount;
+	Plane _planes[Max_Views * 6];
+
+	// Planes tested by current batch of linear hierarchy nodes
+	Plane _batchPlanes[Max_Views * 6];
+	int _batchPlaneViews[Max_Views * 6];
+	unsigned char _batchPlaneBits[Max_Views * 6];
+
+	std::vector<Pending> _stack;
+	int _testedNodeCount;
+	std::vector<Node*> _visibleNodes[Max_Views];
+	std::vector<int> _visibleIndices[Max_Views];
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_MULTIFRUSTUMCULLER_H_
@@ -24,7 +24,10 @@ public:
 	// Internal identifier 
 	int getId() const;
 
-	// Hierarchy
+	// Only TreeBuilder should use this
+	void setId( int id );
+
+	// Hierarchy, NULL children turn node into a leaf
 	Node* getParent();
 
 	void setLeftChild( Node* child );
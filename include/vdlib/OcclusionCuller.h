@@ -2,6 +2,15 @@
 *	Implements Coherent Hierarchical Culling algorithm.
 *	See "Coherent Hierarchical Culling: Hardware Occlusion Queries Made Useful"
 *		Jiri Bittner, Michael Wimmer, Harald Piringer, Werner Purgathofer
+*	Optionally uses the improvements of CHC++: batched queries, multiqueries and randomized re-queries.
+*	See "CHC++: Coherent Hierarchical Culling Revisited"
+*		Oliver Mattausch, Jiri Bittner, Michael Wimmer
+*	Or only issues queries that are expected to pay off, according to a per-node cost model.
+*	See "Near Optimal Hierarchical Culling: Performance Driven Use of Hardware Occlusion Queries"
+*		Michael Guthe, Akos Balazs, Reinhard Klein
+*	Queries of nodes with a stable history can be postponed for several frames.
+*	See "Occlusion Culling with Statistically Optimized Occlusion Queries"
+*		Jirí Bittner, Vlastimil Havran
 *	author: Paulo Ivson <psantos@tecgraf.puc-rio.br>
 *	date:   10-Mar-2008
 */
@@ -11,6 +20,7 @@
 #include <vdlib/Common.h>
 #include <vdlib/Plane.h>
 #include <vdlib/OcclusionQueryManager.h>
+#include <vdlib/FlatTree.h>
 #include <queue>
 
 namespace vdlib {
@@ -26,18 +36,44 @@ public:
 	// Called for every visited node during traversal.
 	// Determine whether the node should be traversed or not (i.e. frustum culling).
 	virtual bool isValid( Node* node ) { return true; }
+
+	// Same as above, for FlatTree traversals.
+	// By default, forward the corresponding hierarchy node to the methods above.
+	// Trees loaded from a cache file have no hierarchy nodes, so these must be overridden (assert otherwise).
+	virtual void draw( const FlatTree& tree, int index );
+	virtual bool isValid( const FlatTree& tree, int index );
 };
 
-// Warning: assumes node ids are consecutive and start with zero (TreeBuilder guarantees this).
+// Warning: assumes node ids are smaller than the node count given to init() (TreeBuilder and TreeRefitter guarantee this).
 // Node bounding volumes must be defined in World Space
 class OcclusionCuller
 {
 public:
+	// Traversal algorithm
+	enum TraversalMode
+	{
+		Traversal_Chc,          // Query each node when it is dequeued (default)
+		Traversal_ChcPlusPlus,  // Separate queues for previously visible and invisible nodes
+		Traversal_NearOptimal   // CHC, but query only when expected occluded render cost exceeds query cost
+	};
+
 	OcclusionCuller();
 
-	// Reallocate occlusion information for all nodes
+	// Backend used to measure visibility: OpenGLQueryBackend, SoftwareQueryBackend, etc.
+	// Owned by client. Must be set before init(): without a backend, init() asserts and the culler stays uninitialized.
+	void setQueryBackend( IOcclusionQueryBackend* backend );
+	IOcclusionQueryBackend* getQueryBackend() const;
+
+	// Reallocate occlusion information for all nodes. Information of existing ids is kept.
+	// A node id reused by TreeRefitter inherits the visibility and query history of its previous node,
+	// so its subtree may be rendered or skipped without a query: reset such ids with resetNodes().
+	// Must be called between frames.
 	void init( const TreeBuilder::Statistics& stats );
 
+	// Forget occlusion information of given node ids, see TreeRefitter::takeChangedIds().
+	// Must be called between frames.
+	void resetNodes( const std::vector<int>& ids );
+
 	// Viewing information needs to be updated whenever camera changes
 	void updateViewerParameters( const float* viewMatrix, const float* projectionMatrix );
 
@@ -45,9 +81,48 @@ public:
 	void setVisibilityThreshold( unsigned int numPixels );
 	unsigned int getVisibilityThreshold() const;
 
+	void setTraversalMode( TraversalMode mode );
+	TraversalMode getTraversalMode() const;
+
+	// CHC++: number of previously invisible nodes gathered before their queries are issued (default 50)
+	void setBatchSize( int numNodes );
+	int getBatchSize() const;
+
+	// CHC++: test several previously invisible nodes with one query, grouped by how long they have been invisible (default on)
+	void setMultiQueries( bool enabled );
+	bool getMultiQueries() const;
+
+	// CHC++: previously visible leaves are queried again after 1 to n frames, chosen at random,
+	// so that queries of nodes which became visible together are spread over frames (default 10).
+	// Use 1 to query every frame. The culler has its own random sequence, restarted by init(), so results are repeatable.
+	void setRequeryInterval( int numFrames );
+	int getRequeryInterval() const;
+
+	// Near optimal: cost of one query, relative to rendering one geometry (default 0.1).
+	// A node is queried when its probability of being occluded times its render cost exceeds this value.
+	void setQueryCost( float cost );
+	float getQueryCost() const;
+
+	// CHC and near optimal: minimum probability that a node keeps its visibility for the next frames
+	// so that its queries are postponed, estimated from its query history (default 1, never postpone).
+	// Postponed visible leaves are rendered and postponed invisible nodes are skipped without a query.
+	// Lower values save more queries, but newly visible nodes may appear a few frames late.
+	// Values below 1 ask the backend for exact sample counts, see IOcclusionQueryBackend::setExactCounts().
+	void setPredictionConfidence( float confidence );
+	float getPredictionConfidence() const;
+
+	// Number of queries issued during last traversal
+	int getQueryCount() const;
+
+	// Number of queries postponed during last traversal, see setPredictionConfidence()
+	int getSavedQueryCount() const;
+
 	// Traverse hierarchy performing occlusion culling
 	void traverse( Node* node, IOcclusionCallback* callback );
 
+	// Same as above, using the linear hierarchy
+	void traverse( const FlatTree& tree, IOcclusionCallback* callback );
+
 private:
 	// Store per-node occlusion information
 	class OcclusionInfo
@@ -59,6 +134,16 @@ private:
 		int   lastRendered;			// Last time node was rendered
 		bool  visible;				// Last computed visibility information
 		float distanceToViewpoint;	// Last computed distance to viewpoint
+		int   nextQueryFrame;		// CHC++: first frame visible leaf will be queried again
+		int   invisibleFrames;		// CHC++: number of consecutive queries that found node invisible
+
+		// Query history, estimated probability of being occluded given previous query result
+		bool  lastResultVisible;
+		float occludedAfterVisible;
+		float occludedAfterOccluded;
+		float renderCost;			// Near optimal: number of geometries in subtree
+		unsigned int lastVisiblePixels;	// Result of last query
+		int   postponedUntil;		// First frame node will be queried again, if visibility is still lastResultVisible
 	};
 	typedef std::vector<OcclusionInfo> OcclusionInfoVector;
 
@@ -72,29 +157,115 @@ private:
 		// Predicate operator for sorting
 		bool operator()( const Node* first, const Node* second ) const;
 
+		// Same as above, for FlatTree indices
+		bool operator()( int first, int second ) const;
+
 	private:
 		const OcclusionInfoVector& _info;		
 	};
 
+	// Predicate for ordering node ids by decreasing number of frames found invisible
+	class LongestInvisible
+	{
+	public:
+		LongestInvisible( const OcclusionInfoVector& info );
+
+		bool operator()( int first, int second ) const;
+
+	private:
+		const OcclusionInfoVector& _info;
+	};
+
+	// Main traversal, shared by Node and FlatTree hierarchies (see OcclusionCuller.cpp)
+	template<class Hierarchy, class Queue>
+	void traverse( Hierarchy& hierarchy, typename Hierarchy::Handle root, Queue& distanceQueue );
+
+	template<class Hierarchy, class Queue>
+	void traverseChc( Hierarchy& hierarchy, Queue& distanceQueue );
+
+	template<class Hierarchy, class Queue>
+	void traverseChcPlusPlus( Hierarchy& hierarchy, Queue& distanceQueue );
+
+	// CHC++: render leaf or push children of interior node
+	template<class Hierarchy, class Queue>
+	void traverseNode( Hierarchy& hierarchy, typename Hierarchy::Handle node, Queue& distanceQueue );
+
+	// CHC++: process result of oldest query
+	template<class Hierarchy, class Queue>
+	void handleReturnedQuery( Hierarchy& hierarchy, Queue& distanceQueue );
+
+	// CHC++: issue queries for all nodes in invisible queue
+	template<class Hierarchy>
+	void issueMultiQueries( Hierarchy& hierarchy );
+
+	// CHC++: issue query for oldest node in visible queue
+	template<class Hierarchy>
+	void issueVisibleQuery( Hierarchy& hierarchy );
+
+	// CHC++: probability that a node remains invisible in the next frame
+	float getInvisiblePersistence( int nodeId ) const;
+
+	// Near optimal: query, render or descend into a node that is not intersecting the near plane
+	template<class Hierarchy, class Queue>
+	void visitNearOptimal( Hierarchy& hierarchy, typename Hierarchy::Handle node, bool wasVisible, Queue& distanceQueue );
+
+	// Near optimal: sum geometries of each subtree
+	template<class Hierarchy>
+	void computeRenderCosts( Hierarchy& hierarchy, typename Hierarchy::Handle root );
+
+	// Update query history with new result and predict how long it remains valid
+	void updateQueryHistory( OcclusionInfo& info, unsigned int visiblePixels );
+
+	// Is query of a termination node postponed because last result is predicted to still hold?
+	bool isQueryPostponed( const OcclusionInfo& info, bool wasVisible, bool leaf ) const;
+
+	// Render a previously visible leaf or skip a previously invisible node without querying it
+	template<class Hierarchy>
+	void visitPostponed( Hierarchy& hierarchy, typename Hierarchy::Handle node, bool wasVisible );
+
 	// Push children to distance queue
-	void pushChildren( Node* node );
+	template<class Hierarchy, class Queue>
+	void pushChildren( Hierarchy& hierarchy, typename Hierarchy::Handle node, Queue& distanceQueue );
 
 	// Update ancestors visibility
-	void pullUpVisibility( Node* node );
+	template<class Hierarchy>
+	void pullUpVisibility( Hierarchy& hierarchy, typename Hierarchy::Handle node );
+
+	// Next value in [0, _requeryInterval) of the culler's own random sequence
+	int randomRequeryOffset();
 
 	// Viewing information
 	vr::vec3f _viewpoint;
 	Plane _nearPlane;
 
+	// Traversal parameters
+	TraversalMode _traversalMode;
+	int _batchSize;
+	bool _multiQueries;
+	int _requeryInterval;
+	unsigned int _randomState; // Linear congruential generator, independent of vr::Random
+	float _queryCost;
+	bool _renderCostsValid;
+	float _predictionConfidence;
+	int _savedQueryCount;
+
 	// Occlusion information
 	unsigned int _visibilityThreshold;
+	std::vector<Node*> _queriedNodes; // Pending query nodes, by id, for Node traversals
 	OcclusionInfoVector _occlusionInfo;
 	OcclusionQueryManager _queryManager;
 
 	// Priority queue for front-to-back traversal
 	typedef std::priority_queue<Node*, std::vector<Node*>, ClosestToViewpoint> DistanceQueue;
+	typedef std::priority_queue<int, std::vector<int>, ClosestToViewpoint> FlatDistanceQueue;
 	DistanceQueue _distanceQueue;
+	FlatDistanceQueue _flatDistanceQueue;
 	int _frameId;
+
+	// CHC++ queues of node ids waiting for queries, and multiquery boxes
+	std::deque<int> _visibleQueue;
+	std::vector<int> _invisibleQueue;
+	std::vector<Box> _multiQueryBoxes;
 };
 
 } // namespace vdlib
@@ -0,0 +1,47 @@
+/**
+*	Interface used by occlusion culling to measure visibility.
+*	A backend counts visible pixels (samples) of bounding boxes and rendered geometry,
+*	either with graphics hardware, in software or simulated for testing.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_OCCLUSIONQUERYBACKEND_H_
+#define _VDLIB_OCCLUSIONQUERYBACKEND_H_
+
+#include <vdlib/Common.h>
+
+namespace vdlib {
+
+// Query ids are consecutive and start with zero. A query id is reused only after its result was fetched.
+class IOcclusionQueryBackend
+{
+public:
+	virtual ~IOcclusionQueryBackend() {}
+
+	// Reallocate queries
+	virtual void init( int queryCount ) = 0;
+
+	// Called before each traversal, before beginFrame().
+	// When enabled, results above the visibility threshold must be exact, since query prediction compares them between frames.
+	virtual void setExactCounts( bool enabled ) {}
+
+	// Called before each traversal.
+	// Nodes with more samples than the threshold are visible, so counting may stop there unless exact counts are required.
+	virtual void beginFrame( unsigned int visibilityThreshold ) {}
+
+	// Count samples of one or more bounding boxes without changing color or depth buffers
+	virtual void issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount ) = 0;
+
+	// Count samples of geometry rendered between begin and end. Box encloses that geometry.
+	virtual void beginGeometryQuery( int queryId, const Box& box ) = 0;
+	virtual void endGeometryQuery( int queryId ) = 0;
+
+	// Has result arrived? Must not block.
+	virtual bool isResultAvailable( int queryId ) = 0;
+
+	// Number of samples, blocks until result is available
+	virtual unsigned int getResult( int queryId ) = 0;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_OCCLUSIONQUERYBACKEND_H_
@@ -1,5 +1,5 @@
 /**
-*	Manage sending and retrieving occlusion queries to/from OpenGL.
+*	Manage sending and retrieving occlusion queries through a query backend.
 *	author: Paulo Ivson <psantos@tecgraf.puc-rio.br>
 *	date:   10-Mar-2008
 */
@@ -8,35 +8,61 @@
 
 #include <vdlib/Common.h>
 #include <vdlib/TreeBuilder.h>
+#include <vdlib/OcclusionQueryBackend.h>
 #include <deque>
 
 namespace vdlib {
 
 // Warning: assumes node ids are consecutive and start with zero (TreeBuilder guarantees this).
+// Queries are identified by node id. A multiquery tests several nodes at once and uses the id of its first node.
 class OcclusionQueryManager
 {
 public:
-	// Reallocate query ids for each node
+	OcclusionQueryManager();
+
+	// Backend is owned by client. Must be set before init().
+	void setBackend( IOcclusionQueryBackend* backend );
+	IOcclusionQueryBackend* getBackend() const;
+
+	// Reallocate queries for each node
 	void init( const TreeBuilder::Statistics& stats );
 
-	// Disable color and depth writes
-	void beginBoundingVolumeQuery( Node* node );
-	void endBoundingVolumeQuery();
+	// Forwarded to backend before each traversal, also resets query counter
+	void beginFrame( unsigned int visibilityThreshold, bool exactCounts );
+
+	void issueBoundingVolumeQuery( int nodeId, const Box& box );
 
-	void beginGeometryQuery( Node* node );
+	// Single query for the bounding volumes of several nodes
+	void issueMultiQuery( const int* nodeIds, const Box* boxes, int count );
+
+	void beginGeometryQuery( int nodeId, const Box& box );
 	void endGeometryQuery();
 
 	// Any queries left processing?
 	bool done() const;
 
-	// Front node represents oldest issued query
-	Node* popFrontNode();
+	// Front query is the oldest issued one
 	bool frontResultAvailable() const;
-	unsigned int getQueryResult( Node* node ) const;
+	unsigned int getFrontResult() const;
+	int getFrontNodeCount() const;
+	int getFrontNode( int i ) const;
+	void popFront();
+
+	// Queries issued since beginFrame()
+	int getQueryCount() const;
 
 private:
-	std::vector<unsigned int> _queryIds;
-	std::deque<Node*> _queryQueue;
+	class Query
+	{
+	public:
+		int firstNode; // Index in node array below
+		int nodeCount;
+	};
+
+	IOcclusionQueryBackend* _backend;
+	std::deque<Query> _queryQueue;
+	std::vector<int> _queryNodes; // Node ids of queries issued this frame
+	int _queryCount;
 };
 
 } // namespace vdlib
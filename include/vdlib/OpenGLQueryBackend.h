@@ -0,0 +1,34 @@
+/**
+*	Occlusion queries using OpenGL (ARB_occlusion_query).
+*	Requires a current OpenGL context, see OpenGL::init().
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_OPENGLQUERYBACKEND_H_
+#define _VDLIB_OPENGLQUERYBACKEND_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/OcclusionQueryBackend.h>
+
+namespace vdlib {
+
+class OpenGLQueryBackend : public IOcclusionQueryBackend
+{
+public:
+	virtual void init( int queryCount );
+
+	// Disable color and depth writes while rendering box
+	virtual void issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount );
+
+	virtual void beginGeometryQuery( int queryId, const Box& box );
+	virtual void endGeometryQuery( int queryId );
+
+	virtual bool isResultAvailable( int queryId );
+	virtual unsigned int getResult( int queryId );
+
+private:
+	std::vector<unsigned int> _queryIds;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_OPENGLQUERYBACKEND_H_
@@ -8,6 +8,8 @@
 
 #include <vdlib/Common.h>
 #include <vdlib/Plane.h>
+#include <vdlib/Statistics.h>
+#include <vdlib/VertexPool.h>
 
 namespace vdlib {
 
@@ -16,20 +18,28 @@ namespace vdlib {
 class GeometryInfo : public vr::RefCounted
 {
 public:
-	int verticesStart;
-	int verticesSize;
+	float* vertices;    // Stored in scene node's vertex pool, address never changes
+	vr::int64 verticesSize;
 	vr::ref_ptr<Geometry> geometry;
+	Moments moments; // Only computed when node boxes are merged from geometry boxes
 };
 
 typedef std::vector< vr::ref_ptr<GeometryInfo> > GeometryInfoVector;
 
-// Stores additional information than final hierarchy node
+// Stores additional information than final hierarchy node.
+// The scene node owns the vertex and geometry pools for the entire scene.
+// Every other node shares these pools and refers to a range of consecutive geometries in it.
+// Children partition their parent's range in place, so vertices are never copied.
 class RawNode : public vr::RefCounted
 {
 public:
+	// Create a scene node with its own pools
 	RawNode();
 	explicit RawNode( int id );
 
+	// Create a child node sharing the pools of the given node
+	explicit RawNode( RawNode* parent );
+
 	void setLeftChild( RawNode* child );
 	RawNode* getLeftChild();
 
@@ -42,29 +52,57 @@ public:
 
 	int getTreeDepth() const;
 
-	std::vector<float>& getVertices();
-	const std::vector<float>& getVertices() const;
+	// Shared vertex pool, see GeometryInfo::vertices
+	VertexPool& getVertexPool();
+	const VertexPool& getVertexPool() const;
 
+	// Shared geometry pool
 	GeometryInfoVector& getGeometryInfos();
 	const GeometryInfoVector& getGeometryInfos() const;
 
+	// Geometries of this node are [start, start + count) in the geometry pool.
+	// Vertex count is the number of vertex floats used by these geometries.
+	void setGeometryRange( int start, int count, vr::int64 vertexCount );
+	int getGeometryStart() const;
+	int getGeometryCount() const;
+	vr::int64 getVertexCount() const;
+
+	// Index is relative to this node's geometry range
+	GeometryInfo* getGeometryInfo( int index );
+
 	// This is the final node that is used for main algorithms
 	Node* getHierarchyNode();
 
 	// Recompute bounding box based on current vertices and geometry information
 	void computeBoundingBox();
 
+	// Compute bounding box from geometry boxes and moments only, without reading vertices
+	void computeMergedBoundingBox();
+
+	// Keep bounding box axes, shrink it to tightly enclose current vertices
+	void refitBoundingBox();
+
 	// This method is called when RawNode is found to be a leaf node.
 	// Copy references to all Geometries from RawNode to hierarchy Node.
 	void assignGeometriesToHierarchyNode();
 
 private:
+	// Vertex ranges for all geometries in this node
+	void getVertexRanges( std::vector<VertexRange>& ranges );
+
 	int _treeDepth;					   // Tree depth at this node
 	vr::ref_ptr<RawNode> _leftChild;   // Temporary left child
 	vr::ref_ptr<RawNode> _rightChild;  // Temporary right child
 
-	std::vector<float> _vertices;      // Accumulated vertices for all geometries stored
-	GeometryInfoVector _geometryInfos; // Geometry information
+	VertexPool _vertices;              // Accumulated vertices for all geometries, only used by scene node
+	GeometryInfoVector _geometryInfos; // Geometry information, only used by scene node
+
+	VertexPool* _vertexPool;           // Scene node's vertices
+	GeometryInfoVector* _geometryPool; // Scene node's geometry information
+
+	int _geometryStart;                // Range of geometries inside the pool
+	int _geometryCount;
+	vr::int64 _vertexCount;
 
 	vr::ref_ptr<Node> _node;           // Actual hierarchy node
 };
@@ -14,6 +14,8 @@ namespace vdlib {
 class SceneData
 {
 public:
+	SceneData();
+
 	// Create a new scene node to store all geometries
 	void beginScene();
 
@@ -21,14 +23,24 @@ public:
 	// Takes ownership of geometry pointer and store it
 	void beginGeometry( Geometry* geometry );
 
+	// Vertex pool shared by indexed geometries, as xyz triples.
+	// Not copied: must remain valid until the last indexed geometry has been started.
+	void setSharedVertices( const float* vertices, vr::int64 size );
+
+	// Same as above, for a geometry made of the shared vertices referenced by the given indices (e.g. a triangle list).
+	// Each referenced vertex is stored only once, no matter how many indices refer to it,
+	// so bounding boxes and hierarchy construction only process unique vertices.
+	void beginGeometry( Geometry* geometry, const unsigned int* indices, vr::int64 indexCount );
+
 	// Send geometric information for current geometry
-	void addVertices( const float*  vertices, int size );
-	void addVertices( const double* vertices, int size );
+	void addVertices( const float*  vertices, vr::int64 size );
+	void addVertices( const double* vertices, vr::int64 size );
 
 	// Convenience method to apply given 4x4 transformation to all vertices added thus far
 	void transformVertices( const float* matrix );
 
-	// Get vertices for current geometry thus far
+	// Get vertices for current geometry thus far.
+	// Pointer may change when more vertices are added, but not after endGeometry().
 	const float* getCurrentVertices() const;
 
 	// End current geometry, create bounding box
@@ -43,6 +55,12 @@ public:
 
 private:
 	vr::ref_ptr<RawNode> _sceneRoot;
+
+	// Indexed geometries
+	const float* _sharedVertices;
+	vr::int64 _sharedVertexCount;
+	std::vector<int> _vertexStamps;  // Last indexed geometry that referenced each shared vertex
+	int _currentStamp;
 };
 
 } // namespace vdlib
@@ -0,0 +1,48 @@
+/**
+*	Occlusion queries answered by a SoftwareRasterizer, without a GPU.
+*	Results are computed when queries are issued, so they are always available.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_SOFTWAREQUERYBACKEND_H_
+#define _VDLIB_SOFTWAREQUERYBACKEND_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/OcclusionQueryBackend.h>
+
+namespace vdlib {
+
+// Client owns the rasterizer and, for each frame, sets its viewport and view-projection,
+// clears it and draws chosen occluders into it from IOcclusionCallback::draw().
+class SoftwareQueryBackend : public IOcclusionQueryBackend
+{
+public:
+	SoftwareQueryBackend( SoftwareRasterizer* rasterizer );
+
+	SoftwareRasterizer* getRasterizer() const;
+
+	virtual void init( int queryCount );
+
+	virtual void setExactCounts( bool enabled );
+
+	// Stop counting samples above visibility threshold, unless exact counts are required
+	virtual void beginFrame( unsigned int visibilityThreshold );
+
+	virtual void issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount );
+
+	// Box is tested before geometry is drawn, so that geometry does not occlude itself
+	virtual void beginGeometryQuery( int queryId, const Box& box );
+	virtual void endGeometryQuery( int queryId );
+
+	virtual bool isResultAvailable( int queryId );
+	virtual unsigned int getResult( int queryId );
+
+private:
+	SoftwareRasterizer* _rasterizer;
+	bool _exactCounts;
+	int _sampleLimit;
+	std::vector<unsigned int> _results;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_SOFTWAREQUERYBACKEND_H_
@@ -0,0 +1,106 @@
+/**
+*	Depth-only software rasterizer for occlusion culling without a GPU.
+*	Occluder triangles are rendered into a tiled depth buffer, then boxes are tested against it
+*	in the same way as a hardware occlusion query.
+*	Each tile keeps its farthest depth, so boxes behind a tile are rejected without visiting its pixels.
+*	See "Masked Software Occlusion Culling"
+*		J. Hasselgren, M. Andersson, T. Akenine-Moller
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_SOFTWARERASTERIZER_H_
+#define _VDLIB_SOFTWARERASTERIZER_H_
+
+#include <vdlib/Common.h>
+
+namespace vdlib {
+
+class SoftwareRasterizer
+{
+public:
+	// Depth buffer is stored tile by tile, rounded up to whole tiles
+	enum
+	{
+		Tile_Width  = 8,
+		Tile_Height = 8,
+		Tile_Size   = Tile_Width * Tile_Height
+	};
+
+	SoftwareRasterizer();
+
+	// Resize depth buffer, in pixels
+	void setViewport( int width, int height );
+	int getWidth() const;
+	int getHeight() const;
+
+	// Combined view * projection matrix, in OpenGL order (same as FrustumCuller::updateFrustumPlanes)
+	void setViewProjection( const float* viewProjMatrix );
+
+	// Reset depth buffer to far plane
+	void clear();
+
+	// Render occluders into depth buffer.
+	// Vertices are xyz triples, every three indices form a triangle. Both faces are rendered.
+	void drawTriangles( const float* vertices, const int* indices, int indexCount );
+
+	// Number of pixels of the box's front faces that pass the depth test.
+	// Depth buffer is not modified. Counting stops when maxSamples is reached, zero counts all pixels.
+	int testBox( const Box& box, int maxSamples ) const;
+
+	// Depth value of a pixel in [0,1], 1 is the far plane
+	float getDepth( int x, int y ) const;
+
+private:
+	// Screen space triangle ready for rasterization
+	class Triangle
+	{
+	public:
+		float edgeA[3];  // Edge functions E(x,y) = A*x + B*y + C, positive inside
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;    // Depth plane z(x,y) = A*x + B*y + C
+		float depthB;
+		float depthC;
+		float minDepth;
+		int minX;        // Pixel bounds, clipped to viewport
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	// Transform and clip one triangle against the near plane, then set up the resulting screen space triangles.
+	// Return how many were written to triangles (at most two).
+	int clipTriangle( const float* v0, const float* v1, const float* v2, bool draw, Triangle* triangles ) const;
+
+	// Project clipped triangle (clip space xyzw) and set up edge and depth equations.
+	// Return false if triangle is degenerate, back-facing in test mode, or outside the viewport.
+	bool setupTriangle( Triangle& triangle, const float* c0, const float* c1, const float* c2, bool draw ) const;
+
+	// True if triangle may have visible pixels inside tile
+	bool overlapsTile( const Triangle& triangle, int tileX, int tileY ) const;
+
+	// Write triangle depth into the buffer
+	void drawTriangle( const Triangle& triangle );
+
+	// Count pixels of triangle that pass the depth test, up to maxSamples
+	int testTriangle( const Triangle& triangle, int maxSamples ) const;
+
+	// Rasterize triangle into one tile. Passing pixels are written to target, the tile's own depth values,
+	// or counted up to maxSamples if target is NULL.
+	int rasterizeTile( const Triangle& triangle, int tileX, int tileY, float* target, int maxSamples ) const;
+
+	// Update farthest depth of tile after drawing
+	void updateTileMaxDepth( int tileIndex );
+
+	int _width;
+	int _height;
+	int _tilesX;
+	int _tilesY;
+	float _viewProj[16];
+
+	std::vector<float> _depth;        // Tile-major, Tile_Size floats per tile, rows of Tile_Width
+	std::vector<float> _tileMaxDepth; // Farthest depth inside each tile
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_SOFTWARERASTERIZER_H_
@@ -19,28 +19,82 @@ public:
 	vr::vec3f maxValues;
 };
 
+// Contiguous vertices of one geometry: floats [vertices, vertices + size).
+// Allows computing statistics over several geometries without copying their vertices,
+// which need not be stored in the same array.
+class VertexRange
+{
+public:
+	const float* vertices;
+	vr::int64 size;
+};
+
+// First and second order moments of a set of vertices, around the origin.
+// Moments of disjoint sets can be added, allowing covariance of a union to be computed without revisiting vertices.
+// Kept in double precision, since second order moments around the origin are prone to cancellation.
+class Moments
+{
+public:
+	void reset();
+	void add( const Moments& other );
+
+	vr::int64 count;    // Number of vertices
+	double sum[3];      // SUM( v[i] )
+	double sumProd[6];  // SUM( v[i] * v[j] ), in order XX, XY, XZ, YY, YZ, ZZ
+};
+
 // Main algorithms
 class Statistics
 {
 public:
+	// Min/max reductions over at least this many vertex floats are split among OpenMP threads (default 1M floats).
+	// Smaller inputs, or builds without OpenMP, use a single thread.
+	static void setParallelThreshold( vr::int64 size );
+	static vr::int64 getParallelThreshold();
+
 	// Geometric mean of vertices.
 	// Average equation:
 	// Average = 1/n * SUM( all vertices )
-	static void average( vr::vec3f& average, const float* vertices, int size );
+	static void average( vr::vec3f& average, const float* vertices, vr::int64 size );
 
 	// Covariance around average parameter.
 	// Elements of the Covariance matrix have the following closed form:
 	// C[i][j] = 1/n * SUM( vm[i] * vm[j] )
 	// m = average
 	// vm = v - m
-	static void covariance( float covariance[3][3], const vr::vec3f& average, const float* vertices, int size );
+	static void covariance( float covariance[3][3], const vr::vec3f& average, const float* vertices, vr::int64 size );
 
 	// Computes the minimum and maximum vertex values, along each axis X, Y and Z.
-	static void minMaxVertices( MinMax& result, const float* vertices, int size );
+	static void minMaxVertices( MinMax& result, const float* vertices, vr::int64 size );
 
 	// Computes the minimum and maximum vertex values along three specified axis, using center as reference point.
 	static void axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center, 
-		                          const float* vertices, int size );
+		                          const float* vertices, vr::int64 size );
+
+	// Accumulate moments of vertices
+	static void moments( Moments& result, const float* vertices, vr::int64 size );
+
+	// Average and covariance of the vertices described by given moments
+	static void covariance( float covariance[3][3], vr::vec3f& average, const Moments& moments );
+
+	// Same as above, considering only the given ranges of vertices
+	static void average( vr::vec3f& average, const VertexRange* ranges, int rangeCount );
+	static void covariance( float covariance[3][3], const vr::vec3f& average, const VertexRange* ranges, int rangeCount );
+	static void minMaxVertices( MinMax& result, const VertexRange* ranges, int rangeCount );
+	static void axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center, 
+		                          const VertexRange* ranges, int rangeCount );
+
+	// Average and covariance in a single pass over the vertices.
+	// Sums are kept in double precision, relative to the first vertex to avoid cancellation far from the origin.
+	static void averageAndCovariance( vr::vec3f& average, float covariance[3][3], const VertexRange* ranges, int rangeCount );
+
+	// Vertices with minimum and maximum projection along each of the given directions.
+	// Directions need not be unit length. Used to sample the convex hull when fitting tight OBBs.
+	static void extremalVertices( vr::vec3f* minVertices, vr::vec3f* maxVertices, const vr::vec3f* directions, int directionCount,
+		                          const VertexRange* ranges, int rangeCount );
+
+private:
+	static vr::int64 s_parallelThreshold;
 };
 
 } // namespace vdlib
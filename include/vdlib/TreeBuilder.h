@@ -2,6 +2,9 @@
 *	Basic hierarchy builder, implements "Average Center" spatial subdivision heuristic.
 *	See "OBB-Tree: A Hierarchical Structure for Rapid Interference Detection"
 *		S. Gottschalk, M.C. Lin, D. Manocha
+*	Optionally uses a binned Surface Area Heuristic.
+*	See "On fast Construction of SAH-based Bounding Volume Hierarchies"
+*		I. Wald
 *	author: Paulo Ivson <psantos@tecgraf.puc-rio.br>
 *	date:   4-Mar-2008
 */
@@ -24,18 +27,52 @@ public:
 		int leafCount;
 		int nodeCount;
 		int treeDepth;
+
+		// Expected cost of traversing the final tree, relative to a single geometry test.
+		// Sum of node surface areas relative to the root, leaves weighted by their geometry count.
+		float sahCost;
+	};
+
+	// How split planes are chosen
+	enum SplitHeuristic
+	{
+		Split_Average_Center, // Average of geometry centers along longest box axis (default)
+		Split_Sah             // Binned Surface Area Heuristic, best of all three box axes
+	};
+
+	// How node bounding boxes are computed
+	enum BoundsMode
+	{
+		Bounds_Vertices, // Fit each node to all vertices below it (default)
+		Bounds_Merged    // Merge geometry boxes, vertices are only read once per geometry and at leaves
 	};
 
 	TreeBuilder();
 
+	void setSplitHeuristic( SplitHeuristic heuristic );
+	SplitHeuristic getSplitHeuristic() const;
+
+	// Merged AABBs are the same as fitted ones.
+	// Merged OBBs use the same axes, but inner nodes enclose geometry boxes instead of vertices.
+	void setBoundsMode( BoundsMode mode );
+	BoundsMode getBoundsMode() const;
+
 	// Termination heuristics
 	// If the number of vertices inside a node falls below this value, the node is declared a leaf
-	void setMinVertexCount( int count );
+	void setMinVertexCount( vr::int64 count );
+
+	// Parallel construction, requires OpenMP (default off).
+	// Both subtrees of a node are built concurrently as separate tasks,
+	// unless the node has fewer vertices than the cutoff, in which case its subtree is built sequentially.
+	// Resulting hierarchy and node ids do not depend on this setting.
+	void setParallelBuild( bool enabled );
+	void setParallelCutoff( vr::int64 vertexCount );
 
 	//////////////////////////////////////////////////////////////////////////
 	// Main hierarchy construction
 	// Return final hierarchy node that represents the root for the entire scene
 	// After the hierarchy is built, SceneData is no longer needed
+	// Node ids are consecutive, start with zero at the root and follow pre-order (node, left, right)
 	//////////////////////////////////////////////////////////////////////////
 	vr::ref_ptr<Node> createTree( SceneData& sceneData );
 
@@ -52,6 +89,9 @@ private:
 		Condition_Indivisible
 	};
 
+	// Geometry vertex moments, needed to merge OBBs
+	void computeGeometryMoments( RawNode* sceneNode );
+
 	// Main recursive construction
 	void recursiveCreateHierarchy( RawNode* node );
 
@@ -61,6 +101,11 @@ private:
 	// Find best split position
 	void findSplitPlane( Plane& plane, RawNode* node );
 
+	// Split heuristics
+	void findAverageCenterSplit( Plane& plane, RawNode* node );
+	// Return false if no candidate split produces valid children
+	bool findSahSplit( Plane& plane, RawNode* node );
+
 	// Given a split position, try to partition the node
 	// If successful, return new children. Else do nothing.
 	Condition partitionGeometries( RawNode* node, const Plane& splitPlane );
@@ -68,10 +113,21 @@ private:
 	// Set a final leaf node
 	void setLeafNode( RawNode* node );
 
+	// Should the subtrees of this node be built in parallel?
+	bool isParallelNode( RawNode* node ) const;
+
+	// Give pre-order ids to all nodes and compute final statistics.
+	// Done after construction so that results do not depend on construction order.
+	void finishHierarchy( Node* root );
+
 	Statistics _stats;
+	SplitHeuristic _splitHeuristic;
+	BoundsMode _boundsMode;
 	int _maxTreeDepth;
-	int _minVertexCount;
+	vr::int64 _minVertexCount;
 	int _minGeometryCount;
+	bool _parallelBuild;
+	vr::int64 _parallelCutoff;
 };
 
 } // namespace vdlib
@@ -0,0 +1,146 @@
+/**
+*	Keeps a hierarchy valid when geometries move, are inserted or removed, without rebuilding it from vertices.
+*	Geometry boxes are updated by the client, then ancestors are refit bottom-up keeping their axes.
+*	Refitting never changes the tree, so boxes slowly degrade as geometries move apart:
+*	subtrees whose node boxes grew too much are rebuilt from geometry boxes.
+*	See "Ray Tracing Deformable Scenes using Dynamic Bounding Volume Hierarchies"
+*		I. Wald, S. Boulos, P. Shirley
+*	Inserted geometries get a new leaf next to the node whose boxes grow the least,
+*	and changed ancestors are rebalanced with local rotations.
+*	See "Fast, Effective BVH Updates for Animated Scenes"
+*		D. Kopta, T. Ize, J. Spjut, E. Brunvand, A. Davis, A. Kensler
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_TREEREFITTER_H_
+#define _VDLIB_TREEREFITTER_H_
+
+#include <vdlib/Common.h>
+#include <vdlib/Node.h>
+#include <map>
+
+namespace vdlib {
+
+// Node ids are stable: a node keeps its id until it is removed, and ids of removed nodes are reused by new ones.
+// After insertions and removals ids are no longer consecutive in pre-order, but stay below getNodeCapacity().
+// After insertions and removals, initialize cullers again with nodeCount = getNodeCapacity(),
+// then reset the per-node information of ids given by takeChangedIds().
+class TreeRefitter
+{
+public:
+	TreeRefitter();
+
+	// Index hierarchy created by TreeBuilder. Current node boxes are the reference for rebuild decisions.
+	void init( Node* root );
+
+	// Rebuild a subtree when the surface area of its root box exceeds this ratio of its reference area (default 2).
+	// Zero never rebuilds.
+	void setRebuildThreshold( float ratio );
+	float getRebuildThreshold() const;
+
+	// Set new bounding box of a moved geometry. Hierarchy is only updated by refit(), so several geometries can be moved at once.
+	void updateGeometry( Geometry* geometry, const Box& box );
+	void updateGeometries( Geometry* const* geometries, const Box* boxes, int count );
+
+	// Add geometry with a valid bounding box in a new leaf. The root node is never replaced.
+	// Ancestor boxes are only updated by refit().
+	void insertGeometry( Geometry* geometry );
+
+	// Remove geometry from its leaf. Empty leaves are removed along with their parent.
+	// Ancestor boxes are only updated by refit().
+	void removeGeometry( Geometry* geometry );
+
+	// Refit ancestors of all geometries updated, inserted or removed since last call, each node only once.
+	// Ancestors of inserted or removed geometries are also rotated.
+	// Degraded subtrees are rebuilt with the same nodes and ids.
+	// Any FlatTree built from this hierarchy must be built again.
+	void refit();
+
+	// Nodes refit, rebuilt and rotated by last refit()
+	int getRefitNodeCount() const;
+	int getRebuiltNodeCount() const;
+	int getRotationCount() const;
+
+	// All node ids are smaller than this value
+	int getNodeCapacity() const;
+
+	// Renumber nodes consecutively in pre-order, as required by FlatTree, and return node count.
+	// All ids are then reported as changed.
+	int compactIds();
+
+	// Moves out ids of nodes whose subtree changed since last call or init(), sorted and without repetitions:
+	// new nodes (including reused ids), ancestors of inserted or removed geometries, rotated and rebuilt nodes.
+	// Per-node culler information of these ids describes another subtree. Moved geometries alone change no ids.
+	void takeChangedIds( std::vector<int>& ids );
+
+private:
+	// Marks in _dirty
+	enum
+	{
+		Dirty_Refit = 1,	// Node box must be refit
+		Dirty_Structure		// Also try rotations and reset reference area
+	};
+
+	// Refit dirty nodes below given node, children first
+	void refitNode( Node* node );
+
+	// Rebuild degraded subtrees below given node, top-down
+	void rebuildDegraded( Node* node );
+
+	// Rebuild subtree with the same nodes, from geometry boxes only
+	void rebuildSubtree( Node* root );
+
+	// Recursively split geometries [begin, end) among exactly leafCount leaves, starting at nodes[next]
+	// Nodes take ids in increasing order, following pre-order.
+	Node* buildNode( std::vector< vr::ref_ptr<Node> >& nodes, const std::vector<int>& ids, int& next, GeometryVector& geometries, int begin, int end, int leafCount );
+
+	// Box enclosing the geometries of a leaf or the children of an inner node.
+	// Refit keeps current axes, otherwise a new box is created.
+	void fitBox( Node* node, bool refit );
+
+	// Remember current box of each node in subtree as reference, and the leaf of each geometry
+	void indexSubtree( Node* root );
+
+	// Node whose new parent would also enclose given box with least total area increase
+	Node* findSibling( const Box& box );
+
+	// Swap a child with a grandchild on the other side, if it reduces the area of that side
+	void rotateNode( Node* node );
+
+	// New node with a free id
+	Node* createNode();
+
+	// Give back id of a node detached from hierarchy
+	void releaseNode( Node* node );
+
+	// Move children, geometries and box to a node outside the hierarchy
+	void moveContent( Node* from, Node* to );
+
+	// Mark node and its ancestors
+	void markStructure( Node* node );
+
+	static void replaceChild( Node* parent, Node* child, Node* newChild );
+
+	// Area of a box with the axes of the first box enclosing the other two
+	static float mergedArea( const Box& axes, const Box& first, const Box& second );
+
+	static float surfaceArea( const Box& box );
+
+	Node* _root;
+	float _rebuildThreshold;
+
+	std::map<const Geometry*, Node*> _geometryLeaves;
+	std::vector<float> _referenceAreas; // By node id
+	std::vector<char> _dirty;           // By node id
+	std::vector<Node*> _dirtyLeaves;
+	std::vector<int> _freeIds;
+	std::vector<int> _changedIds;
+	std::vector<Box> _boxes;            // Scratch for fitBox(), reused between nodes
+
+	int _refitNodeCount;
+	int _rebuiltNodeCount;
+	int _rotationCount;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_TREEREFITTER_H_
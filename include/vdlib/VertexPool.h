@@ -0,0 +1,78 @@
+/**
+*	Chunked vertex storage used while ingesting a scene.
+*	Vertices are appended to large fixed-size chunks instead of one growing array,
+*	so the scene is never reallocated as a whole and stored vertices never move.
+*	Each block (the vertices of one geometry) is kept contiguous: if a block outgrows its chunk,
+*	only that block is moved to a new chunk.
+*	A block larger than a chunk gets a chunk of its own, grown geometrically with realloc().
+*	When the allocator has to copy it, old and new memory briefly add up to three times the block.
+*	date:   16-Oct-2026
+*/
+#ifndef _VDLIB_VERTEXPOOL_H_
+#define _VDLIB_VERTEXPOOL_H_
+
+#include <vdlib/Common.h>
+
+namespace vdlib {
+
+class VertexPool
+{
+public:
+	// Default chunk size, in floats (16 MB)
+	enum
+	{
+		Default_Chunk_Size = 4 * 1024 * 1024
+	};
+
+	VertexPool();
+	~VertexPool();
+
+	// Size of newly allocated chunks, in floats. Larger blocks get a chunk of their own.
+	void setChunkSize( vr::int64 size );
+	vr::int64 getChunkSize() const;
+
+	// Start a new block. Previous block is finished and its address remains valid until clear().
+	void beginBlock();
+
+	// Append size floats to current block, return pointer to the first new float.
+	// Current block may be moved to another chunk, previous blocks are never moved.
+	float* append( vr::int64 size );
+
+	// Current block, contiguous
+	float* getBlock() const;
+	vr::int64 getBlockSize() const;
+
+	// Free all chunks
+	void clear();
+
+	// Number of floats stored in all blocks
+	vr::int64 getSize() const;
+
+	// Number of floats allocated in all chunks
+	vr::int64 getCapacity() const;
+
+private:
+	// Owns the chunks, no copies allowed
+	VertexPool( const VertexPool& );
+	VertexPool& operator=( const VertexPool& );
+
+	// Move current block to a new chunk with room for at least size floats, or grow its chunk if it is alone there
+	void allocateChunk( vr::int64 size );
+
+	class Chunk
+	{
+	public:
+		float* data;
+		vr::int64 capacity;
+		vr::int64 used;
+	};
+
+	std::vector<Chunk> _chunks;
+	vr::int64 _chunkSize;
+	vr::int64 _blockStart; // Offset of current block inside last chunk
+	vr::int64 _size;
+};
+
+} // namespace vdlib
+
+#endif // _VDLIB_VERTEXPOOL_H_
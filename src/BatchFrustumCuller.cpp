@@ -0,0 +1,178 @@
+#include <vdlib/BatchFrustumCuller.h>
+#include <vdlib/FrustumCuller.h>
+#include <vdlib/Intersection.h>
+#include <vr/timer.h>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+using namespace vdlib;
+
+BatchFrustumCuller::BatchFrustumCuller()
+{
+	_cullTime = 0.0;
+}
+
+void BatchFrustumCuller::cull( const FlatTree& tree, const float* matrices, int viewCount )
+{
+	vr::Timer timer;
+	timer.restart();
+
+	int threadCount = 1;
+#ifdef _OPENMP
+	threadCount = omp_get_max_threads();
+#endif
+
+	_threads.resize( threadCount );
+	for( int t = 0; t < threadCount; ++t )
+		_threads[t].ranges.resize( 0 );
+
+	_views.resize( viewCount );
+
+	if( tree.getNodeCount() > 0 )
+	{
+		#pragma omp parallel for schedule( dynamic, 4 )
+		for( int v = 0; v < viewCount; ++v )
+		{
+			int thread = 0;
+#ifdef _OPENMP
+			thread = omp_get_thread_num();
+#endif
+			ThreadState& state = _threads[thread];
+
+			Plane planes[6];
+			FrustumCuller::extractPlanes( matrices + 16 * v, planes );
+
+			ViewResult& result = _views[v];
+			result.thread = thread;
+			result.begin = (int)state.ranges.size();
+			cullView( tree, planes, state );
+			result.end = (int)state.ranges.size();
+		}
+	}
+	else
+	{
+		for( int v = 0; v < viewCount; ++v )
+		{
+			_views[v].thread = 0;
+			_views[v].begin = 0;
+			_views[v].end = 0;
+		}
+	}
+
+	_cullTime = timer.elapsed() * 1000.0;
+}
+
+int BatchFrustumCuller::getRangeCount( int view ) const
+{
+	return _views[view].end - _views[view].begin;
+}
+
+const VisibleRange* BatchFrustumCuller::getRanges( int view ) const
+{
+	const ViewResult& result = _views[view];
+	if( result.end == result.begin )
+		return NULL;
+	return &_threads[result.thread].ranges[result.begin];
+}
+
+int BatchFrustumCuller::getViewCount() const
+{
+	return (int)_views.size();
+}
+
+double BatchFrustumCuller::getCullTime() const
+{
+	return _cullTime;
+}
+
+double BatchFrustumCuller::getViewsPerSecond() const
+{
+	if( _cullTime <= 0.0 )
+		return 0.0;
+	return _views.size() / ( _cullTime / 1000.0 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+void BatchFrustumCuller::cullView( const FlatTree& tree, const Plane* planes, ThreadState& state )
+{
+	BoxBatchResult result;
+	int indices[BoxBatchResult::Batch_Size];
+	unsigned int planeMasks[BoxBatchResult::Batch_Size];
+
+	// Ranges of previous views are never merged
+	const int firstRange = (int)state.ranges.size();
+
+	std::vector<Pending>& stack = state.stack;
+	Pending pending;
+	pending.index = 0;
+	pending.planeMask = 0x3F;
+	stack.assign( 1, pending );
+
+	while( !stack.empty() )
+	{
+		// Gather a batch of pending nodes
+		int count = 0;
+		while( ( count < BoxBatchResult::Batch_Size ) && !stack.empty() )
+		{
+			pending = stack.back();
+			stack.pop_back();
+
+			indices[count] = pending.index;
+			planeMasks[count] = pending.planeMask;
+			++count;
+		}
+
+		// Test all frustum planes at once
+		Intersection::between( planes, 6, tree.getBoxes(), indices, count, result );
+
+		for( int i = 0; i < count; ++i )
+		{
+			const int index = indices[i];
+			unsigned int planeMask = planeMasks[i];
+
+			// Ignore planes for which the parent was found to be totally inside
+			if( result.outsidePlanes[i] & planeMask )
+				continue;
+
+			const FlatTree::FlatNode& flatNode = tree.getFlatNode( index );
+
+			// Totally inside: whole subtree is visible
+			planeMask &= ~result.insidePlanes[i];
+			if( planeMask == 0 )
+			{
+				addRange( state.ranges, firstRange, index, flatNode.skip );
+				continue;
+			}
+
+			if( flatNode.rightChild < 0 )
+			{
+				addRange( state.ranges, firstRange, index, index + 1 );
+				continue;
+			}
+
+			// Push right child first, so that left subtree is visited first
+			pending.planeMask = planeMask;
+			pending.index = flatNode.rightChild;
+			stack.push_back( pending );
+			pending.index = index + 1;
+			stack.push_back( pending );
+		}
+	}
+}
+
+void BatchFrustumCuller::addRange( std::vector<VisibleRange>& ranges, int firstRange, int begin, int end )
+{
+	if( (int)ranges.size() > firstRange && ranges.back().end == begin )
+	{
+		ranges.back().end = end;
+		return;
+	}
+
+	VisibleRange range;
+	range.begin = begin;
+	range.end = end;
+	ranges.push_back( range );
+}
@@ -30,3 +30,71 @@ const vr::vec3f& Box::getLongestAxis() const
 	else
 		return axis[2];
 }
+
+//////////////////////////////////////////////////////////////////////////
+// BoxArray
+BoxArray::BoxArray()
+{
+	setPointers( NULL, 0 );
+}
+
+void BoxArray::resize( int size )
+{
+	vr::vectorExactResize( _storage, Component_Count * size );
+	setPointers( _storage.empty() ? NULL : &_storage[0], size );
+}
+
+void BoxArray::attach( float* data, int size )
+{
+	vr::vectorFreeMemory( _storage );
+	setPointers( data, size );
+}
+
+int BoxArray::size() const
+{
+	return _size;
+}
+
+const float* BoxArray::getData() const
+{
+	return _data;
+}
+
+void BoxArray::setPointers( float* data, int size )
+{
+	_data = data;
+	_size = size;
+
+	for( unsigned int c = 0; c < 3; ++c )
+	{
+		center[c]  = data + ( c      ) * size;
+		axis[0][c] = data + ( 3  + c ) * size;
+		axis[1][c] = data + ( 6  + c ) * size;
+		axis[2][c] = data + ( 9  + c ) * size;
+		extents[c] = data + ( 12 + c ) * size;
+	}
+}
+
+void BoxArray::set( int index, const Box& box )
+{
+	for( unsigned int c = 0; c < 3; ++c )
+	{
+		center[c][index]  = box.center[c];
+		axis[0][c][index] = box.axis[0][c];
+		axis[1][c][index] = box.axis[1][c];
+		axis[2][c][index] = box.axis[2][c];
+		extents[c][index] = box.extents[c];
+	}
+}
+
+void BoxArray::get( int index, Box& box ) const
+{
+	for( unsigned int c = 0; c < 3; ++c )
+	{
+		box.center[c]  = center[c][index];
+		box.axis[0][c] = axis[0][c][index];
+		box.axis[1][c] = axis[1][c][index];
+		box.axis[2][c] = axis[2][c][index];
+		box.extents[c] = extents[c][index];
+	}
+}
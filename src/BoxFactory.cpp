@@ -6,13 +6,354 @@
 
 using namespace vdlib;
 
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+
+// Fewer boxes are fit by the calling thread, a parallel loop would only add overhead
+static const int Parallel_Box_Count = 64;
+
+// Boxes merged into a tight OBB without allocating memory
+static const int Merge_Stack_Box_Count = 16;
+
+// Box axes are the eigenvectors of the covariance matrix
+void computeAxes( vr::vec3f axis[3], float covariance[3][3] )
+{
+	// Closed-form solve, eigenvalues are not needed
+	float eigenValues[1][3];
+	EigenSolver::solveBatch( (const float(*)[3][3])covariance, 1, eigenValues, (vr::vec3f(*)[3])axis );
+}
+
+// Set box center and extents from minimum and maximum values along box axes, relative to reference point
+void setCenterAndExtents( Box& result, const vr::vec3f& reference, const MinMax& minMax )
+{
+	// Let C be the box center and let U0, U1, and U2 be the box axes.  Each
+	// input point is of the form X = C + y0*U0 + y1*U1 + y2*U2.  Given
+	// min(y0), max(y0), min(y1), max(y1), min(y2), and max(y2),
+	// the box center is then adjusted to be
+	//   C' = C + 0.5*(min(y0)+max(y0))*U0 + 0.5*(min(y1)+max(y1))*U1 + 0.5*(min(y2)+max(y2))*U2
+	vr::vec3f center = reference;
+	center += result.axis[0] * ( 0.5f * ( minMax.minValues[0] + minMax.maxValues[0] ) );
+	center += result.axis[1] * ( 0.5f * ( minMax.minValues[1] + minMax.maxValues[1] ) );
+	center += result.axis[2] * ( 0.5f * ( minMax.minValues[2] + minMax.maxValues[2] ) );
+	result.center = center;
+
+	// Adjust extents
+	result.extents[0] = ( minMax.maxValues[0] - minMax.minValues[0] ) * 0.5f;
+	result.extents[1] = ( minMax.maxValues[1] - minMax.minValues[1] ) * 0.5f;
+	result.extents[2] = ( minMax.maxValues[2] - minMax.minValues[2] ) * 0.5f;
+}
+
+// Computes minimum and maximum values of given boxes along three axes, using reference as origin
+void boxesMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& reference, const Box* boxes, int count )
+{
+	for( int i = 0; i < count; ++i )
+	{
+		const Box& box = boxes[i];
+		const vr::vec3f centerMinusReference = box.center - reference;
+
+		for( int a = 0; a < 3; ++a )
+		{
+			// Box projection onto axis is an interval around projected center
+			const float center = centerMinusReference.dot( axis[a] );
+			const float radius = vr::abs( box.axis[0].dot( axis[a] ) ) * box.extents[0] +
+			                     vr::abs( box.axis[1].dot( axis[a] ) ) * box.extents[1] +
+			                     vr::abs( box.axis[2].dot( axis[a] ) ) * box.extents[2];
+
+			if( i == 0 || center - radius < result.minValues[a] )
+				result.minValues[a] = center - radius;
+			if( i == 0 || center + radius > result.maxValues[a] )
+				result.maxValues[a] = center + radius;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tight OBB fitting
+// See "Fast Computation of Tight-Fitting Oriented Bounding Boxes"
+//     T. Larsson, L. Kallberg
+
+// DiTO-14 sample directions: coordinate axes first, then cube diagonals
+static const int Dito_Direction_Count = 7;
+static const float Dito_Directions[Dito_Direction_Count][3] = 
+{
+	{ 1.0f,  0.0f,  0.0f },
+	{ 0.0f,  1.0f,  0.0f },
+	{ 0.0f,  0.0f,  1.0f },
+	{ 1.0f,  1.0f,  1.0f },
+	{ 1.0f,  1.0f, -1.0f },
+	{ 1.0f, -1.0f,  1.0f },
+	{ 1.0f, -1.0f, -1.0f }
+};
+
+// Refinement samples the box frame along its axes, face diagonals and body diagonals
+static const int Frame_Direction_Count = 13;
+
+// Initial rotation step of the refinement, in radians. Halved whenever no rotation improves the box.
+static const float Refinement_Initial_Angle = 0.1f;
+
+// Half surface area of box with given minimum and maximum values, lower is tighter
+static float boxQuality( const MinMax& minMax )
+{
+	const vr::vec3f size = minMax.maxValues - minMax.minValues;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Computes minimum and maximum values of a few points along three axes, using first point as origin
+static void pointsMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f* points, int count )
+{
+	result.minValues.set( 0.0f, 0.0f, 0.0f );
+	result.maxValues.set( 0.0f, 0.0f, 0.0f );
+
+	for( int i = 1; i < count; ++i )
+	{
+		const vr::vec3f pointMinusReference = points[i] - points[0];
+
+		for( int a = 0; a < 3; ++a )
+		{
+			const float d = pointMinusReference.dot( axis[a] );
+			if( d < result.minValues[a] )
+				result.minValues[a] = d;
+			else if( d > result.maxValues[a] )
+				result.maxValues[a] = d;
+		}
+	}
+}
+
+// Keep candidate axes if they enclose the sample points in a smaller box than the best so far, return true if kept.
+// Only the directions of axis0 and axis1 are used, result is always a right-handed orthonormal basis.
+static bool tryAxes( vr::vec3f best[3], float& bestQuality, const vr::vec3f& axis0, const vr::vec3f& axis1, const vr::vec3f* points, int count )
+{
+	vr::vec3f axis[3];
+	axis[0] = axis0;
+	axis[2] = axis0.cross( axis1 );
+	if( axis[0].normalize() == 0.0f || axis[2].normalize() == 0.0f )
+		return false;
+	axis[1] = axis[2].cross( axis[0] );
+
+	MinMax minMax;
+	pointsMinMaxValues( minMax, axis, points, count );
+
+	const float quality = boxQuality( minMax );
+	if( quality >= bestQuality )
+		return false;
+
+	bestQuality = quality;
+	best[0] = axis[0];
+	best[1] = axis[1];
+	best[2] = axis[2];
+	return true;
+}
+
+// Candidate axes of a triangle: each edge together with the triangle normal
+static void tryTriangleAxes( vr::vec3f best[3], float& bestQuality, const vr::vec3f& p0, const vr::vec3f& p1, const vr::vec3f& p2,
+                             const vr::vec3f* points, int count )
+{
+	const vr::vec3f normal = ( p1 - p0 ).cross( p2 - p0 );
+
+	tryAxes( best, bestQuality, p1 - p0, normal, points, count );
+	tryAxes( best, bestQuality, p2 - p1, normal, points, count );
+	tryAxes( best, bestQuality, p0 - p2, normal, points, count );
+}
+
+// Greedy local search: rotate box frame about each of its axes while the box around the sample points shrinks
+static void refineAxes( vr::vec3f axis[3], const vr::vec3f* points, int count, int iterations )
+{
+	MinMax minMax;
+	pointsMinMaxValues( minMax, axis, points, count );
+	float bestQuality = boxQuality( minMax );
+
+	float angle = Refinement_Initial_Angle;
+	for( int i = 0; i < iterations; ++i )
+	{
+		bool improved = false;
+
+		for( int a = 0; a < 3; ++a )
+		{
+			for( int sign = -1; sign <= 1; sign += 2 )
+			{
+				// Rotate the other two axes about axis a
+				const vr::vec3f& u = axis[(a+1)%3];
+				const vr::vec3f& v = axis[(a+2)%3];
+				const float c = cosf( angle );
+				const float s = sinf( angle ) * (float)sign;
+
+				vr::vec3f rotated[3];
+				rotated[a] = axis[a];
+				rotated[(a+1)%3] = u * c + v * s;
+				rotated[(a+2)%3] = v * c - u * s;
+
+				if( tryAxes( axis, bestQuality, rotated[0], rotated[1], points, count ) )
+					improved = true;
+			}
+		}
+
+		if( !improved )
+			angle *= 0.5f;
+	}
+}
+
+static void createTightOBB( Box& result, const VertexRange* ranges, int rangeCount, int refinement )
+{
+	vr::vec3f directions[Dito_Direction_Count];
+	for( int d = 0; d < Dito_Direction_Count; ++d )
+		directions[d].set( Dito_Directions[d] );
+
+	// Extremal vertices along sample directions, plus room for the ditetrahedron apexes.
+	// Minimum points come first, the maximum point of each direction is Dito_Direction_Count places after.
+	vr::vec3f points[2 * Dito_Direction_Count + 2];
+	Statistics::extremalVertices( &points[0], &points[Dito_Direction_Count], directions, Dito_Direction_Count, ranges, rangeCount );
+	int pointCount = 2 * Dito_Direction_Count;
+
+	// AABB is the first candidate, extremal points along coordinate axes give it exactly
+	vr::vec3f aabbAxis[3] = { vr::vec3f::UNIT_X(), vr::vec3f::UNIT_Y(), vr::vec3f::UNIT_Z() };
+	MinMax aabbMinMax;
+	pointsMinMaxValues( aabbMinMax, aabbAxis, points, pointCount );
+	const float aabbQuality = boxQuality( aabbMinMax );
+
+	vr::vec3f best[3] = { aabbAxis[0], aabbAxis[1], aabbAxis[2] };
+	float bestQuality = aabbQuality;
+
+	// Base triangle: farthest pair of extremal points, then extremal point farthest from the line through them
+	int farthest = 0;
+	for( int d = 1; d < Dito_Direction_Count; ++d )
+	{
+		if( ( points[d+Dito_Direction_Count] - points[d] ).length2() >
+		    ( points[farthest+Dito_Direction_Count] - points[farthest] ).length2() )
+			farthest = d;
+	}
+
+	const vr::vec3f p0 = points[farthest];
+	const vr::vec3f p1 = points[farthest+Dito_Direction_Count];
+	const vr::vec3f baseEdge = p1 - p0;
+
+	int third = 0;
+	float thirdDistance = -1.0f;
+	for( int i = 0; i < pointCount; ++i )
+	{
+		const float distance = ( points[i] - p0 ).cross( baseEdge ).length2();
+		if( distance > thirdDistance )
+		{
+			third = i;
+			thirdDistance = distance;
+		}
+	}
+
+	const vr::vec3f p2 = points[third];
+	const vr::vec3f normal = ( p1 - p0 ).cross( p2 - p0 );
+
+	if( normal.length2() > 0.0f )
+	{
+		tryTriangleAxes( best, bestQuality, p0, p1, p2, points, pointCount );
+
+		// Ditetrahedron: extremal points farthest below and above the base triangle
+		int below = 0;
+		int above = 0;
+		for( int i = 1; i < pointCount; ++i )
+		{
+			const float distance = ( points[i] - p0 ).dot( normal );
+			if( distance < ( points[below] - p0 ).dot( normal ) )
+				below = i;
+			else if( distance > ( points[above] - p0 ).dot( normal ) )
+				above = i;
+		}
+
+		const vr::vec3f apexes[2] = { points[below], points[above] };
+		for( int i = 0; i < 2; ++i )
+		{
+			if( ( apexes[i] - p0 ).dot( normal ) == 0.0f )
+				continue;
+
+			tryTriangleAxes( best, bestQuality, p0, p1, apexes[i], points, pointCount );
+			tryTriangleAxes( best, bestQuality, p1, p2, apexes[i], points, pointCount );
+			tryTriangleAxes( best, bestQuality, p2, p0, apexes[i], points, pointCount );
+		}
+	}
+	else if( baseEdge.length2() > 0.0f )
+	{
+		// All extremal points on a line: only its direction matters
+		vr::vec3f lineAxis = baseEdge;
+		lineAxis.normalize();
+
+		vr::vec3f u, v;
+		lineAxis.orthonormalBasis( u, v );
+		tryAxes( best, bestQuality, lineAxis, u, points, pointCount );
+	}
+
+	// Extents over all vertices, relative to AABB center for precision
+	const vr::vec3f reference = points[0] + ( aabbMinMax.minValues + aabbMinMax.maxValues ) * 0.5f;
+
+	MinMax minMax;
+	float quality = aabbQuality;
+
+	if( bestQuality < aabbQuality )
+	{
+		Statistics::axisMinMaxValues( minMax, best, reference, ranges, rangeCount );
+		quality = boxQuality( minMax );
+	}
+
+	if( refinement > 0 && quality < aabbQuality )
+	{
+		// Sample the hull around the current frame more densely, then search nearby orientations
+		vr::vec3f frame[Frame_Direction_Count];
+		int frameCount = 0;
+		for( int a = 0; a < 3; ++a )
+			frame[frameCount++] = best[a];
+		for( int a = 0; a < 3; ++a )
+		{
+			frame[frameCount++] = best[a] + best[(a+1)%3];
+			frame[frameCount++] = best[a] - best[(a+1)%3];
+		}
+		frame[frameCount++] = best[0] + best[1] + best[2];
+		frame[frameCount++] = best[0] + best[1] - best[2];
+		frame[frameCount++] = best[0] - best[1] + best[2];
+		frame[frameCount++] = best[0] - best[1] - best[2];
+
+		std::vector<vr::vec3f> samples( pointCount + 2 * Frame_Direction_Count );
+		std::copy( points, points + pointCount, samples.begin() );
+		Statistics::extremalVertices( &samples[pointCount], &samples[pointCount+Frame_Direction_Count], frame, Frame_Direction_Count, ranges, rangeCount );
+
+		vr::vec3f refined[3] = { best[0], best[1], best[2] };
+		refineAxes( refined, &samples[0], (int)samples.size(), refinement );
+
+		// Sample points may miss vertices that stick out of the refined box: keep whichever is really tighter
+		MinMax refinedMinMax;
+		Statistics::axisMinMaxValues( refinedMinMax, refined, reference, ranges, rangeCount );
+		const float refinedQuality = boxQuality( refinedMinMax );
+
+		if( refinedQuality < quality )
+		{
+			best[0] = refined[0];
+			best[1] = refined[1];
+			best[2] = refined[2];
+			minMax = refinedMinMax;
+			quality = refinedQuality;
+		}
+	}
+
+	// Sample points may also make an oriented box look tighter than it really is
+	if( quality < aabbQuality )
+	{
+		result.axis[0] = best[0];
+		result.axis[1] = best[1];
+		result.axis[2] = best[2];
+		setCenterAndExtents( result, reference, minMax );
+	}
+	else
+	{
+		result.axis[0] = aabbAxis[0];
+		result.axis[1] = aabbAxis[1];
+		result.axis[2] = aabbAxis[2];
+		setCenterAndExtents( result, points[0], aabbMinMax );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Main box creation algorithms
-void createAABB( Box& result, const float* vertices, int size )
+void createAABB( Box& result, const VertexRange* ranges, int rangeCount )
 {
 	// Get minimum and maximum along X, Y and Z
 	MinMax minMax;
-	Statistics::minMaxVertices( minMax, vertices, size );
+	Statistics::minMaxVertices( minMax, ranges, rangeCount );
 
 	// Set axis
 	result.axis[0] = vr::vec3f::UNIT_X();
@@ -28,7 +369,7 @@ void createAABB( Box& result, const float* vertices, int size )
 	result.center = ( minMax.minValues + minMax.maxValues ) * 0.5f;
 }
 
-void createOBB( Box& result, const float* vertices, int size )
+void createOBB( Box& result, const VertexRange* ranges, int rangeCount )
 {
 	// Initial OBB center
 	vr::vec3f average;
@@ -36,85 +377,196 @@ void createOBB( Box& result, const float* vertices, int size )
 	// Results in OBB axis (eigenvectors) and extents (eigenvalues)
 	float covariance[3][3];
 
-	// Compute statistical analysis
-	Statistics::average( average, vertices, size );
-	Statistics::covariance( covariance, average, vertices, size );
-
-	// Set up the eigen solver
-	EigenSolver solver;
-
-	solver( 0, 0 ) = covariance[0][0];
-	solver( 0, 1 ) = covariance[0][1];
-	solver( 0, 2 ) = covariance[0][2];
-	solver( 1, 0 ) = covariance[1][0];
-	solver( 1, 1 ) = covariance[1][1];
-	solver( 1, 2 ) = covariance[1][2];
-	solver( 2, 0 ) = covariance[2][0];
-	solver( 2, 1 ) = covariance[2][1];
-	solver( 2, 2 ) = covariance[2][2];
-	solver.incrSortEigenSolve3();
+	// Compute statistical analysis, in a single pass
+	Statistics::averageAndCovariance( average, covariance, ranges, rangeCount );
 
 	// Get eigenVectors
-	vr::vec3f axis[3];
-	axis[0] = solver.getEigenVector( 0 );
-	axis[1] = solver.getEigenVector( 1 );
-	axis[2] = solver.getEigenVector( 2 );
+	computeAxes( result.axis, covariance );
 
 	// Now we need to adjust the box center and extents
-
-	// Let C be the box center and let U0, U1, and U2 be the box axes.  Each
-	// input point is of the form X = C + y0*U0 + y1*U1 + y2*U2.  The
-	// following code computes min(y0), max(y0), min(y1), max(y1), min(y2),
-	// and max(y2). The box center is then adjusted to be
-	//   C' = C + 0.5*(min(y0)+max(y0))*U0 + 0.5*(min(y1)+max(y1))*U1 + 0.5*(min(y2)+max(y2))*U2
 	MinMax minMax;
-	Statistics::axisMinMaxValues( minMax, axis, average, vertices, size );
+	Statistics::axisMinMaxValues( minMax, result.axis, average, ranges, rangeCount );
 
-	//////////////////////////////////////////////////////////////////////////
-	// We have sufficient data to build the OBB
+	setCenterAndExtents( result, average, minMax );
+}
+
+// One OBB per range: per-box statistics are independent, axes of all boxes are solved together
+void createOBBs( Box* const* results, const VertexRange* ranges, int count )
+{
+	std::vector<vr::vec3f> averages( count );
+	std::vector<float> covariances( 9 * count );
+	std::vector<float> eigenValues( 3 * count );
+	std::vector<vr::vec3f> axes( 3 * count );
+
+	#pragma omp parallel for schedule( dynamic, 64 ) if( count > Parallel_Box_Count )
+	for( int i = 0; i < count; ++i )
+		Statistics::averageAndCovariance( averages[i], (float(*)[3])&covariances[9*i], &ranges[i], 1 );
+
+	EigenSolver::solveBatch( (const float(*)[3][3])&covariances[0], count, (float(*)[3])&eigenValues[0], (vr::vec3f(*)[3])&axes[0] );
+
+	#pragma omp parallel for schedule( dynamic, 64 ) if( count > Parallel_Box_Count )
+	for( int i = 0; i < count; ++i )
+	{
+		Box& result = *results[i];
+		result.axis[0] = axes[3*i];
+		result.axis[1] = axes[3*i+1];
+		result.axis[2] = axes[3*i+2];
 
-	// Adjust center
-	average +=	axis[0] * ( 0.5f * ( minMax.minValues[0] + minMax.maxValues[0] ) );
-	average +=	axis[1] * ( 0.5f * ( minMax.minValues[1] + minMax.maxValues[1] ) );
-	average +=	axis[2] * ( 0.5f * ( minMax.minValues[2] + minMax.maxValues[2] ) );
-	result.center = average;
+		MinMax minMax;
+		Statistics::axisMinMaxValues( minMax, result.axis, averages[i], &ranges[i], 1 );
 
+		setCenterAndExtents( result, averages[i], minMax );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Box merging algorithms
+void mergeAABB( Box& result, const Box* boxes, int count )
+{
 	// Set axis
-	result.axis[0] = axis[0];
-	result.axis[1] = axis[1];
-	result.axis[2] = axis[2];
+	result.axis[0] = vr::vec3f::UNIT_X();
+	result.axis[1] = vr::vec3f::UNIT_Y();
+	result.axis[2] = vr::vec3f::UNIT_Z();
 
-	// Adjust extents
-	result.extents[0] = ( minMax.maxValues[0] - minMax.minValues[0] ) * 0.5f;
-	result.extents[1] = ( minMax.maxValues[1] - minMax.minValues[1] ) * 0.5f;
-	result.extents[2] = ( minMax.maxValues[2] - minMax.minValues[2] ) * 0.5f;
+	// Get minimum and maximum along X, Y and Z
+	const vr::vec3f origin( 0.0f, 0.0f, 0.0f );
+
+	MinMax minMax;
+	boxesMinMaxValues( minMax, result.axis, origin, boxes, count );
+
+	setCenterAndExtents( result, origin, minMax );
+}
+
+void mergeOBB( Box& result, const Box* boxes, const Moments* moments, int count )
+{
+	// Combined moments give the same covariance as all vertices together
+	Moments total;
+	total.reset();
+
+	for( int i = 0; i < count; ++i )
+		total.add( moments[i] );
+
+	vr::vec3f average;
+	float covariance[3][3];
+	Statistics::covariance( covariance, average, total );
+
+	computeAxes( result.axis, covariance );
+
+	// Extents enclose the given boxes, which in turn enclose all vertices
+	MinMax minMax;
+	boxesMinMaxValues( minMax, result.axis, average, boxes, count );
+
+	setCenterAndExtents( result, average, minMax );
+}
+
+// Tight box around the corners of the given boxes, which in turn enclose all vertices.
+// Corners of a few boxes, such as two children during hierarchy updates, stay on the stack.
+static void mergeTightOBB( Box& result, const Box* boxes, int count, int refinement )
+{
+	vr::vec3f stackCorners[8 * Merge_Stack_Box_Count];
+	std::vector<vr::vec3f> heapCorners;
+
+	vr::vec3f* corners = stackCorners;
+	if( count > Merge_Stack_Box_Count )
+	{
+		heapCorners.resize( 8 * count );
+		corners = &heapCorners[0];
+	}
+
+	for( int i = 0; i < count; ++i )
+		boxes[i].computeVertices( &corners[8*i] );
+
+	VertexRange range;
+	range.vertices = corners[0].ptr;
+	range.size = 3 * 8 * (vr::int64)count;
+	createTightOBB( result, &range, 1, refinement );
 }
 
 //////////////////////////////////////////////////////////////////////////
 // BoxFactory implementation
 
 BoxFactory::BoxType BoxFactory::s_defaultType = BoxFactory::Type_Aabb;
+int BoxFactory::s_tightObbRefinement = 0;
 
 void BoxFactory::setDefaultBoxType( BoxType type )
 {
 	s_defaultType = type;
 }
 
-void BoxFactory::createBox( Box& result, const float* vertices, int size )
+BoxFactory::BoxType BoxFactory::getDefaultBoxType()
+{
+	return s_defaultType;
+}
+
+void BoxFactory::setTightObbRefinement( int iterations )
+{
+	s_tightObbRefinement = vr::max( iterations, 0 );
+}
+
+int BoxFactory::getTightObbRefinement()
+{
+	return s_tightObbRefinement;
+}
+
+void BoxFactory::createBox( Box& result, const float* vertices, vr::int64 size )
 {
 	createBox( result, vertices, size, s_defaultType );
 }
 
-void BoxFactory::createBox( Box& result, const float* vertices, int size, BoxType BoxType )
+void BoxFactory::createBox( Box& result, const float* vertices, vr::int64 size, BoxType BoxType )
+{
+	VertexRange range;
+	range.vertices = vertices;
+	range.size = size;
+	createBox( result, &range, 1, BoxType );
+}
+
+void BoxFactory::createBox( Box& result, const VertexRange* ranges, int rangeCount )
+{
+	createBox( result, ranges, rangeCount, s_defaultType );
+}
+
+void BoxFactory::createBox( Box& result, const VertexRange* ranges, int rangeCount, BoxType BoxType )
+{
+	switch( BoxType )
+	{
+	case Type_Aabb:
+		createAABB( result, ranges, rangeCount );
+		break;
+
+	case Type_Obb:
+		createOBB( result, ranges, rangeCount );
+		break;
+
+	case Type_Obb_Tight:
+		createTightOBB( result, ranges, rangeCount, s_tightObbRefinement );
+		break;
+
+	default:
+		printf( "Unknown box type!\n" );
+		break;
+	}
+}
+
+void BoxFactory::createBox( Box& result, const Box* boxes, const Moments* moments, int count )
+{
+	createBox( result, boxes, moments, count, s_defaultType );
+}
+
+void BoxFactory::createBox( Box& result, const Box* boxes, const Moments* moments, int count, BoxType BoxType )
 {
 	switch( BoxType )
 	{
 	case Type_Aabb:
-		createAABB( result, vertices, size );
+		mergeAABB( result, boxes, count );
 		break;
 
 	case Type_Obb:
-		createOBB( result, vertices, size );
+		mergeOBB( result, boxes, moments, count );
+		break;
+
+	case Type_Obb_Tight:
+		mergeTightOBB( result, boxes, count, s_tightObbRefinement );
 		break;
 
 	default:
@@ -122,3 +574,55 @@ void BoxFactory::createBox( Box& result, const float* vertices, int size, BoxTyp
 		break;
 	}
 }
+
+void BoxFactory::createBoxes( Box* const* results, const VertexRange* ranges, int count )
+{
+	createBoxes( results, ranges, count, s_defaultType );
+}
+
+void BoxFactory::createBoxes( Box* const* results, const VertexRange* ranges, int count, BoxType BoxType )
+{
+	if( count <= 0 )
+		return;
+
+	switch( BoxType )
+	{
+	case Type_Aabb:
+		#pragma omp parallel for schedule( dynamic, 64 ) if( count > Parallel_Box_Count )
+		for( int i = 0; i < count; ++i )
+			createAABB( *results[i], &ranges[i], 1 );
+		break;
+
+	case Type_Obb:
+		createOBBs( results, ranges, count );
+		break;
+
+	case Type_Obb_Tight:
+		#pragma omp parallel for schedule( dynamic, 64 ) if( count > Parallel_Box_Count )
+		for( int i = 0; i < count; ++i )
+			createTightOBB( *results[i], &ranges[i], 1, s_tightObbRefinement );
+		break;
+
+	default:
+		printf( "Unknown box type!\n" );
+		break;
+	}
+}
+
+void BoxFactory::refitBox( Box& box, const VertexRange* ranges, int rangeCount )
+{
+	// Use current center as reference, only to reduce round-off
+	MinMax minMax;
+	Statistics::axisMinMaxValues( minMax, box.axis, box.center, ranges, rangeCount );
+
+	setCenterAndExtents( box, vr::vec3f( box.center ), minMax );
+}
+
+void BoxFactory::refitBox( Box& box, const Box* boxes, int count )
+{
+	// Use current center as reference, only to reduce round-off
+	MinMax minMax;
+	boxesMinMaxValues( minMax, box.axis, box.center, boxes, count );
+
+	setCenterAndExtents( box, vr::vec3f( box.center ), minMax );
+}
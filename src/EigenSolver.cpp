@@ -1,10 +1,234 @@
 #include <vdlib/EigenSolver.h>
 #include <cmath>
+#include <algorithm>
 
 using namespace vdlib;
 
 static const int Matrix_Size = 3;
 
+//////////////////////////////////////////////////////////////////////////
+// Closed-form solver helpers, in double precision
+
+class Vector3d
+{
+public:
+	Vector3d() {}
+	Vector3d( double x, double y, double z ) { v[0] = x; v[1] = y; v[2] = z; }
+
+	double dot( const Vector3d& o ) const { return v[0] * o.v[0] + v[1] * o.v[1] + v[2] * o.v[2]; }
+
+	Vector3d cross( const Vector3d& o ) const
+	{
+		return Vector3d( v[1] * o.v[2] - v[2] * o.v[1], v[2] * o.v[0] - v[0] * o.v[2], v[0] * o.v[1] - v[1] * o.v[0] );
+	}
+
+	Vector3d operator*( double s ) const { return Vector3d( v[0] * s, v[1] * s, v[2] * s ); }
+	Vector3d operator-( const Vector3d& o ) const { return Vector3d( v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2] ); }
+
+	double v[3];
+};
+
+// Symmetric matrix, upper triangle
+class Symmetric3d
+{
+public:
+	Vector3d multiply( const Vector3d& x ) const
+	{
+		return Vector3d( a00 * x.v[0] + a01 * x.v[1] + a02 * x.v[2],
+		                 a01 * x.v[0] + a11 * x.v[1] + a12 * x.v[2],
+		                 a02 * x.v[0] + a12 * x.v[1] + a22 * x.v[2] );
+	}
+
+	double a00, a01, a02, a11, a12, a22;
+};
+
+// Unit vectors u, v so that w, u, v are orthonormal. w must be unit length.
+static void computeOrthogonalComplement( const Vector3d& w, Vector3d& u, Vector3d& v )
+{
+	if( fabs( w.v[0] ) > fabs( w.v[1] ) )
+		u = Vector3d( -w.v[2], 0.0, w.v[0] ) * ( 1.0 / sqrt( w.v[0] * w.v[0] + w.v[2] * w.v[2] ) );
+	else
+		u = Vector3d( 0.0, w.v[2], -w.v[1] ) * ( 1.0 / sqrt( w.v[1] * w.v[1] + w.v[2] * w.v[2] ) );
+
+	v = w.cross( u );
+}
+
+// Eigenvector of a simple eigenvalue: rows of A - eval*I span a plane, use the most robust cross product of two rows
+static Vector3d computeEigenvector0( const Symmetric3d& a, double eval )
+{
+	const Vector3d row0( a.a00 - eval, a.a01, a.a02 );
+	const Vector3d row1( a.a01, a.a11 - eval, a.a12 );
+	const Vector3d row2( a.a02, a.a12, a.a22 - eval );
+
+	const Vector3d r0xr1 = row0.cross( row1 );
+	const Vector3d r0xr2 = row0.cross( row2 );
+	const Vector3d r1xr2 = row1.cross( row2 );
+	const double d0 = r0xr1.dot( r0xr1 );
+	const double d1 = r0xr2.dot( r0xr2 );
+	const double d2 = r1xr2.dot( r1xr2 );
+
+	if( d0 >= d1 && d0 >= d2 )
+		return r0xr1 * ( 1.0 / sqrt( d0 ) );
+	if( d1 >= d2 )
+		return r0xr2 * ( 1.0 / sqrt( d1 ) );
+	return r1xr2 * ( 1.0 / sqrt( d2 ) );
+}
+
+// Eigenvector orthogonal to evec0, solving the 2x2 problem in evec0's orthogonal complement.
+// Robust even if eval is a repeated eigenvalue.
+static Vector3d computeEigenvector1( const Symmetric3d& a, const Vector3d& evec0, double eval )
+{
+	Vector3d u, v;
+	computeOrthogonalComplement( evec0, u, v );
+
+	const Vector3d au = a.multiply( u );
+	const Vector3d av = a.multiply( v );
+
+	double m00 = u.dot( au ) - eval;
+	double m01 = u.dot( av );
+	double m11 = v.dot( av ) - eval;
+
+	const double absM00 = fabs( m00 );
+	const double absM01 = fabs( m01 );
+	const double absM11 = fabs( m11 );
+
+	if( absM00 >= absM11 )
+	{
+		if( vr::max( absM00, absM01 ) == 0.0 )
+			return u;
+
+		if( absM00 >= absM01 )
+		{
+			m01 /= m00;
+			m00 = 1.0 / sqrt( 1.0 + m01 * m01 );
+			m01 *= m00;
+		}
+		else
+		{
+			m00 /= m01;
+			m01 = 1.0 / sqrt( 1.0 + m00 * m00 );
+			m00 *= m01;
+		}
+		return u * m01 - v * m00;
+	}
+	else
+	{
+		if( vr::max( absM11, absM01 ) == 0.0 )
+			return u;
+
+		if( absM11 >= absM01 )
+		{
+			m01 /= m11;
+			m11 = 1.0 / sqrt( 1.0 + m01 * m01 );
+			m01 *= m11;
+		}
+		else
+		{
+			m11 /= m01;
+			m01 = 1.0 / sqrt( 1.0 + m11 * m11 );
+			m11 *= m01;
+		}
+		return u * m11 - v * m01;
+	}
+}
+
+// Closed-form eigen decomposition of one matrix, eigenvalues sorted increasingly, eigenvectors form a rotation
+static void solveClosedForm( const float matrix[3][3], float eigenValues[3], vr::vec3f eigenVectors[3] )
+{
+	Symmetric3d a;
+	a.a00 = matrix[0][0];
+	a.a01 = matrix[0][1];
+	a.a02 = matrix[0][2];
+	a.a11 = matrix[1][1];
+	a.a12 = matrix[1][2];
+	a.a22 = matrix[2][2];
+
+	// Scale to avoid overflow and underflow
+	const double maxAbs = vr::max( vr::max( vr::max( fabs( a.a00 ), fabs( a.a01 ) ), vr::max( fabs( a.a02 ), fabs( a.a11 ) ) ),
+	                               vr::max( fabs( a.a12 ), fabs( a.a22 ) ) );
+
+	double evals[3];
+	Vector3d evecs[3];
+
+	const double offDiagonal = ( maxAbs > 0.0 ) ? ( a.a01 * a.a01 + a.a02 * a.a02 + a.a12 * a.a12 ) / ( maxAbs * maxAbs ) : 0.0;
+
+	if( offDiagonal > 0.0 )
+	{
+		const double invMax = 1.0 / maxAbs;
+		a.a00 *= invMax; a.a01 *= invMax; a.a02 *= invMax;
+		a.a11 *= invMax; a.a12 *= invMax; a.a22 *= invMax;
+
+		// Eigenvalues of B = ( A - q*I ) / p are 2*cos( angle + 2*k*PI/3 ), with cos( 3*angle ) = det( B ) / 2
+		const double q = ( a.a00 + a.a11 + a.a22 ) / 3.0;
+		const double b00 = a.a00 - q;
+		const double b11 = a.a11 - q;
+		const double b22 = a.a22 - q;
+		const double p = sqrt( ( b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * offDiagonal ) / 6.0 );
+
+		const double c00 = b11 * b22 - a.a12 * a.a12;
+		const double c01 = a.a01 * b22 - a.a12 * a.a02;
+		const double c02 = a.a01 * a.a12 - b11 * a.a02;
+		const double det = ( b00 * c00 - a.a01 * c01 + a.a02 * c02 ) / ( p * p * p );
+
+		// cos( angle + 2*PI/3 ) = -( cos( angle ) + sqrt( 3 ) * sin( angle ) ) / 2, with angle in [0,PI/3]
+		const double halfDet = vr::clampTo( det * 0.5, -1.0, 1.0 );
+		const double angle = acos( halfDet ) / 3.0;
+		const double cosAngle = cos( angle );
+		const double sinAngle = sqrt( vr::max( 1.0 - cosAngle * cosAngle, 0.0 ) );
+		const double beta2 = 2.0 * cosAngle;
+		const double beta0 = -( cosAngle + 1.73205080756887729 * sinAngle );
+		const double beta1 = -( beta0 + beta2 );
+
+		evals[0] = q + p * beta0;
+		evals[1] = q + p * beta1;
+		evals[2] = q + p * beta2;
+
+		// Start from the eigenvalue farthest from the other two, which is simple.
+		// Completing the basis with a cross product guarantees a rotation.
+		if( halfDet >= 0.0 )
+		{
+			evecs[2] = computeEigenvector0( a, evals[2] );
+			evecs[1] = computeEigenvector1( a, evecs[2], evals[1] );
+			evecs[0] = evecs[1].cross( evecs[2] );
+		}
+		else
+		{
+			evecs[0] = computeEigenvector0( a, evals[0] );
+			evecs[1] = computeEigenvector1( a, evecs[0], evals[1] );
+			evecs[2] = evecs[0].cross( evecs[1] );
+		}
+
+		for( int i = 0; i < 3; ++i )
+			evals[i] *= maxAbs;
+	}
+	else
+	{
+		// Diagonal matrix: sort diagonal, keeping a rotation
+		int order[3] = { 0, 1, 2 };
+		const double diagonal[3] = { a.a00, a.a11, a.a22 };
+		for( int i = 0; i < 2; ++i )
+			for( int j = 0; j < 2 - i; ++j )
+				if( diagonal[order[j]] > diagonal[order[j+1]] )
+					std::swap( order[j], order[j+1] );
+
+		for( int i = 0; i < 3; ++i )
+		{
+			evals[i] = diagonal[order[i]];
+			evecs[i] = Vector3d( 0.0, 0.0, 0.0 );
+			evecs[i].v[order[i]] = 1.0;
+		}
+
+		if( evecs[0].cross( evecs[1] ).dot( evecs[2] ) < 0.0 )
+			evecs[0] = evecs[0] * -1.0;
+	}
+
+	for( int i = 0; i < 3; ++i )
+	{
+		eigenValues[i] = (float)evals[i];
+		eigenVectors[i].set( (float)evecs[i].v[0], (float)evecs[i].v[1], (float)evecs[i].v[2] );
+	}
+}
+
 EigenSolver::EigenSolver()
 {
 	_isRotation = false;
@@ -48,6 +272,14 @@ vr::vec3f EigenSolver::getEigenVector( int i ) const
 	return vr::vec3f( _matrix[0][i], _matrix[1][i], _matrix[2][i] );
 }
 
+void EigenSolver::solveBatch( const float matrices[][3][3], int count, float eigenValues[][3], vr::vec3f eigenVectors[][3] )
+{
+	// Matrices are independent
+	#pragma omp parallel for if( count >= 4096 ) schedule( static )
+	for( int i = 0; i < count; ++i )
+		solveClosedForm( matrices[i], eigenValues[i], eigenVectors[i] );
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Private
 //////////////////////////////////////////////////////////////////////////
@@ -75,7 +307,7 @@ void EigenSolver::tridiagonal3()
 	_diag[0] = fM00;
 	_subd[2] =(float)0.0;
 
-	if(abs(fM02) > 1e-6)
+	if(fabs(fM02) > 1e-6)
 	{
 		float fLength = sqrt(fM01*fM01+fM02*fM02);
 		float fInvLength =((float)1.0)/fLength;
@@ -128,8 +360,8 @@ bool EigenSolver::qlAlgorithm()
 			int i2;
 			for(i2 = i0; i2 <= Matrix_Size-2; i2++)
 			{
-				float fTmp = abs(_diag[i2]) + abs(_diag[i2+1]);
-				if( abs(_subd[i2]) + fTmp == fTmp )
+				float fTmp = fabs(_diag[i2]) + fabs(_diag[i2+1]);
+				if( fabs(_subd[i2]) + fTmp == fTmp )
 					break;
 			}
 			if(i2 == i0)
@@ -152,7 +384,7 @@ bool EigenSolver::qlAlgorithm()
 			{
 				float fF = fSin*_subd[i3];
 				float fB = fCos*_subd[i3];
-				if(abs(fF) >= abs(fG))
+				if(fabs(fF) >= fabs(fG))
 				{
 					fCos = fG/fF;
 					fR = sqrt(fCos*fCos+(float)1.0);
@@ -0,0 +1,300 @@
+#include <vdlib/FlatTree.h>
+#include <vdlib/Node.h>
+#include <vdlib/PreOrderIterator.h>
+#include <cstdio>
+#include <cstring>
+
+using namespace vdlib;
+
+//////////////////////////////////////////////////////////////////////////
+// Cache file layout, in native byte order:
+//   FileHeader                                       includes client description, see FlatTree::setDescription()
+//   FlatNode[nodeCount]
+//   float[BoxArray::Component_Count * nodeCount]     node boxes, see BoxArray::getData()
+//   int[geometryCount]                               geometry ids
+//   float[BoxArray::Component_Count * geometryCount] geometry boxes
+// Each section starts at an aligned offset recorded in the header. Offsets and size are 64-bit.
+// Increment File_Version whenever this layout or FlatNode changes.
+//////////////////////////////////////////////////////////////////////////
+static const char File_Magic[4] = { 'V', 'D', 'L', 'H' };
+static const int File_Version = 3;
+static const int File_Byte_Order = 0x01020304;
+static const int File_Alignment = 16;
+
+class FileHeader
+{
+public:
+	char magic[4];
+	int version;
+	int headerSize;          // Detects layout changes between compilers
+	int byteOrder;           // Detects files written on a platform with different endianness
+	vr::int64 fileSize;
+
+	// TreeBuilder::Statistics
+	int nodeCount;
+	int leafCount;
+	int treeDepth;
+	float sahCost;
+
+	int geometryCount;
+	int padding;             // Keeps 64-bit fields aligned on every compiler
+
+	// Section offsets from beginning of file
+	vr::int64 nodesOffset;
+	vr::int64 boxesOffset;
+	vr::int64 geometryIdsOffset;
+	vr::int64 geometryBoxesOffset;
+
+	char description[FlatTree::Description_Size]; // Zero-terminated
+};
+
+static vr::int64 alignOffset( vr::int64 offset )
+{
+	return ( offset + File_Alignment - 1 ) / File_Alignment * File_Alignment;
+}
+
+// Check section lies inside file and is aligned
+static bool isValidSection( vr::int64 offset, int count, int elementSize, vr::int64 fileSize )
+{
+	if( offset < (vr::int64)sizeof( FileHeader ) || ( offset % File_Alignment ) != 0 || count < 0 )
+		return false;
+
+	return ( offset + (vr::int64)count * elementSize ) <= fileSize;
+}
+
+// Check links and geometry range of node at given index, so that traversals stay inside the arrays
+static bool isValidNode( const FlatTree::FlatNode& node, int index, int nodeCount, int geometryCount )
+{
+	if( ( index == 0 ) ? ( node.parent != -1 ) : ( node.parent < 0 || node.parent >= index ) )
+		return false;
+
+	if( node.skip <= index || node.skip > nodeCount )
+		return false;
+
+	if( node.rightChild != -1 && ( node.rightChild <= index + 1 || node.rightChild >= node.skip ) )
+		return false;
+
+	return ( node.geometryStart >= 0 && node.geometryCount >= 0 && node.geometryCount <= geometryCount - node.geometryStart );
+}
+
+// Write section at given offset, padding file up to it from current position.
+// Position is tracked here, since ftell() is limited to 2 GB on some platforms.
+static bool writeSection( FILE* file, vr::int64& position, vr::int64 offset, const void* data, vr::int64 size )
+{
+	static const char padding[File_Alignment] = { 0 };
+
+	const size_t paddingSize = (size_t)( offset - position );
+	if( position > offset || offset - position > File_Alignment || fwrite( padding, 1, paddingSize, file ) != paddingSize )
+		return false;
+
+	position = offset + size;
+	return size == 0 || fwrite( data, 1, (size_t)size, file ) == (size_t)size;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FlatTree implementation
+FlatTree::FlatTree()
+{
+	_stats.reset();
+	_description[0] = '\0';
+	useOwnedStorage();
+}
+
+bool FlatTree::build( Node* root, const TreeBuilder::Statistics& stats )
+{
+	clear();
+
+	vr::vectorExactResize( _ownedNodes, stats.nodeCount );
+	vr::vectorExactResize( _hierarchyNodes, stats.nodeCount );
+	_boxes.resize( stats.nodeCount );
+
+	// Count geometries first to allocate exact memory
+	unsigned int geometryCount = 0;
+	for( PreOrderIterator itr( root ); !itr.done(); itr.next() )
+		geometryCount += itr->getGeometries().size();
+
+	vr::vectorExactResize( _geometries, geometryCount );
+	vr::vectorExactResize( _ownedGeometryIds, geometryCount );
+	_geometryBoxes.resize( geometryCount );
+
+	// Copy nodes in pre-order
+	int index = 0;
+	geometryCount = 0;
+
+	for( PreOrderIterator itr( root ); !itr.done(); itr.next(), ++index )
+	{
+		Node* node = itr.current();
+
+		if( node->getId() != index || index >= stats.nodeCount )
+		{
+			printf( "FlatTree: node ids do not follow pre-order!\n" );
+			clear();
+			return false;
+		}
+
+		FlatNode& flatNode = _ownedNodes[index];
+		flatNode.parent = ( node->getParent() != NULL ) ? node->getParent()->getId() : -1;
+		flatNode.rightChild = ( node->getRightChild() != NULL ) ? node->getRightChild()->getId() : -1;
+
+		const GeometryVector& geometries = node->getGeometries();
+		flatNode.geometryStart = geometryCount;
+		flatNode.geometryCount = geometries.size();
+
+		for( unsigned int i = 0; i < geometries.size(); ++i, ++geometryCount )
+		{
+			_geometries[geometryCount] = geometries[i];
+			_ownedGeometryIds[geometryCount] = geometries[i]->getId();
+			_geometryBoxes.set( geometryCount, geometries[i]->getBoundingBox() );
+		}
+
+		_hierarchyNodes[index] = node;
+		_boxes.set( index, node->getBoundingBox() );
+	}
+
+	if( index != stats.nodeCount )
+	{
+		printf( "FlatTree: node count does not match statistics!\n" );
+		clear();
+		return false;
+	}
+
+	// Skip indices: a leaf is followed by the next node in pre-order,
+	// an interior node's subtree ends where its right subtree ends.
+	for( int i = index - 1; i >= 0; --i )
+	{
+		FlatNode& flatNode = _ownedNodes[i];
+		if( flatNode.rightChild < 0 )
+			flatNode.skip = i + 1;
+		else
+			flatNode.skip = _ownedNodes[flatNode.rightChild].skip;
+	}
+
+	_root = root;
+	_stats = stats;
+	useOwnedStorage();
+	return true;
+}
+
+bool FlatTree::save( const char* filename ) const
+{
+	const vr::int64 boxSize = BoxArray::Component_Count * sizeof( float );
+
+	FileHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, File_Magic, sizeof( header.magic ) );
+	header.version = File_Version;
+	header.headerSize = sizeof( FileHeader );
+	header.byteOrder = File_Byte_Order;
+
+	header.nodeCount = _stats.nodeCount;
+	header.leafCount = _stats.leafCount;
+	header.treeDepth = _stats.treeDepth;
+	header.sahCost = _stats.sahCost;
+	header.geometryCount = _geometryCount;
+	strcpy( header.description, _description );
+
+	header.nodesOffset = alignOffset( sizeof( FileHeader ) );
+	header.boxesOffset = alignOffset( header.nodesOffset + _nodeCount * (vr::int64)sizeof( FlatNode ) );
+	header.geometryIdsOffset = alignOffset( header.boxesOffset + _nodeCount * boxSize );
+	header.geometryBoxesOffset = alignOffset( header.geometryIdsOffset + _geometryCount * (vr::int64)sizeof( int ) );
+	header.fileSize = header.geometryBoxesOffset + _geometryCount * boxSize;
+
+	FILE* file = fopen( filename, "wb" );
+	if( file == NULL )
+		return false;
+
+	vr::int64 position = 0;
+	bool ok = writeSection( file, position, 0, &header, sizeof( header ) ) &&
+	          writeSection( file, position, header.nodesOffset, _nodes, _nodeCount * (vr::int64)sizeof( FlatNode ) ) &&
+	          writeSection( file, position, header.boxesOffset, _boxes.getData(), _nodeCount * boxSize ) &&
+	          writeSection( file, position, header.geometryIdsOffset, _geometryIds, _geometryCount * (vr::int64)sizeof( int ) ) &&
+	          writeSection( file, position, header.geometryBoxesOffset, _geometryBoxes.getData(), _geometryCount * boxSize );
+
+	ok = ( fclose( file ) == 0 ) && ok;
+	return ok;
+}
+
+bool FlatTree::load( const char* filename )
+{
+	clear();
+
+	if( !_file.open( filename ) )
+		return false;
+
+	const char* data = _file.getData();
+	const vr::int64 fileSize = (vr::int64)_file.getSize();
+	const int boxSize = BoxArray::Component_Count * sizeof( float );
+
+	// Validate header before trusting any offsets
+	const FileHeader* header = (const FileHeader*)data;
+
+	bool valid = ( fileSize >= (vr::int64)sizeof( FileHeader ) ) &&
+	             ( memcmp( header->magic, File_Magic, sizeof( header->magic ) ) == 0 ) &&
+	             ( header->version == File_Version ) &&
+	             ( header->headerSize == (int)sizeof( FileHeader ) ) &&
+	             ( header->byteOrder == File_Byte_Order ) &&
+	             ( header->fileSize == fileSize ) &&
+	             ( memchr( header->description, '\0', sizeof( header->description ) ) != NULL ) &&
+	             isValidSection( header->nodesOffset, header->nodeCount, sizeof( FlatNode ), fileSize ) &&
+	             isValidSection( header->boxesOffset, header->nodeCount, boxSize, fileSize ) &&
+	             isValidSection( header->geometryIdsOffset, header->geometryCount, sizeof( int ), fileSize ) &&
+	             isValidSection( header->geometryBoxesOffset, header->geometryCount, boxSize, fileSize );
+
+	// Nodes are only read after the whole header is known to be valid
+	const FlatNode* nodes = valid ? (const FlatNode*)( data + header->nodesOffset ) : NULL;
+	for( int i = 0; valid && i < header->nodeCount; ++i )
+		valid = isValidNode( nodes[i], i, header->nodeCount, header->geometryCount );
+
+	if( !valid )
+	{
+		printf( "FlatTree: invalid or outdated cache file '%s'!\n", filename );
+		clear();
+		return false;
+	}
+
+	_stats.nodeCount = header->nodeCount;
+	_stats.leafCount = header->leafCount;
+	_stats.treeDepth = header->treeDepth;
+	_stats.sahCost = header->sahCost;
+	strcpy( _description, header->description );
+
+	// Use mapped arrays directly
+	_nodes = nodes;
+	_nodeCount = header->nodeCount;
+	_boxes.attach( (float*)( data + header->boxesOffset ), header->nodeCount );
+
+	_geometryIds = (const int*)( data + header->geometryIdsOffset );
+	_geometryCount = header->geometryCount;
+	_geometryBoxes.attach( (float*)( data + header->geometryBoxesOffset ), header->geometryCount );
+
+	return true;
+}
+
+void FlatTree::clear()
+{
+	_root = NULL;
+	_stats.reset();
+	_description[0] = '\0';
+	vr::vectorFreeMemory( _ownedNodes );
+	vr::vectorFreeMemory( _ownedGeometryIds );
+	vr::vectorFreeMemory( _hierarchyNodes );
+	vr::vectorFreeMemory( _geometries );
+	_boxes.resize( 0 );
+	_geometryBoxes.resize( 0 );
+	useOwnedStorage();
+	_file.close();
+}
+
+void FlatTree::setDescription( const char* description )
+{
+	strncpy( _description, description, Description_Size - 1 );
+	_description[Description_Size - 1] = '\0';
+}
+
+void FlatTree::useOwnedStorage()
+{
+	_nodes = _ownedNodes.empty() ? NULL : &_ownedNodes[0];
+	_nodeCount = _ownedNodes.size();
+	_geometryIds = _ownedGeometryIds.empty() ? NULL : &_ownedGeometryIds[0];
+	_geometryCount = _ownedGeometryIds.size();
+}
@@ -1,9 +1,117 @@
 #include <vdlib/FrustumCuller.h>
 #include <vdlib/Node.h>
 #include <vdlib/Intersection.h>
+#include <cassert>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 
 using namespace vdlib;
 
+//////////////////////////////////////////////////////////////////////////
+// Box tests for each hierarchy representation
+class NodeBoxTest
+{
+public:
+	NodeBoxTest( const Box& box ) : _box( box ) {}
+
+	int operator()( const Plane& plane ) const
+	{
+		return Intersection::between( plane, _box );
+	}
+
+private:
+	const Box& _box;
+};
+
+class FlatBoxTest
+{
+public:
+	FlatBoxTest( const BoxArray& boxes, int index ) : _boxes( boxes ), _index( index ) {}
+
+	int operator()( const Plane& plane ) const
+	{
+		return Intersection::between( plane, _boxes, _index );
+	}
+
+private:
+	const BoxArray& _boxes;
+	int _index;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Visible node outputs of linear hierarchy traversals
+
+// Reports to client callback right away
+class FrustumCuller::CallbackOutput
+{
+public:
+	CallbackOutput( FrustumCuller& culler, IFrustumCallback* callback ) : _culler( culler ), _callback( callback ) {}
+
+	void inside( const FlatTree& tree, int index )
+	{
+		_callback->inside( tree, index );
+	}
+
+	void insideGeometries( const FlatTree& tree, int index, unsigned int planeMask )
+	{
+		_culler.cullGeometries( tree, index, planeMask, _callback );
+	}
+
+private:
+	FrustumCuller& _culler;
+	IFrustumCallback* _callback;
+};
+
+// Keeps visible nodes in a thread buffer, leaves are reported whole
+class FrustumCuller::BufferOutput
+{
+public:
+	BufferOutput( std::vector<int>& indices ) : _indices( indices ) {}
+
+	void inside( const FlatTree& tree, int index )
+	{
+		_indices.push_back( index );
+	}
+
+	void insideGeometries( const FlatTree& tree, int index, unsigned int planeMask )
+	{
+		_indices.push_back( index );
+	}
+
+private:
+	std::vector<int>& _indices;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Frustum callback
+void IFrustumCallback::inside( const FlatTree& tree, int index )
+{
+	// Mapped trees have no hierarchy nodes, this method must be overridden for them
+	Node* node = tree.getHierarchyNode( index );
+	assert( node != NULL );
+	if( node != NULL )
+		inside( node );
+}
+
+void IFrustumCallback::insideGeometries( const FlatTree& tree, int index, const std::vector<int>& geometries )
+{
+	inside( tree, index );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Utilities
+
+// Index of lowest bit set, mask must not be zero
+static unsigned int lowestBit( unsigned int mask )
+{
+	unsigned int i = 0;
+	while( ( mask & ( 1u << i ) ) == 0 )
+		++i;
+	return i;
+}
+
 FrustumCuller::CullingInfo::CullingInfo()
 {
 	planeId = 0;
@@ -14,44 +122,77 @@ FrustumCuller::CullingInfo::CullingInfo()
 // Frustum Culler
 //////////////////////////////////////////////////////////////////////////
 
+FrustumCuller::FrustumCuller()
+{
+	_batchTesting = true;
+	_geometryCulling = false;
+	_parallelTraversal = false;
+	_parallelTaskCount = 64;
+	_testedNodeCount = 0;
+}
+
 void FrustumCuller::init( const TreeBuilder::Statistics& stats )
 {
 	vr::vectorExactResize( _cullingInfo, stats.nodeCount );
 }
 
+void FrustumCuller::resetNodes( const std::vector<int>& ids )
+{
+	for( unsigned int i = 0; i < ids.size(); ++i )
+	{
+		if( ids[i] < (int)_cullingInfo.size() )
+			_cullingInfo[ids[i]] = CullingInfo();
+	}
+}
+
 void FrustumCuller::updateFrustumPlanes( const float* matrix )
+{
+	extractPlanes( matrix, _planes );
+}
+
+void FrustumCuller::extractPlanes( const float* matrix, Plane* planes )
 {
 	/**
 	*	IMPORTANT: accessing matrix as transpose since OpenGL matrix is column-major
 	*/
 	// Near clipping plane
-	_planes[0].set( matrix[3] + matrix[2], matrix[7] + matrix[6], matrix[11] + matrix[10], matrix[15] + matrix[14] );
+	planes[0].set( matrix[3] + matrix[2], matrix[7] + matrix[6], matrix[11] + matrix[10], matrix[15] + matrix[14] );
 
 	// Left clipping plane
-	_planes[1].set( matrix[3] + matrix[0], matrix[7] + matrix[4], matrix[11] + matrix[8], matrix[15] + matrix[12] );
+	planes[1].set( matrix[3] + matrix[0], matrix[7] + matrix[4], matrix[11] + matrix[8], matrix[15] + matrix[12] );
 
 	// Right clipping plane
-	_planes[2].set( matrix[3] - matrix[0], matrix[7] - matrix[4], matrix[11] - matrix[8], matrix[15] - matrix[12] );
+	planes[2].set( matrix[3] - matrix[0], matrix[7] - matrix[4], matrix[11] - matrix[8], matrix[15] - matrix[12] );
 
 	// Bottom clipping plane
-	_planes[3].set( matrix[3] + matrix[1], matrix[7] + matrix[5], matrix[11] + matrix[9], matrix[15] + matrix[13] );
+	planes[3].set( matrix[3] + matrix[1], matrix[7] + matrix[5], matrix[11] + matrix[9], matrix[15] + matrix[13] );
 
 	// Top clipping plane
-	_planes[4].set( matrix[3] - matrix[1], matrix[7] - matrix[5], matrix[11] - matrix[9], matrix[15] - matrix[13] );
+	planes[4].set( matrix[3] - matrix[1], matrix[7] - matrix[5], matrix[11] - matrix[9], matrix[15] - matrix[13] );
 
 	// Far clipping plane
-	_planes[5].set( matrix[3] - matrix[2], matrix[7] - matrix[6], matrix[11] - matrix[10], matrix[15] - matrix[14] );
+	planes[5].set( matrix[3] - matrix[2], matrix[7] - matrix[6], matrix[11] - matrix[10], matrix[15] - matrix[14] );
 
 	// Normalize planes
-	_planes[0].normalize();
-	_planes[1].normalize();
-	_planes[2].normalize();
-	_planes[3].normalize();
-	_planes[4].normalize();
-	_planes[5].normalize();
+	planes[0].normalize();
+	planes[1].normalize();
+	planes[2].normalize();
+	planes[3].normalize();
+	planes[4].normalize();
+	planes[5].normalize();
 }
 
 bool FrustumCuller::contains( Node* node )
+{
+	return contains( node, _testedNodeCount );
+}
+
+bool FrustumCuller::contains( const FlatTree& tree, int index )
+{
+	return contains( tree, index, _testedNodeCount );
+}
+
+bool FrustumCuller::contains( Node* node, int& testedNodes )
 {
 	CullingInfo& nodeInfo = _cullingInfo[node->getId()];
 
@@ -59,6 +200,436 @@ bool FrustumCuller::contains( Node* node )
 	// Therefore, there is no need to test the current Node's bounding volume against these same planes.
 	unsigned int planeMask = getParentCullingMask( node );
 
+	return contains( nodeInfo, planeMask, NodeBoxTest( node->getBoundingBox() ), testedNodes );
+}
+
+bool FrustumCuller::contains( const FlatTree& tree, int index, int& testedNodes )
+{
+	CullingInfo& nodeInfo = _cullingInfo[index];
+
+	// Same as above, parent index equals parent id
+	int parent = tree.getFlatNode( index ).parent;
+	unsigned int planeMask = ( parent >= 0 ) ? _cullingInfo[parent].planeMask : 0xFFFFFFFF;
+
+	return contains( nodeInfo, planeMask, FlatBoxTest( tree.getBoxes(), index ), testedNodes );
+}
+
+void FrustumCuller::traverse( Node* node, IFrustumCallback* callback )
+{
+	_testedNodeCount = 0;
+
+#ifdef _OPENMP
+	const int threadCount = omp_get_max_threads();
+	if( _parallelTraversal && threadCount > 1 )
+	{
+		traverseParallel( node, callback, threadCount );
+		return;
+	}
+#endif
+
+	_itr.begin( node );
+	while( !_itr.done() )
+	{
+		if( contains( _itr.current() ) )
+		{
+			callback->inside( _itr.current() );
+			_itr.next();
+		}
+		else
+		{
+			_itr.skip();
+		}
+	}
+}
+
+void FrustumCuller::traverse( const FlatTree& tree, IFrustumCallback* callback )
+{
+	_testedNodeCount = 0;
+
+#ifdef _OPENMP
+	const int threadCount = omp_get_max_threads();
+	if( _parallelTraversal && threadCount > 1 )
+	{
+		traverseParallel( tree, callback, threadCount );
+		return;
+	}
+#endif
+
+	CallbackOutput output( *this, callback );
+	if( _batchTesting )
+		traverseBatch( tree, 0, _batchStack, output, _testedNodeCount );
+	else
+		traverseSkip( tree, 0, output, _testedNodeCount );
+}
+
+int FrustumCuller::getTestedNodeCount() const
+{
+	return _testedNodeCount;
+}
+
+void FrustumCuller::setBatchTesting( bool enabled )
+{
+	_batchTesting = enabled;
+}
+
+bool FrustumCuller::getBatchTesting() const
+{
+	return _batchTesting;
+}
+
+void FrustumCuller::setGeometryCulling( bool enabled )
+{
+	_geometryCulling = enabled;
+}
+
+bool FrustumCuller::getGeometryCulling() const
+{
+	return _geometryCulling;
+}
+
+void FrustumCuller::setParallelTraversal( bool enabled )
+{
+	_parallelTraversal = enabled;
+}
+
+bool FrustumCuller::getParallelTraversal() const
+{
+	return _parallelTraversal;
+}
+
+void FrustumCuller::setParallelTaskCount( int count )
+{
+	_parallelTaskCount = vr::max( count, 1 );
+}
+
+int FrustumCuller::getParallelTaskCount() const
+{
+	return _parallelTaskCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+template<class Output>
+void FrustumCuller::traverseSkip( const FlatTree& tree, int root, Output& output, int& testedNodes )
+{
+	int index = root;
+	const int end = tree.getFlatNode( root ).skip;
+
+	while( index < end )
+	{
+		if( contains( tree, index, testedNodes ) )
+		{
+			output.inside( tree, index );
+			++index;
+		}
+		else
+		{
+			index = tree.getFlatNode( index ).skip;
+		}
+	}
+}
+
+template<class Output>
+void FrustumCuller::traverseBatch( const FlatTree& tree, int root, std::vector<int>& stack, Output& output, int& testedNodes )
+{
+	BoxBatchResult result;
+	int indices[BoxBatchResult::Batch_Size];
+	unsigned int planeMasks[BoxBatchResult::Batch_Size];
+
+	stack.resize( 0 );
+	stack.push_back( root );
+
+	while( !stack.empty() )
+	{
+		// Gather a batch of pending nodes
+		int count = 0;
+		while( ( count < BoxBatchResult::Batch_Size ) && !stack.empty() )
+		{
+			int index = stack.back();
+			stack.pop_back();
+
+			// Parent index equals parent id
+			int parent = tree.getFlatNode( index ).parent;
+			unsigned int planeMask = ( parent >= 0 ) ? _cullingInfo[parent].planeMask : 0xFFFFFFFF;
+
+			// If parent is totally inside view frustum, so is the entire subtree
+			if( planeMask == 0xFFFFFFC0 )
+			{
+				insideSubtree( tree, index, output );
+				continue;
+			}
+
+			indices[count] = index;
+			planeMasks[count] = planeMask;
+			++count;
+		}
+
+		if( count == 0 )
+			continue;
+
+		// Test all frustum planes at once
+		Intersection::between( _planes, 6, tree.getBoxes(), indices, count, result );
+		testedNodes += count;
+
+		for( int i = 0; i < count; ++i )
+		{
+			const int index = indices[i];
+			CullingInfo& nodeInfo = _cullingInfo[index];
+			unsigned int planeMask = planeMasks[i];
+
+			// Same as contains(): ignore planes for which the parent was found to be totally inside
+			unsigned int outsidePlanes = result.outsidePlanes[i] & planeMask;
+			if( outsidePlanes != 0 )
+			{
+				nodeInfo.planeMask = planeMask;
+				nodeInfo.planeId = lowestBit( outsidePlanes );
+				continue;
+			}
+
+			// No need to test these planes anymore
+			planeMask ^= ( result.insidePlanes[i] & planeMask & 0x3F );
+			nodeInfo.planeMask = planeMask;
+
+			const FlatTree::FlatNode& flatNode = tree.getFlatNode( index );
+
+			if( flatNode.rightChild >= 0 )
+			{
+				output.inside( tree, index );
+
+				// Push right child first, so that left subtree is visited first
+				stack.push_back( flatNode.rightChild );
+				stack.push_back( index + 1 );
+			}
+			else if( _geometryCulling && ( planeMask != 0xFFFFFFC0 ) && ( flatNode.geometryCount > 1 ) )
+			{
+				output.insideGeometries( tree, index, planeMask );
+			}
+			else
+			{
+				output.inside( tree, index );
+			}
+		}
+	}
+}
+
+template<class Output>
+void FrustumCuller::insideSubtree( const FlatTree& tree, int index, Output& output )
+{
+	const int skip = tree.getFlatNode( index ).skip;
+
+	for( int i = index; i < skip; ++i )
+	{
+		_cullingInfo[i].planeMask = 0xFFFFFFC0;
+		output.inside( tree, i );
+	}
+}
+
+void FrustumCuller::traverseParallel( Node* node, IFrustumCallback* callback, int threadCount )
+{
+	// Cull the top of the hierarchy one level at a time, until there are enough subtrees.
+	// Leaves are left for the threads.
+	Task task;
+	task.node = node;
+	task.index = 0;
+	_tasks.assign( 1, task );
+
+	while( (int)_tasks.size() < _parallelTaskCount )
+	{
+		bool expanded = false;
+		_nextTasks.resize( 0 );
+
+		for( unsigned int i = 0; i < _tasks.size(); ++i )
+		{
+			Node* current = _tasks[i].node;
+			if( current->isLeaf() )
+			{
+				_nextTasks.push_back( _tasks[i] );
+				continue;
+			}
+
+			expanded = true;
+			if( contains( current ) )
+			{
+				callback->inside( current );
+				task.node = current->getLeftChild();
+				_nextTasks.push_back( task );
+				task.node = current->getRightChild();
+				_nextTasks.push_back( task );
+			}
+		}
+
+		_tasks.swap( _nextTasks );
+		if( !expanded )
+			break;
+	}
+
+	_threads.resize( threadCount );
+	for( int t = 0; t < threadCount; ++t )
+	{
+		_threads[t].nodes.resize( 0 );
+		_threads[t].testedNodes = 0;
+	}
+
+	// Subtrees are disjoint: each node's culling information is only written by one thread.
+	// Subtree roots read culling information of their parents, written above.
+	const int taskCount = (int)_tasks.size();
+
+	#pragma omp parallel for schedule( dynamic, 1 )
+	for( int i = 0; i < taskCount; ++i )
+	{
+		Task& current = _tasks[i];
+#ifdef _OPENMP
+		current.thread = omp_get_thread_num();
+#else
+		current.thread = 0;
+#endif
+		ThreadState& state = _threads[current.thread];
+		current.begin = (int)state.nodes.size();
+
+		PreOrderIterator& itr = state.iterator;
+		itr.begin( current.node );
+		while( !itr.done() )
+		{
+			if( contains( itr.current(), state.testedNodes ) )
+			{
+				state.nodes.push_back( itr.current() );
+				itr.next();
+			}
+			else
+			{
+				itr.skip();
+			}
+		}
+
+		current.end = (int)state.nodes.size();
+	}
+
+	for( int t = 0; t < threadCount; ++t )
+		_testedNodeCount += _threads[t].testedNodes;
+
+	// Report in task order, so that results do not depend on scheduling
+	for( int i = 0; i < taskCount; ++i )
+	{
+		const Task& current = _tasks[i];
+		const std::vector<Node*>& nodes = _threads[current.thread].nodes;
+		for( int n = current.begin; n < current.end; ++n )
+			callback->inside( nodes[n] );
+	}
+}
+
+void FrustumCuller::traverseParallel( const FlatTree& tree, IFrustumCallback* callback, int threadCount )
+{
+	// Same as above, using the linear hierarchy
+	Task task;
+	task.node = NULL;
+	task.index = 0;
+	_tasks.assign( 1, task );
+
+	while( (int)_tasks.size() < _parallelTaskCount )
+	{
+		bool expanded = false;
+		_nextTasks.resize( 0 );
+
+		for( unsigned int i = 0; i < _tasks.size(); ++i )
+		{
+			const int index = _tasks[i].index;
+			const FlatTree::FlatNode& flatNode = tree.getFlatNode( index );
+			if( flatNode.rightChild < 0 )
+			{
+				_nextTasks.push_back( _tasks[i] );
+				continue;
+			}
+
+			expanded = true;
+			if( contains( tree, index ) )
+			{
+				callback->inside( tree, index );
+				task.index = index + 1;
+				_nextTasks.push_back( task );
+				task.index = flatNode.rightChild;
+				_nextTasks.push_back( task );
+			}
+		}
+
+		_tasks.swap( _nextTasks );
+		if( !expanded )
+			break;
+	}
+
+	_threads.resize( threadCount );
+	for( int t = 0; t < threadCount; ++t )
+	{
+		_threads[t].indices.resize( 0 );
+		_threads[t].testedNodes = 0;
+	}
+
+	const int taskCount = (int)_tasks.size();
+
+	#pragma omp parallel for schedule( dynamic, 1 )
+	for( int i = 0; i < taskCount; ++i )
+	{
+		Task& current = _tasks[i];
+#ifdef _OPENMP
+		current.thread = omp_get_thread_num();
+#else
+		current.thread = 0;
+#endif
+		ThreadState& state = _threads[current.thread];
+		current.begin = (int)state.indices.size();
+
+		BufferOutput output( state.indices );
+		if( _batchTesting )
+			traverseBatch( tree, current.index, state.stack, output, state.testedNodes );
+		else
+			traverseSkip( tree, current.index, output, state.testedNodes );
+
+		current.end = (int)state.indices.size();
+	}
+
+	for( int t = 0; t < threadCount; ++t )
+		_testedNodeCount += _threads[t].testedNodes;
+
+	for( int i = 0; i < taskCount; ++i )
+	{
+		const Task& current = _tasks[i];
+		const std::vector<int>& indices = _threads[current.thread].indices;
+		for( int n = current.begin; n < current.end; ++n )
+			callback->inside( tree, indices[n] );
+	}
+}
+
+void FrustumCuller::cullGeometries( const FlatTree& tree, int index, unsigned int planeMask, IFrustumCallback* callback )
+{
+	const FlatTree::FlatNode& flatNode = tree.getFlatNode( index );
+	const int end = flatNode.geometryStart + flatNode.geometryCount;
+
+	BoxBatchResult result;
+	int indices[BoxBatchResult::Batch_Size];
+
+	_visibleGeometries.resize( 0 );
+
+	for( int first = flatNode.geometryStart; first < end; first += BoxBatchResult::Batch_Size )
+	{
+		int count = vr::min( (int)BoxBatchResult::Batch_Size, end - first );
+		for( int i = 0; i < count; ++i )
+			indices[i] = first + i;
+
+		Intersection::between( _planes, 6, tree.getGeometryBoxes(), indices, count, result );
+
+		for( int i = 0; i < count; ++i )
+		{
+			if( ( result.outsidePlanes[i] & planeMask ) == 0 )
+				_visibleGeometries.push_back( indices[i] );
+		}
+	}
+
+	if( !_visibleGeometries.empty() )
+		callback->insideGeometries( tree, index, _visibleGeometries );
+}
+
+template<class BoxTest>
+bool FrustumCuller::contains( CullingInfo& nodeInfo, unsigned int planeMask, const BoxTest& boxTest, int& testedNodes )
+{
 	// First of all, check if parent Node is not already totally inside view frustum.
 	// If it is, just seeking which frustum plane we still need to test ( which is none ) would be a waste of time.
 	if( planeMask == 0xFFFFFFC0 )
@@ -68,8 +639,7 @@ bool FrustumCuller::contains( Node* node )
 		return true;
 	}
 
-	// Node's bounding volume for plane intersection
-	const Box& box = node->getBoundingBox();
+	++testedNodes;
 
 	// If result < 0, the bounding volume is on the negative half-space of the plane (totally outside the view frustum)
 	// If result > 0, the bounding volume is on the positive half-space of the plane (totally inside the view frustum)
@@ -86,7 +656,7 @@ bool FrustumCuller::contains( Node* node )
 	// But only if parent Node was not already found to be totally inside this particular plane.
 	if( selectorMask & planeMask )
 	{
-		result = Intersection::between( _planes[cullingPlane], box );
+		result = boxTest( _planes[cullingPlane] );
 
 		if( result < 0 )
 		{
@@ -106,7 +676,7 @@ bool FrustumCuller::contains( Node* node )
 		// Check if we need to test the current plane
 		if( selectorMask & planeMask )
 		{
-			result = Intersection::between( _planes[i], box );
+			result = boxTest( _planes[i] );
 
 			if( result < 0 )
 			{
@@ -130,25 +700,6 @@ bool FrustumCuller::contains( Node* node )
 	return true;
 }
 
-void FrustumCuller::traverse( Node* node, IFrustumCallback* callback )
-{
-	_itr.begin( node );
-	while( !_itr.done() )
-	{
-		if( contains( _itr.current() ) )
-		{
-			callback->inside( _itr.current() );
-			_itr.next();
-		}
-		else
-		{
-			_itr.skip();
-		}
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////
-// Private
 unsigned int FrustumCuller::getParentCullingMask( Node* node ) const
 {
 	if( node->getParent() != NULL )
@@ -3,6 +3,12 @@
 #include <vdlib/Box.h>
 #include <vdlib/Distance.h>
 
+#if defined( VDLIB_AVX )
+	#include <immintrin.h>
+#elif defined( VDLIB_SSE )
+	#include <xmmintrin.h>
+#endif
+
 using namespace vdlib;
 
 int Intersection::between( const Plane& plane, const Box& box )
@@ -23,3 +29,200 @@ int Intersection::between( const Plane& plane, const Box& box )
 	// Intersected
 	return 0;
 }
+
+int Intersection::between( const Plane& plane, const BoxArray& boxes, int index )
+{
+	const vr::vec3f& n = plane.normal;
+
+	const float projectedCenter = n.x * boxes.center[0][index] + 
+	                              n.y * boxes.center[1][index] + 
+	                              n.z * boxes.center[2][index] + plane.position;
+
+	float projectedRadius = 0.0f;
+	for( unsigned int a = 0; a < 3; ++a )
+	{
+		projectedRadius += vr::abs( n.x * boxes.axis[a][0][index] + 
+		                            n.y * boxes.axis[a][1][index] + 
+		                            n.z * boxes.axis[a][2][index] ) * boxes.extents[a][index];
+	}
+
+	// Totally inside
+	if( projectedCenter >= projectedRadius )
+		return +1;
+
+	// Totally outside
+	if( projectedCenter <= ( -projectedRadius ) )
+		return -1;
+
+	// Intersected
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Batch box classification
+
+// Store per-plane lane masks into per-box plane bits
+static void scatterPlaneBits( unsigned int laneMask, unsigned int planeBit, int first, int count, unsigned int* planes )
+{
+	for( int i = 0; i < count; ++i )
+	{
+		if( laneMask & ( 1u << i ) )
+			planes[first+i] |= planeBit;
+	}
+}
+
+#if defined( VDLIB_AVX )
+
+static const int Simd_Width = 8;
+
+// Classify 8 boxes, unused lanes repeat the last valid box
+static void classifyBoxes( const Plane* planes, int planeCount, const BoxArray& boxes, 
+                           const int* indices, int first, int count, BoxBatchResult& result )
+{
+	int idx[8];
+	for( int i = 0; i < 8; ++i )
+		idx[i] = indices[first + vr::min( i, count - 1 )];
+
+	#define VDLIB_GATHER( v ) _mm256_set_ps( v[idx[7]], v[idx[6]], v[idx[5]], v[idx[4]], v[idx[3]], v[idx[2]], v[idx[1]], v[idx[0]] )
+
+	const __m256 cx = VDLIB_GATHER( boxes.center[0] );
+	const __m256 cy = VDLIB_GATHER( boxes.center[1] );
+	const __m256 cz = VDLIB_GATHER( boxes.center[2] );
+	__m256 ax[3], ay[3], az[3], e[3];
+	for( int a = 0; a < 3; ++a )
+	{
+		ax[a] = VDLIB_GATHER( boxes.axis[a][0] );
+		ay[a] = VDLIB_GATHER( boxes.axis[a][1] );
+		az[a] = VDLIB_GATHER( boxes.axis[a][2] );
+		e[a]  = VDLIB_GATHER( boxes.extents[a] );
+	}
+
+	#undef VDLIB_GATHER
+
+	const __m256 signMask = _mm256_set1_ps( -0.0f );
+
+	for( int p = 0; p < planeCount; ++p )
+	{
+		const __m256 nx = _mm256_set1_ps( planes[p].normal.x );
+		const __m256 ny = _mm256_set1_ps( planes[p].normal.y );
+		const __m256 nz = _mm256_set1_ps( planes[p].normal.z );
+
+		__m256 projectedCenter = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( nx, cx ), _mm256_mul_ps( ny, cy ) ), 
+		                                        _mm256_add_ps( _mm256_mul_ps( nz, cz ), _mm256_set1_ps( planes[p].position ) ) );
+
+		__m256 projectedRadius = _mm256_setzero_ps();
+		for( int a = 0; a < 3; ++a )
+		{
+			__m256 dot = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( nx, ax[a] ), _mm256_mul_ps( ny, ay[a] ) ), _mm256_mul_ps( nz, az[a] ) );
+			projectedRadius = _mm256_add_ps( projectedRadius, _mm256_mul_ps( _mm256_andnot_ps( signMask, dot ), e[a] ) );
+		}
+
+		unsigned int insideLanes  = _mm256_movemask_ps( _mm256_cmp_ps( projectedCenter, projectedRadius, _CMP_GE_OQ ) );
+		unsigned int outsideLanes = _mm256_movemask_ps( _mm256_cmp_ps( projectedCenter, _mm256_xor_ps( projectedRadius, signMask ), _CMP_LE_OQ ) );
+
+		scatterPlaneBits( insideLanes, 1u << p, first, count, result.insidePlanes );
+		scatterPlaneBits( outsideLanes, 1u << p, first, count, result.outsidePlanes );
+	}
+}
+
+#elif defined( VDLIB_SSE )
+
+static const int Simd_Width = 4;
+
+// Classify 4 boxes, unused lanes repeat the last valid box
+static void classifyBoxes( const Plane* planes, int planeCount, const BoxArray& boxes, 
+                           const int* indices, int first, int count, BoxBatchResult& result )
+{
+	int idx[4];
+	for( int i = 0; i < 4; ++i )
+		idx[i] = indices[first + vr::min( i, count - 1 )];
+
+	#define VDLIB_GATHER( v ) _mm_set_ps( v[idx[3]], v[idx[2]], v[idx[1]], v[idx[0]] )
+
+	const __m128 cx = VDLIB_GATHER( boxes.center[0] );
+	const __m128 cy = VDLIB_GATHER( boxes.center[1] );
+	const __m128 cz = VDLIB_GATHER( boxes.center[2] );
+	__m128 ax[3], ay[3], az[3], e[3];
+	for( int a = 0; a < 3; ++a )
+	{
+		ax[a] = VDLIB_GATHER( boxes.axis[a][0] );
+		ay[a] = VDLIB_GATHER( boxes.axis[a][1] );
+		az[a] = VDLIB_GATHER( boxes.axis[a][2] );
+		e[a]  = VDLIB_GATHER( boxes.extents[a] );
+	}
+
+	#undef VDLIB_GATHER
+
+	const __m128 signMask = _mm_set1_ps( -0.0f );
+
+	for( int p = 0; p < planeCount; ++p )
+	{
+		const __m128 nx = _mm_set1_ps( planes[p].normal.x );
+		const __m128 ny = _mm_set1_ps( planes[p].normal.y );
+		const __m128 nz = _mm_set1_ps( planes[p].normal.z );
+
+		__m128 projectedCenter = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, cx ), _mm_mul_ps( ny, cy ) ), 
+		                                     _mm_add_ps( _mm_mul_ps( nz, cz ), _mm_set1_ps( planes[p].position ) ) );
+
+		__m128 projectedRadius = _mm_setzero_ps();
+		for( int a = 0; a < 3; ++a )
+		{
+			__m128 dot = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, ax[a] ), _mm_mul_ps( ny, ay[a] ) ), _mm_mul_ps( nz, az[a] ) );
+			projectedRadius = _mm_add_ps( projectedRadius, _mm_mul_ps( _mm_andnot_ps( signMask, dot ), e[a] ) );
+		}
+
+		unsigned int insideLanes  = _mm_movemask_ps( _mm_cmpge_ps( projectedCenter, projectedRadius ) );
+		unsigned int outsideLanes = _mm_movemask_ps( _mm_cmple_ps( projectedCenter, _mm_xor_ps( projectedRadius, signMask ) ) );
+
+		scatterPlaneBits( insideLanes, 1u << p, first, count, result.insidePlanes );
+		scatterPlaneBits( outsideLanes, 1u << p, first, count, result.outsidePlanes );
+	}
+}
+
+#else
+
+static const int Simd_Width = 1;
+
+// Scalar fallback, one box at a time
+static void classifyBoxes( const Plane* planes, int planeCount, const BoxArray& boxes, 
+                           const int* indices, int first, int count, BoxBatchResult& result )
+{
+	for( int p = 0; p < planeCount; ++p )
+	{
+		int test = Intersection::between( planes[p], boxes, indices[first] );
+
+		if( test > 0 )
+			result.insidePlanes[first] |= 1u << p;
+		else if( test < 0 )
+			result.outsidePlanes[first] |= 1u << p;
+	}
+}
+
+#endif
+
+void Intersection::between( const Plane* planes, int planeCount, const BoxArray& boxes, 
+                            const int* indices, int count, BoxBatchResult& result )
+{
+	const unsigned int allPlanes = ( planeCount < 32 ) ? ( ( 1u << planeCount ) - 1 ) : 0xFFFFFFFF;
+
+	for( int i = 0; i < count; ++i )
+	{
+		result.insidePlanes[i] = 0;
+		result.outsidePlanes[i] = 0;
+	}
+
+	for( int first = 0; first < count; first += Simd_Width )
+		classifyBoxes( planes, planeCount, boxes, indices, first, vr::min( Simd_Width, count - first ), result );
+
+	// Summary masks
+	result.insideMask = 0;
+	result.outsideMask = 0;
+
+	for( int i = 0; i < count; ++i )
+	{
+		if( result.outsidePlanes[i] != 0 )
+			result.outsideMask |= 1u << i;
+		else if( result.insidePlanes[i] == allPlanes )
+			result.insideMask |= 1u << i;
+	}
+}
@@ -0,0 +1,84 @@
+#include <vdlib/LatencyQueryBackend.h>
+
+using namespace vdlib;
+
+LatencyQueryBackend::LatencyQueryBackend( IOcclusionQueryBackend* backend, int latency )
+{
+	_backend = backend;
+	_latency = latency;
+	_clock = 0;
+	_stallCount = 0;
+}
+
+void LatencyQueryBackend::setLatency( int latency )
+{
+	_latency = latency;
+}
+
+int LatencyQueryBackend::getLatency() const
+{
+	return _latency;
+}
+
+int LatencyQueryBackend::getStallCount() const
+{
+	return _stallCount;
+}
+
+void LatencyQueryBackend::resetStallCount()
+{
+	_stallCount = 0;
+}
+
+void LatencyQueryBackend::init( int queryCount )
+{
+	_backend->init( queryCount );
+	vr::vectorExactResize( _issueTimes, queryCount );
+}
+
+void LatencyQueryBackend::setExactCounts( bool enabled )
+{
+	_backend->setExactCounts( enabled );
+}
+
+void LatencyQueryBackend::beginFrame( unsigned int visibilityThreshold )
+{
+	// Traversals fetch all results before returning, so time can restart every frame
+	_clock = 0;
+	_backend->beginFrame( visibilityThreshold );
+}
+
+void LatencyQueryBackend::issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount )
+{
+	_issueTimes[queryId] = ++_clock;
+	_backend->issueBoundingBoxQuery( queryId, boxes, boxCount );
+}
+
+void LatencyQueryBackend::beginGeometryQuery( int queryId, const Box& box )
+{
+	_issueTimes[queryId] = ++_clock;
+	_backend->beginGeometryQuery( queryId, box );
+}
+
+void LatencyQueryBackend::endGeometryQuery( int queryId )
+{
+	_backend->endGeometryQuery( queryId );
+}
+
+bool LatencyQueryBackend::isResultAvailable( int queryId )
+{
+	++_clock;
+	return ( _clock - _issueTimes[queryId] ) >= _latency && _backend->isResultAvailable( queryId );
+}
+
+unsigned int LatencyQueryBackend::getResult( int queryId )
+{
+	// Waiting for the result advances time
+	if( ( _clock - _issueTimes[queryId] ) < _latency )
+	{
+		++_stallCount;
+		_clock = _issueTimes[queryId] + _latency;
+	}
+
+	return _backend->getResult( queryId );
+}
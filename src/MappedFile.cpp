@@ -0,0 +1,138 @@
+#include <vdlib/MappedFile.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace vdlib;
+
+MappedFile::MappedFile()
+{
+	_data = NULL;
+	_size = 0;
+#ifdef _WIN32
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open( const char* filename )
+{
+	close();
+
+	_file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( _file == INVALID_HANDLE_VALUE )
+		return false;
+
+	// Files over 4 GB can only be mapped in 64-bit processes
+	DWORD sizeHigh = 0;
+	DWORD sizeLow = GetFileSize( _file, &sizeHigh );
+	const vr::uint64 size = ( (vr::uint64)sizeHigh << 32 ) | sizeLow;
+	if( size == 0 || size > (vr::uint64)(size_t)-1 )
+	{
+		close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA( _file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( _mapping == NULL )
+	{
+		close();
+		return false;
+	}
+
+	_data = (char*)MapViewOfFile( _mapping, FILE_MAP_COPY, 0, 0, 0 );
+	if( _data == NULL )
+	{
+		close();
+		return false;
+	}
+
+	_size = (size_t)size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if( _data != NULL )
+		UnmapViewOfFile( _data );
+
+	if( _mapping != NULL )
+		CloseHandle( _mapping );
+
+	if( _file != INVALID_HANDLE_VALUE )
+		CloseHandle( _file );
+
+	_data = NULL;
+	_size = 0;
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+}
+
+#else
+
+bool MappedFile::open( const char* filename )
+{
+	close();
+
+	int file = ::open( filename, O_RDONLY );
+	if( file < 0 )
+		return false;
+
+	struct stat info;
+	if( fstat( file, &info ) != 0 || info.st_size == 0 || (vr::uint64)info.st_size > (vr::uint64)(size_t)-1 )
+	{
+		::close( file );
+		return false;
+	}
+
+	void* data = mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0 );
+
+	// Mapping remains valid after the descriptor is closed
+	::close( file );
+
+	if( data == MAP_FAILED )
+		return false;
+
+	_data = (char*)data;
+	_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if( _data != NULL )
+		munmap( _data, _size );
+
+	_data = NULL;
+	_size = 0;
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+	return _data != NULL;
+}
+
+char* MappedFile::getData() const
+{
+	return _data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return _size;
+}
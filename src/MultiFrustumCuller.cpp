@@ -0,0 +1,277 @@
+#include <vdlib/MultiFrustumCuller.h>
+#include <vdlib/FrustumCuller.h>
+#include <vdlib/Intersection.h>
+#include <vdlib/Node.h>
+
+using namespace vdlib;
+
+MultiFrustumCuller::MultiFrustumCuller()
+{
+	_viewCount = 1;
+	_testedNodeCount = 0;
+}
+
+void MultiFrustumCuller::setViewCount( int count )
+{
+	_viewCount = vr::clampTo( count, 1, (int)Max_Views );
+}
+
+int MultiFrustumCuller::getViewCount() const
+{
+	return _viewCount;
+}
+
+void MultiFrustumCuller::updateFrustumPlanes( int view, const float* matrix )
+{
+	FrustumCuller::extractPlanes( matrix, &_planes[view * 6] );
+}
+
+void MultiFrustumCuller::traverse( Node* root )
+{
+	clearResults();
+
+	Pending pending;
+	pending.node = root;
+	pending.index = 0;
+	pending.viewMask = ( 1u << _viewCount ) - 1;
+	for( int v = 0; v < Max_Views; ++v )
+		pending.planeMasks[v] = 0x3F;
+
+	_stack.assign( 1, pending );
+
+	while( !_stack.empty() )
+	{
+		Pending current = _stack.back();
+		_stack.pop_back();
+
+		// Box is read once for all views
+		const Box& box = current.node->getBoundingBox();
+		const unsigned int testedViews = getTestedViews( current );
+		if( testedViews != 0 )
+			++_testedNodeCount;
+
+		for( int v = 0; v < _viewCount; ++v )
+		{
+			if( ( testedViews & ( 1u << v ) ) && !contains( box, v, current.planeMasks[v] ) )
+				current.viewMask &= ~( 1u << v );
+		}
+
+		// Rejected by every view
+		if( current.viewMask == 0 )
+			continue;
+
+		for( int v = 0; v < _viewCount; ++v )
+		{
+			if( current.viewMask & ( 1u << v ) )
+				_visibleNodes[v].push_back( current.node );
+		}
+
+		if( current.node->isLeaf() )
+			continue;
+
+		// Push right child first, so that left subtree is visited first
+		Node* left = current.node->getLeftChild();
+		current.node = current.node->getRightChild();
+		_stack.push_back( current );
+		current.node = left;
+		_stack.push_back( current );
+	}
+}
+
+void MultiFrustumCuller::traverse( const FlatTree& tree )
+{
+	clearResults();
+
+	if( tree.getNodeCount() == 0 )
+		return;
+
+	Pending pending;
+	pending.node = NULL;
+	pending.index = 0;
+	pending.viewMask = ( 1u << _viewCount ) - 1;
+	for( int v = 0; v < Max_Views; ++v )
+		pending.planeMasks[v] = 0x3F;
+
+	_stack.assign( 1, pending );
+
+	BoxBatchResult result;
+	int indices[BoxBatchResult::Batch_Size];
+	Pending batch[BoxBatchResult::Batch_Size];
+
+	while( !_stack.empty() )
+	{
+		// Gather a batch of pending nodes
+		int count = 0;
+		while( ( count < BoxBatchResult::Batch_Size ) && !_stack.empty() )
+		{
+			const Pending& current = _stack.back();
+
+			// Totally inside every view that still sees it
+			if( getTestedViews( current ) == 0 )
+				insideSubtree( tree, current.index, current.viewMask );
+			else
+			{
+				batch[count] = current;
+				indices[count] = current.index;
+				++count;
+			}
+
+			_stack.pop_back();
+		}
+
+		if( count == 0 )
+			continue;
+
+		_testedNodeCount += count;
+
+		// Only planes still needed by some node of the batch are tested
+		unsigned char batchPlanes[Max_Views] = { 0 };
+		for( int i = 0; i < count; ++i )
+		{
+			for( int v = 0; v < _viewCount; ++v )
+			{
+				if( batch[i].viewMask & ( 1u << v ) )
+					batchPlanes[v] |= batch[i].planeMasks[v];
+			}
+		}
+
+		int planeCount = 0;
+		for( int v = 0; v < _viewCount; ++v )
+		{
+			for( int p = 0; p < 6; ++p )
+			{
+				if( batchPlanes[v] & ( 1u << p ) )
+				{
+					_batchPlanes[planeCount] = _planes[v * 6 + p];
+					_batchPlaneViews[planeCount] = v;
+					_batchPlaneBits[planeCount] = (unsigned char)( 1u << p );
+					++planeCount;
+				}
+			}
+		}
+
+		// Boxes are gathered once for up to 32 planes
+		for( int first = 0; first < planeCount; first += 32 )
+		{
+			const int groupCount = vr::min( 32, planeCount - first );
+			Intersection::between( &_batchPlanes[first], groupCount, tree.getBoxes(), indices, count, result );
+
+			for( int i = 0; i < count; ++i )
+			{
+				Pending& current = batch[i];
+
+				for( int p = 0; p < groupCount; ++p )
+				{
+					// Ignore views that rejected the node and planes for which the parent was found to be totally inside
+					const int v = _batchPlaneViews[first + p];
+					const unsigned char planeBit = _batchPlaneBits[first + p];
+					if( ( current.viewMask & ( 1u << v ) ) == 0 || ( current.planeMasks[v] & planeBit ) == 0 )
+						continue;
+
+					if( result.outsidePlanes[i] & ( 1u << p ) )
+						current.viewMask &= ~( 1u << v );
+					else if( result.insidePlanes[i] & ( 1u << p ) )
+						current.planeMasks[v] = (unsigned char)( current.planeMasks[v] & ~planeBit );
+				}
+			}
+		}
+
+		for( int i = 0; i < count; ++i )
+		{
+			Pending& current = batch[i];
+			if( current.viewMask == 0 )
+				continue;
+
+			reportIndex( current.index, current.viewMask );
+
+			const FlatTree::FlatNode& flatNode = tree.getFlatNode( current.index );
+			if( flatNode.rightChild < 0 )
+				continue;
+
+			// Push right child first, so that left subtree is visited first
+			const int left = current.index + 1;
+			current.index = flatNode.rightChild;
+			_stack.push_back( current );
+			current.index = left;
+			_stack.push_back( current );
+		}
+	}
+}
+
+const std::vector<Node*>& MultiFrustumCuller::getVisibleNodes( int view ) const
+{
+	return _visibleNodes[view];
+}
+
+const std::vector<int>& MultiFrustumCuller::getVisibleIndices( int view ) const
+{
+	return _visibleIndices[view];
+}
+
+int MultiFrustumCuller::getTestedNodeCount() const
+{
+	return _testedNodeCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+unsigned int MultiFrustumCuller::getTestedViews( const Pending& pending ) const
+{
+	unsigned int views = 0;
+	for( int v = 0; v < _viewCount; ++v )
+	{
+		if( pending.planeMasks[v] != 0 )
+			views |= 1u << v;
+	}
+	return views & pending.viewMask;
+}
+
+bool MultiFrustumCuller::contains( const Box& box, int view, unsigned char& planeMask ) const
+{
+	const Plane* planes = &_planes[view * 6];
+
+	for( int i = 0; i < 6; ++i )
+	{
+		const unsigned char selectorMask = (unsigned char)( 1u << i );
+		if( ( planeMask & selectorMask ) == 0 )
+			continue;
+
+		const int result = Intersection::between( planes[i], box );
+		if( result < 0 )
+			return false;
+
+		// No need to test this plane anymore
+		if( result > 0 )
+			planeMask = (unsigned char)( planeMask & ~selectorMask );
+	}
+
+	return true;
+}
+
+void MultiFrustumCuller::reportIndex( int index, unsigned int viewMask )
+{
+	for( int v = 0; v < _viewCount; ++v )
+	{
+		if( viewMask & ( 1u << v ) )
+			_visibleIndices[v].push_back( index );
+	}
+}
+
+void MultiFrustumCuller::insideSubtree( const FlatTree& tree, int index, unsigned int viewMask )
+{
+	const int skip = tree.getFlatNode( index ).skip;
+
+	for( int i = index; i < skip; ++i )
+		reportIndex( i, viewMask );
+}
+
+void MultiFrustumCuller::clearResults()
+{
+	_testedNodeCount = 0;
+
+	for( int v = 0; v < Max_Views; ++v )
+	{
+		_visibleNodes[v].resize( 0 );
+		_visibleIndices[v].resize( 0 );
+	}
+}
@@ -19,6 +19,11 @@ int Node::getId() const
 	return _id;
 }
 
+void Node::setId( int id )
+{
+	_id = id;
+}
+
 Node* Node::getParent()
 {
 	return _parent;
@@ -26,7 +31,8 @@ Node* Node::getParent()
 
 void Node::setLeftChild( Node* child )
 {
-	child->_parent = this;
+	if( child != NULL )
+		child->_parent = this;
 	_leftChild = child;
 }
 
@@ -37,7 +43,8 @@ Node* Node::getLeftChild()
 
 void Node::setRightChild( Node* child )
 {
-	child->_parent = this;
+	if( child != NULL )
+		child->_parent = this;
 	_rightChild = child;
 }
 
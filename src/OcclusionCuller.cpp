@@ -1,71 +1,194 @@
 #include <vdlib/OcclusionCuller.h>
 #include <vdlib/Node.h>
-#include <vdlib/OpenGL.h>
 #include <vdlib/Intersection.h>
 #include <vdlib/Distance.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 using namespace vdlib;
 
+// Weight of newest query result in query history
+static const float History_Weight = 0.25f;
+
+// Near optimal: weight of prior estimate when a query is skipped
+static const float Skipped_History_Weight = 0.005f;
+
+// Longest time a query can be postponed, in frames
+static const int Max_Postponed_Frames = 16;
+
+// CHC++: start of the re-query random sequence, restarted by init()
+static const unsigned int Random_Seed = 1;
+
+//////////////////////////////////////////////////////////////////////////
+// Hierarchy access for the traversal template
+
+// Node hierarchy: handles are node pointers
+class NodeHierarchy
+{
+public:
+	typedef Node* Handle;
+
+	NodeHierarchy( IOcclusionCallback* callback, std::vector<Node*>& queriedNodes )
+	: _callback( callback ), _queriedNodes( queriedNodes ) {}
+
+	int getId( Node* node ) const { return node->getId(); }
+	bool isLeaf( Node* node ) const { return node->isLeaf(); }
+	int getGeometryCount( Node* node ) const { return (int)node->getGeometries().size(); }
+	const Box& getBoundingBox( Node* node ) { return node->getBoundingBox(); }
+
+	bool hasParent( Node* node ) const { return node->getParent() != NULL; }
+	Node* getParent( Node* node ) const { return node->getParent(); }
+
+	// Return number of valid children
+	int getChildren( Node* node, Node* children[2] ) const
+	{
+		int count = 0;
+		if( node->getLeftChild() != NULL )
+			children[count++] = node->getLeftChild();
+		if( node->getRightChild() != NULL )
+			children[count++] = node->getRightChild();
+		return count;
+	}
+
+	// Conversion for occlusion query manager, remember node until its result is processed
+	int getQueryId( Node* node )
+	{
+		_queriedNodes[node->getId()] = node;
+		return node->getId();
+	}
+	Node* getHandle( int queryId ) const { return _queriedNodes[queryId]; }
+
+	void draw( Node* node ) { _callback->draw( node ); }
+	bool isValid( Node* node ) { return _callback->isValid( node ); }
+
+private:
+	IOcclusionCallback* _callback;
+	std::vector<Node*>& _queriedNodes;
+};
+
+// FlatTree hierarchy: handles are flat indices (equal to node ids)
+class FlatHierarchy
+{
+public:
+	typedef int Handle;
+
+	FlatHierarchy( const FlatTree& tree, IOcclusionCallback* callback ) : _tree( tree ), _callback( callback ) {}
+
+	int getId( int index ) const { return index; }
+	bool isLeaf( int index ) const { return _tree.isLeaf( index ); }
+	int getGeometryCount( int index ) const { return _tree.getFlatNode( index ).geometryCount; }
+
+	// Returned box is only valid until next call
+	const Box& getBoundingBox( int index )
+	{
+		_tree.getBoxes().get( index, _box );
+		return _box;
+	}
+
+	bool hasParent( int index ) const { return _tree.getFlatNode( index ).parent >= 0; }
+	int getParent( int index ) const { return _tree.getFlatNode( index ).parent; }
+
+	// Return number of valid children
+	int getChildren( int index, int children[2] ) const
+	{
+		if( _tree.isLeaf( index ) )
+			return 0;
+
+		children[0] = index + 1;
+		children[1] = _tree.getFlatNode( index ).rightChild;
+		return 2;
+	}
+
+	// Conversion for occlusion query manager
+	int getQueryId( int index ) const { return index; }
+	int getHandle( int queryId ) const { return queryId; }
+
+	void draw( int index ) { _callback->draw( _tree, index ); }
+	bool isValid( int index ) { return _callback->isValid( _tree, index ); }
+
+private:
+	const FlatTree& _tree;
+	IOcclusionCallback* _callback;
+	Box _box;
+};
+
 //////////////////////////////////////////////////////////////////////////
-// Global functions
-void renderBoundingBox( Node* node )
-{
-	vr::vec3f vertices[8];
-	node->getBoundingBox().computeVertices( vertices );
-
-	glBegin( GL_QUADS );
-	// -z
-	glVertex3fv( vertices[0].ptr );
-	glVertex3fv( vertices[1].ptr );
-	glVertex3fv( vertices[5].ptr );
-	glVertex3fv( vertices[4].ptr );
-
-	// +x
-	glVertex3fv( vertices[1].ptr );
-	glVertex3fv( vertices[2].ptr );
-	glVertex3fv( vertices[6].ptr );
-	glVertex3fv( vertices[5].ptr );
-
-	// +z
-	glVertex3fv( vertices[2].ptr );
-	glVertex3fv( vertices[3].ptr );
-	glVertex3fv( vertices[7].ptr );
-	glVertex3fv( vertices[6].ptr );
-
-	// -x
-	glVertex3fv( vertices[3].ptr );
-	glVertex3fv( vertices[0].ptr );
-	glVertex3fv( vertices[4].ptr );
-	glVertex3fv( vertices[7].ptr );
-
-	// +y
-	glVertex3fv( vertices[4].ptr );
-	glVertex3fv( vertices[5].ptr );
-	glVertex3fv( vertices[6].ptr );
-	glVertex3fv( vertices[7].ptr );
-
-	// -y
-	glVertex3fv( vertices[0].ptr );
-	glVertex3fv( vertices[3].ptr );
-	glVertex3fv( vertices[2].ptr );
-	glVertex3fv( vertices[1].ptr );
-
-	glEnd();
+// IOcclusionCallback
+// Mapped trees have no hierarchy nodes, these methods must be overridden for them
+void IOcclusionCallback::draw( const FlatTree& tree, int index )
+{
+	Node* node = tree.getHierarchyNode( index );
+	assert( node != NULL );
+	if( node != NULL )
+		draw( node );
+}
+
+bool IOcclusionCallback::isValid( const FlatTree& tree, int index )
+{
+	Node* node = tree.getHierarchyNode( index );
+	assert( node != NULL );
+	return ( node == NULL ) || isValid( node );
 }
 
 //////////////////////////////////////////////////////////////////////////
 // OcclusionCuller
 OcclusionCuller::OcclusionCuller()
 : _distanceQueue( ClosestToViewpoint( _occlusionInfo ) )
+, _flatDistanceQueue( ClosestToViewpoint( _occlusionInfo ) )
 {
+	_traversalMode = Traversal_Chc;
+	_batchSize = 50;
+	_multiQueries = true;
+	_requeryInterval = 10;
+	_randomState = Random_Seed;
+	_queryCost = 0.1f;
+	_renderCostsValid = false;
+	_predictionConfidence = 1.0f;
+	_savedQueryCount = 0;
 	_visibilityThreshold = 0;
 	_frameId = 0;
 }
 
+void OcclusionCuller::setQueryBackend( IOcclusionQueryBackend* backend )
+{
+	_queryManager.setBackend( backend );
+}
+
+IOcclusionQueryBackend* OcclusionCuller::getQueryBackend() const
+{
+	return _queryManager.getBackend();
+}
+
 void OcclusionCuller::init( const TreeBuilder::Statistics& stats )
 {
+	// Nothing can be measured without a backend: leave culler uninitialized, traverse() will not run
+	assert( _queryManager.getBackend() != NULL );
+	if( _queryManager.getBackend() == NULL )
+	{
+		_queriedNodes.clear();
+		_occlusionInfo.clear();
+		return;
+	}
+
 	_queryManager.init( stats );
+	vr::vectorExactResize( _queriedNodes, stats.nodeCount );
 	vr::vectorExactResize( _occlusionInfo, stats.nodeCount );
+	_renderCostsValid = false;
+	_randomState = Random_Seed;
+}
+
+void OcclusionCuller::resetNodes( const std::vector<int>& ids )
+{
+	for( unsigned int i = 0; i < ids.size(); ++i )
+	{
+		if( ids[i] < (int)_occlusionInfo.size() )
+			_occlusionInfo[ids[i]] = OcclusionInfo();
+	}
+
+	// Subtree render costs changed
+	_renderCostsValid = false;
 }
 
 void OcclusionCuller::updateViewerParameters( const float* viewMatrix, const float* projectionMatrix )
@@ -99,72 +222,239 @@ unsigned int OcclusionCuller::getVisibilityThreshold() const
 	return _visibilityThreshold;
 }
 
+void OcclusionCuller::setTraversalMode( TraversalMode mode )
+{
+	_traversalMode = mode;
+}
+
+OcclusionCuller::TraversalMode OcclusionCuller::getTraversalMode() const
+{
+	return _traversalMode;
+}
+
+void OcclusionCuller::setBatchSize( int numNodes )
+{
+	_batchSize = vr::max( numNodes, 1 );
+}
+
+int OcclusionCuller::getBatchSize() const
+{
+	return _batchSize;
+}
+
+void OcclusionCuller::setMultiQueries( bool enabled )
+{
+	_multiQueries = enabled;
+}
+
+bool OcclusionCuller::getMultiQueries() const
+{
+	return _multiQueries;
+}
+
+void OcclusionCuller::setRequeryInterval( int numFrames )
+{
+	_requeryInterval = vr::max( numFrames, 1 );
+}
+
+int OcclusionCuller::getRequeryInterval() const
+{
+	return _requeryInterval;
+}
+
+int OcclusionCuller::randomRequeryOffset()
+{
+	// Numerical Recipes constants, high bits have the longest period
+	_randomState = _randomState * 1664525u + 1013904223u;
+	return (int)( ( _randomState >> 16 ) % (unsigned int)_requeryInterval );
+}
+
+void OcclusionCuller::setQueryCost( float cost )
+{
+	_queryCost = cost;
+}
+
+float OcclusionCuller::getQueryCost() const
+{
+	return _queryCost;
+}
+
+void OcclusionCuller::setPredictionConfidence( float confidence )
+{
+	_predictionConfidence = vr::clampTo( confidence, 0.0f, 1.0f );
+}
+
+float OcclusionCuller::getPredictionConfidence() const
+{
+	return _predictionConfidence;
+}
+
+int OcclusionCuller::getQueryCount() const
+{
+	return _queryManager.getQueryCount();
+}
+
+int OcclusionCuller::getSavedQueryCount() const
+{
+	return _savedQueryCount;
+}
+
 void OcclusionCuller::traverse( Node* node, IOcclusionCallback* callback )
 {
-	Node* currentNode;
-	bool queryAvailabe;
+	NodeHierarchy hierarchy( callback, _queriedNodes );
+	traverse( hierarchy, node, _distanceQueue );
+}
+
+void OcclusionCuller::traverse( const FlatTree& tree, IOcclusionCallback* callback )
+{
+	FlatHierarchy hierarchy( tree, callback );
+	traverse( hierarchy, 0, _flatDistanceQueue );
+}
 
-	_distanceQueue.push( node );
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// OcclusionInfo
+OcclusionCuller::OcclusionInfo::OcclusionInfo()
+{
+	lastVisited = -1;
+	lastRendered = -1;
+	visible = false;
+	distanceToViewpoint = 0.0f;
+	nextQueryFrame = 0;
+	invisibleFrames = 0;
+	lastResultVisible = true;
+	occludedAfterVisible = 0.5f;
+	occludedAfterOccluded = 0.5f;
+	renderCost = 0.0f;
+	lastVisiblePixels = 0;
+	postponedUntil = 0;
+}
+
+// ClosestToViewpoint
+OcclusionCuller::ClosestToViewpoint::ClosestToViewpoint( const OcclusionCuller::OcclusionInfoVector& info )
+: _info( info )
+{
+	// empty
+}
+
+bool OcclusionCuller::ClosestToViewpoint::operator()( const Node* first, const Node* second ) const
+{
+	return _info[first->getId()].distanceToViewpoint > _info[second->getId()].distanceToViewpoint;
+}
+
+bool OcclusionCuller::ClosestToViewpoint::operator()( int first, int second ) const
+{
+	return _info[first].distanceToViewpoint > _info[second].distanceToViewpoint;
+}
+
+// LongestInvisible
+OcclusionCuller::LongestInvisible::LongestInvisible( const OcclusionCuller::OcclusionInfoVector& info )
+: _info( info )
+{
+	// empty
+}
+
+bool OcclusionCuller::LongestInvisible::operator()( int first, int second ) const
+{
+	return _info[first].invisibleFrames > _info[second].invisibleFrames;
+}
+
+// OcclusionCuller
+template<class Hierarchy, class Queue>
+void OcclusionCuller::traverse( Hierarchy& hierarchy, typename Hierarchy::Handle root, Queue& distanceQueue )
+{
+	// Not initialized, or backend removed after init()
+	assert( _queryManager.getBackend() != NULL );
+	if( _occlusionInfo.empty() || _queryManager.getBackend() == NULL )
+		return;
+
+	distanceQueue.push( root );
 	++_frameId;
+	_savedQueryCount = 0;
+
+	// Prediction compares visible pixels between frames
+	_queryManager.beginFrame( _visibilityThreshold, _predictionConfidence < 1.0f );
+
+	if( _traversalMode == Traversal_NearOptimal && !_renderCostsValid )
+	{
+		computeRenderCosts( hierarchy, root );
+		_renderCostsValid = true;
+	}
+
+	if( _traversalMode == Traversal_ChcPlusPlus )
+		traverseChcPlusPlus( hierarchy, distanceQueue );
+	else
+		traverseChc( hierarchy, distanceQueue );
+}
+
+template<class Hierarchy, class Queue>
+void OcclusionCuller::traverseChc( Hierarchy& hierarchy, Queue& distanceQueue )
+{
+	typename Hierarchy::Handle currentNode;
+	bool queryAvailabe;
 
 	// Traverse hierarchy and render visible nodes
-	while( !_distanceQueue.empty() || !_queryManager.done() )
+	while( !distanceQueue.empty() || !_queryManager.done() )
 	{
 		//-- PART 1: Process finished occlusion queries for current frame
 		while( !_queryManager.done() && 
-			( ( queryAvailabe = _queryManager.frontResultAvailable() ) || _distanceQueue.empty() ) )
+			( ( queryAvailabe = _queryManager.frontResultAvailable() ) || distanceQueue.empty() ) )
 		{
 			// Current node
-			currentNode = _queryManager.popFrontNode();
+			currentNode = hierarchy.getHandle( _queryManager.getFrontNode( 0 ) );
+
+			// Get occlusion query result from backend
+			unsigned int visiblePixels = _queryManager.getFrontResult();
+			_queryManager.popFront();
 
-			// Get occlusion query result from OpenGL
-			unsigned int visiblePixels = _queryManager.getQueryResult( currentNode );
+			// Get occlusion information for this node
+			OcclusionInfo& currentInfo = _occlusionInfo[hierarchy.getId( currentNode )];
+			updateQueryHistory( currentInfo, visiblePixels );
 
 			// If visible
 			if( visiblePixels > _visibilityThreshold )
 			{
 				// Update this node's and its parent's visibility classifications
-				pullUpVisibility( currentNode );
-
-				// Get occlusion information for this node
-				OcclusionInfo& currentInfo = _occlusionInfo[currentNode->getId()];
+				pullUpVisibility( hierarchy, currentNode );
 
 				// Only need to render nodes that haven't already been rendered in current frame
 				if( currentInfo.lastRendered < _frameId )
 				{
 					currentInfo.lastRendered = _frameId;
-					callback->draw( currentNode );
-					pushChildren( currentNode );
+					hierarchy.draw( currentNode );
+					pushChildren( hierarchy, currentNode, distanceQueue );
 				}
 			}
 		}
 
 		//-- PART 2: Hierarchical traversal
-		if( _distanceQueue.empty() )
+		if( distanceQueue.empty() )
 			continue;
 
 		// Get next node to be traversed
-		currentNode = _distanceQueue.top();
-		_distanceQueue.pop();
+		currentNode = distanceQueue.top();
+		distanceQueue.pop();
 
 		// Skip invalid nodes
-		if( !callback->isValid( currentNode ) )
+		if( !hierarchy.isValid( currentNode ) )
 			continue;
 
 		// Get occlusion information for this node
-		OcclusionInfo& currentInfo = _occlusionInfo[currentNode->getId()];
+		OcclusionInfo& currentInfo = _occlusionInfo[hierarchy.getId( currentNode )];
 
 		// If a bounding volume intersects the near plane, we may have wrong query results.
 		// This is because of back-face culling, we will (wrongly) see through the internal sides of the box.
 		// In this case, we may find the box to be invisible since a part of it is not being rendered at all.
 		// Therefore, skip occlusion query and traverse node.
-		if( Intersection::between( _nearPlane, currentNode->getBoundingBox() ) == 0 )
+		if( Intersection::between( _nearPlane, hierarchy.getBoundingBox( currentNode ) ) == 0 )
 		{
-			pullUpVisibility( currentNode );
+			pullUpVisibility( hierarchy, currentNode );
 			currentInfo.lastVisited = _frameId;
 			currentInfo.lastRendered = _frameId;
-			callback->draw( currentNode );
-			pushChildren( currentNode );
+			hierarchy.draw( currentNode );
+			pushChildren( hierarchy, currentNode, distanceQueue );
 		}
 		else
 		{
@@ -179,24 +469,32 @@ void OcclusionCuller::traverse( Node* node, IOcclusionCallback* callback )
 
 			// A previously visible interior node is classified as an opened node.
 			// A previously invisible interior node or any kind of leaf node is classified as a termination node.
-			if( wasVisible )
+			if( isQueryPostponed( currentInfo, wasVisible, hierarchy.isLeaf( currentNode ) ) )
+			{
+				visitPostponed( hierarchy, currentNode, wasVisible );
+			}
+			else if( _traversalMode == Traversal_NearOptimal )
+			{
+				visitNearOptimal( hierarchy, currentNode, wasVisible, distanceQueue );
+			}
+			else if( wasVisible )
 			{
 				// Will render anyway for conservative culling
 				currentInfo.lastRendered = _frameId;
 
 				// Identify internal node
-				if( !currentNode->isLeaf() )
+				if( !hierarchy.isLeaf( currentNode ) )
 				{
 					// Opened node (visible internal node)
 					// Skip testing for occlusion query
-					pushChildren( currentNode );
+					pushChildren( hierarchy, currentNode, distanceQueue );
 				}
 				else
 				{
 					// Termination node (visible leaf node)
 					// Note: will query bounding volume if it is being rendered
-					_queryManager.beginGeometryQuery( currentNode );
-					callback->draw( currentNode );
+					_queryManager.beginGeometryQuery( hierarchy.getQueryId( currentNode ), hierarchy.getBoundingBox( currentNode ) );
+					hierarchy.draw( currentNode );
 					_queryManager.endGeometryQuery();
 				}
 			}
@@ -204,67 +502,400 @@ void OcclusionCuller::traverse( Node* node, IOcclusionCallback* callback )
 			{
 				// Termination node (invisible node)
 				// A previously invisible node (leaf or interior) needs to have its bounding volume tested for occlusion
-				_queryManager.beginBoundingVolumeQuery( currentNode );
-				renderBoundingBox( currentNode );
-				_queryManager.endBoundingVolumeQuery();
+				_queryManager.issueBoundingVolumeQuery( hierarchy.getQueryId( currentNode ), hierarchy.getBoundingBox( currentNode ) );
 			}
 		}
 	}
 }
 
-//////////////////////////////////////////////////////////////////////////
-// Private
-//////////////////////////////////////////////////////////////////////////
+template<class Hierarchy, class Queue>
+void OcclusionCuller::traverseChcPlusPlus( Hierarchy& hierarchy, Queue& distanceQueue )
+{
+	typename Hierarchy::Handle currentNode;
 
-// OcclusionInfo
-OcclusionCuller::OcclusionInfo::OcclusionInfo()
+	// Traverse hierarchy and render visible nodes
+	while( !distanceQueue.empty() || !_queryManager.done() )
+	{
+		//-- PART 1: Process finished occlusion queries, 
+		// use waiting time to issue queries for previously visible nodes
+		while( !_queryManager.done() )
+		{
+			if( _queryManager.frontResultAvailable() )
+				handleReturnedQuery( hierarchy, distanceQueue );
+			else if( !_visibleQueue.empty() )
+				issueVisibleQuery( hierarchy );
+			else if( distanceQueue.empty() )
+				handleReturnedQuery( hierarchy, distanceQueue ); // Nothing else to do, wait for result
+			else
+				break;
+		}
+
+		//-- PART 2: Hierarchical traversal
+		if( !distanceQueue.empty() )
+		{
+			// Get next node to be traversed
+			currentNode = distanceQueue.top();
+			distanceQueue.pop();
+
+			// Skip invalid nodes
+			if( hierarchy.isValid( currentNode ) )
+			{
+				// Get occlusion information for this node
+				OcclusionInfo& currentInfo = _occlusionInfo[hierarchy.getId( currentNode )];
+
+				// Same as CHC: bounding volumes intersecting the near plane cannot be queried
+				if( Intersection::between( _nearPlane, hierarchy.getBoundingBox( currentNode ) ) == 0 )
+				{
+					pullUpVisibility( hierarchy, currentNode );
+					currentInfo.lastVisited = _frameId;
+					currentInfo.lastRendered = _frameId;
+					hierarchy.draw( currentNode );
+					pushChildren( hierarchy, currentNode, distanceQueue );
+				}
+				else
+				{
+					// Identify previously visible nodes (temporal coherence)
+					bool wasVisible = currentInfo.visible && ( currentInfo.lastVisited == ( _frameId - 1 ) );
+
+					// Reset node's visibility classification
+					currentInfo.visible = false;
+
+					// Update node's visited flag
+					currentInfo.lastVisited = _frameId;
+
+					if( !wasVisible )
+					{
+						// Previously invisible node: gather queries to issue them in batches
+						_invisibleQueue.push_back( hierarchy.getQueryId( currentNode ) );
+
+						if( (int)_invisibleQueue.size() >= _batchSize )
+							issueMultiQueries( hierarchy );
+					}
+					else
+					{
+						// Previously visible leaf: render now, query later and only when due.
+						// Previously visible interior node: visibility is pulled up from children.
+						if( hierarchy.isLeaf( currentNode ) )
+						{
+							if( _frameId >= currentInfo.nextQueryFrame )
+								_visibleQueue.push_back( hierarchy.getQueryId( currentNode ) );
+							else
+								pullUpVisibility( hierarchy, currentNode );
+						}
+
+						traverseNode( hierarchy, currentNode, distanceQueue );
+					}
+				}
+			}
+		}
+
+		// Traversal is waiting for results, issue remaining queries for previously invisible nodes
+		if( distanceQueue.empty() )
+			issueMultiQueries( hierarchy );
+	}
+
+	// Remaining queries of previously visible nodes only update their classification for next frame
+	while( !_visibleQueue.empty() )
+		issueVisibleQuery( hierarchy );
+
+	while( !_queryManager.done() )
+		handleReturnedQuery( hierarchy, distanceQueue );
+}
+
+template<class Hierarchy, class Queue>
+void OcclusionCuller::traverseNode( Hierarchy& hierarchy, typename Hierarchy::Handle node, Queue& distanceQueue )
 {
-	lastVisited = -1;
-	lastRendered = -1;
-	visible = false;
-	distanceToViewpoint = 0.0f;
+	if( hierarchy.isLeaf( node ) )
+	{
+		OcclusionInfo& info = _occlusionInfo[hierarchy.getId( node )];
+		if( info.lastRendered < _frameId )
+		{
+			info.lastRendered = _frameId;
+			hierarchy.draw( node );
+		}
+	}
+	else
+	{
+		pushChildren( hierarchy, node, distanceQueue );
+	}
 }
 
-// ClosestToViewpoint
-OcclusionCuller::ClosestToViewpoint::ClosestToViewpoint( const OcclusionCuller::OcclusionInfoVector& info )
-: _info( info )
+template<class Hierarchy, class Queue>
+void OcclusionCuller::handleReturnedQuery( Hierarchy& hierarchy, Queue& distanceQueue )
 {
-	// empty
+	unsigned int visiblePixels = _queryManager.getFrontResult();
+	int nodeCount = _queryManager.getFrontNodeCount();
+	bool visible = ( visiblePixels > _visibilityThreshold );
+
+	// Failed multiquery: at least one node is visible, test each one individually
+	if( visible && nodeCount > 1 )
+	{
+		for( int i = 0; i < nodeCount; ++i )
+		{
+			int nodeId = _queryManager.getFrontNode( i );
+			_queryManager.issueBoundingVolumeQuery( nodeId, hierarchy.getBoundingBox( hierarchy.getHandle( nodeId ) ) );
+		}
+
+		_queryManager.popFront();
+		return;
+	}
+
+	if( !visible )
+	{
+		// All nodes in query remain invisible
+		for( int i = 0; i < nodeCount; ++i )
+			++_occlusionInfo[_queryManager.getFrontNode( i )].invisibleFrames;
+
+		_queryManager.popFront();
+		return;
+	}
+
+	int nodeId = _queryManager.getFrontNode( 0 );
+	_queryManager.popFront();
+
+	typename Hierarchy::Handle node = hierarchy.getHandle( nodeId );
+	OcclusionInfo& info = _occlusionInfo[nodeId];
+
+	info.invisibleFrames = 0;
+	info.nextQueryFrame = _frameId + 1 + ( _requeryInterval > 1 ? randomRequeryOffset() : 0 );
+
+	pullUpVisibility( hierarchy, node );
+
+	// Previously invisible node became visible, previously visible leaves were already rendered
+	traverseNode( hierarchy, node, distanceQueue );
 }
 
-bool OcclusionCuller::ClosestToViewpoint::operator()( const Node* first, const Node* second ) const
+template<class Hierarchy>
+void OcclusionCuller::issueMultiQueries( Hierarchy& hierarchy )
 {
-	return _info[first->getId()].distanceToViewpoint > _info[second->getId()].distanceToViewpoint;
+	if( _invisibleQueue.empty() )
+		return;
+
+	// Nodes that have been invisible for longer are grouped first
+	if( _multiQueries )
+		std::stable_sort( _invisibleQueue.begin(), _invisibleQueue.end(), LongestInvisible( _occlusionInfo ) );
+
+	const int queueSize = (int)_invisibleQueue.size();
+	int first = 0;
+
+	while( first < queueSize )
+	{
+		// Grow query while expected number of nodes tested per query increases.
+		// If a multiquery of n nodes fails, n more queries are needed: cost = 1 + ( 1 - P(all invisible) ) * n
+		int count = 1;
+		if( _multiQueries )
+		{
+			double allInvisible = getInvisiblePersistence( _invisibleQueue[first] );
+			double bestValue = 1.0;
+
+			while( first + count < queueSize )
+			{
+				double candidate = allInvisible * getInvisiblePersistence( _invisibleQueue[first + count] );
+				double value = ( count + 1 ) / ( 1.0 + ( 1.0 - candidate ) * ( count + 1 ) );
+
+				if( value <= bestValue )
+					break;
+
+				allInvisible = candidate;
+				bestValue = value;
+				++count;
+			}
+		}
+
+		_multiQueryBoxes.resize( count );
+		for( int i = 0; i < count; ++i )
+			_multiQueryBoxes[i] = hierarchy.getBoundingBox( hierarchy.getHandle( _invisibleQueue[first + i] ) );
+
+		_queryManager.issueMultiQuery( &_invisibleQueue[first], &_multiQueryBoxes[0], count );
+		first += count;
+	}
+
+	_invisibleQueue.clear();
 }
 
-// OcclusionCuller
-void OcclusionCuller::pushChildren( Node* node )
+template<class Hierarchy>
+void OcclusionCuller::issueVisibleQuery( Hierarchy& hierarchy )
+{
+	int nodeId = _visibleQueue.front();
+	_visibleQueue.pop_front();
+
+	// Geometry is already rendered, bounding volume query is conservative
+	_queryManager.issueBoundingVolumeQuery( nodeId, hierarchy.getBoundingBox( hierarchy.getHandle( nodeId ) ) );
+}
+
+float OcclusionCuller::getInvisiblePersistence( int nodeId ) const
+{
+	// Empirical model from CHC++ paper
+	return 0.99f - 0.7f * expf( -(float)_occlusionInfo[nodeId].invisibleFrames );
+}
+
+template<class Hierarchy, class Queue>
+void OcclusionCuller::visitNearOptimal( Hierarchy& hierarchy, typename Hierarchy::Handle node, bool wasVisible, Queue& distanceQueue )
+{
+	// Same condition as updateQueryHistory(): the estimates depend on the last query result,
+	// which differs from wasVisible when the node was not visited or its query was skipped last frame
+	OcclusionInfo& info = _occlusionInfo[hierarchy.getId( node )];
+	float& occluded = info.lastResultVisible ? info.occludedAfterVisible : info.occludedAfterOccluded;
+
+	// Expected savings of query: render cost avoided when node turns out occluded
+	if( occluded * info.renderCost <= _queryCost )
+	{
+		// Query does not pay off: assume visible, render leaf or descend into children.
+		// Estimate slowly returns to uncertain, so that large nodes are eventually tested again.
+		occluded += Skipped_History_Weight * ( 0.5f - occluded );
+
+		if( hierarchy.isLeaf( node ) )
+		{
+			pullUpVisibility( hierarchy, node );
+			info.lastRendered = _frameId;
+			hierarchy.draw( node );
+		}
+		else
+		{
+			pushChildren( hierarchy, node, distanceQueue );
+		}
+	}
+	else if( wasVisible && hierarchy.isLeaf( node ) )
+	{
+		// Same as CHC: render visible leaf anyway, query its geometry
+		info.lastRendered = _frameId;
+		_queryManager.beginGeometryQuery( hierarchy.getQueryId( node ), hierarchy.getBoundingBox( node ) );
+		hierarchy.draw( node );
+		_queryManager.endGeometryQuery();
+	}
+	else
+	{
+		// Includes previously visible interior nodes, which CHC never tests.
+		// If found visible, node is rendered and its children pushed when processing the result.
+		_queryManager.issueBoundingVolumeQuery( hierarchy.getQueryId( node ), hierarchy.getBoundingBox( node ) );
+	}
+}
+
+template<class Hierarchy>
+void OcclusionCuller::computeRenderCosts( Hierarchy& hierarchy, typename Hierarchy::Handle root )
+{
+	typedef typename Hierarchy::Handle Handle;
+
+	// Pre-order list, so that children are processed before parents when iterating backwards
+	std::vector<Handle> order;
+	std::vector<Handle> stack( 1, root );
+	Handle children[2];
+
+	while( !stack.empty() )
+	{
+		Handle node = stack.back();
+		stack.pop_back();
+		order.push_back( node );
+
+		int childCount = hierarchy.getChildren( node, children );
+		for( int i = 0; i < childCount; ++i )
+			stack.push_back( children[i] );
+	}
+
+	for( int i = (int)order.size() - 1; i >= 0; --i )
+	{
+		OcclusionInfo& info = _occlusionInfo[hierarchy.getId( order[i] )];
+		info.renderCost = (float)hierarchy.getGeometryCount( order[i] );
+
+		int childCount = hierarchy.getChildren( order[i], children );
+		for( int c = 0; c < childCount; ++c )
+			info.renderCost += _occlusionInfo[hierarchy.getId( children[c] )].renderCost;
+	}
+}
+
+template<class Hierarchy>
+void OcclusionCuller::visitPostponed( Hierarchy& hierarchy, typename Hierarchy::Handle node, bool wasVisible )
 {
-	Node* child = node->getLeftChild();
-	if( child != NULL )
+	++_savedQueryCount;
+
+	// Assume node is still invisible: nothing to render
+	if( !wasVisible )
+		return;
+
+	// Assume leaf is still visible: render without query
+	OcclusionInfo& info = _occlusionInfo[hierarchy.getId( node )];
+	pullUpVisibility( hierarchy, node );
+	info.lastRendered = _frameId;
+	hierarchy.draw( node );
+}
+
+void OcclusionCuller::updateQueryHistory( OcclusionInfo& info, unsigned int visiblePixels )
+{
+	bool visible = visiblePixels > _visibilityThreshold;
+
+	float& occluded = info.lastResultVisible ? info.occludedAfterVisible : info.occludedAfterOccluded;
+	occluded += History_Weight * ( ( visible ? 0.0f : 1.0f ) - occluded );
+
+	// Probability that the new result still holds in the next frame
+	float persistence;
+	if( visible )
 	{
-		_occlusionInfo[child->getId()].distanceToViewpoint = Distance::between( _viewpoint, child->getBoundingBox() );
-		_distanceQueue.push( child );
+		persistence = 1.0f - info.occludedAfterVisible;
+
+		// Fewer visible pixels than last time: node is becoming occluded or moving away
+		if( info.lastResultVisible && visiblePixels < info.lastVisiblePixels )
+			persistence *= (float)visiblePixels / (float)info.lastVisiblePixels;
 	}
+	else
+	{
+		persistence = info.occludedAfterOccluded;
+	}
+
+	info.lastResultVisible = visible;
+	info.lastVisiblePixels = visiblePixels;
+
+	// Number of frames result is expected to hold with the required confidence: persistence^n >= confidence
+	int frames = 0;
+	if( _predictionConfidence < 1.0f && persistence > 0.0f )
+	{
+		if( persistence >= 1.0f || _predictionConfidence <= 0.0f )
+			frames = Max_Postponed_Frames;
+		else
+			frames = vr::min( (int)( logf( _predictionConfidence ) / logf( persistence ) ), Max_Postponed_Frames );
+	}
+
+	info.postponedUntil = _frameId + 1 + frames;
+}
 
-	child = node->getRightChild();
-	if( child != NULL )
+bool OcclusionCuller::isQueryPostponed( const OcclusionInfo& info, bool wasVisible, bool leaf ) const
+{
+	// Opened nodes (visible interior nodes) are never postponed
+	if( wasVisible && !leaf )
+		return false;
+
+	// Prediction must refer to current visibility classification
+	return _frameId < info.postponedUntil && info.lastResultVisible == wasVisible;
+}
+
+template<class Hierarchy, class Queue>
+void OcclusionCuller::pushChildren( Hierarchy& hierarchy, typename Hierarchy::Handle node, Queue& distanceQueue )
+{
+	typename Hierarchy::Handle children[2];
+	int childCount = hierarchy.getChildren( node, children );
+
+	for( int i = 0; i < childCount; ++i )
 	{
-		_occlusionInfo[child->getId()].distanceToViewpoint = Distance::between( _viewpoint, child->getBoundingBox() );
-		_distanceQueue.push( child );
+		_occlusionInfo[hierarchy.getId( children[i] )].distanceToViewpoint = 
+			Distance::between( _viewpoint, hierarchy.getBoundingBox( children[i] ) );
+		distanceQueue.push( children[i] );
 	}
 }
 
 // Update ancestors visibility
-void OcclusionCuller::pullUpVisibility( Node* node )
+template<class Hierarchy>
+void OcclusionCuller::pullUpVisibility( Hierarchy& hierarchy, typename Hierarchy::Handle node )
 {
-	while( node != NULL )
+	while( true )
 	{
-		OcclusionInfo& info = _occlusionInfo[node->getId()];
+		OcclusionInfo& info = _occlusionInfo[hierarchy.getId( node )];
 		if( info.visible == true )
 			break;
 
 		info.visible = true;
-		node = node->getParent();
+
+		if( !hierarchy.hasParent( node ) )
+			break;
+
+		node = hierarchy.getParent( node );
 	}
 }
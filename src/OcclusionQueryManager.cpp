@@ -1,42 +1,71 @@
 #include <vdlib/OcclusionQueryManager.h>
-#include <vdlib/Node.h>
-#include <vdlib/OpenGL.h>
 
 using namespace vdlib;
 
+OcclusionQueryManager::OcclusionQueryManager()
+{
+	_backend = NULL;
+	_queryCount = 0;
+}
+
+void OcclusionQueryManager::setBackend( IOcclusionQueryBackend* backend )
+{
+	_backend = backend;
+}
+
+IOcclusionQueryBackend* OcclusionQueryManager::getBackend() const
+{
+	return _backend;
+}
+
 void OcclusionQueryManager::init( const TreeBuilder::Statistics& stats )
 {
-	vr::vectorExactResize( _queryIds, stats.nodeCount );
-	glGenQueriesARB( stats.nodeCount, &_queryIds[0] );
+	_queryQueue.clear();
+	_queryNodes.clear();
+	_backend->init( stats.nodeCount );
 }
 
-void OcclusionQueryManager::beginBoundingVolumeQuery( Node* node )
+void OcclusionQueryManager::beginFrame( unsigned int visibilityThreshold, bool exactCounts )
 {
-	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
-	glDepthMask( GL_FALSE );
-	glDisable( GL_LIGHTING );
-	glBeginQueryARB( GL_SAMPLES_PASSED_ARB, _queryIds[node->getId()] );
+	// All queries of previous frame have been processed
+	_queryNodes.clear();
+	_queryCount = 0;
+	_backend->setExactCounts( exactCounts );
+	_backend->beginFrame( visibilityThreshold );
+}
 
-	_queryQueue.push_back( node );
+void OcclusionQueryManager::issueBoundingVolumeQuery( int nodeId, const Box& box )
+{
+	issueMultiQuery( &nodeId, &box, 1 );
 }
 
-void OcclusionQueryManager::endBoundingVolumeQuery()
+void OcclusionQueryManager::issueMultiQuery( const int* nodeIds, const Box* boxes, int count )
 {
-	glEnable( GL_LIGHTING );
-	glDepthMask( GL_TRUE );
-	glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
-	glEndQueryARB( GL_SAMPLES_PASSED_ARB );
+	_backend->issueBoundingBoxQuery( nodeIds[0], boxes, count );
+
+	Query query;
+	query.firstNode = (int)_queryNodes.size();
+	query.nodeCount = count;
+	_queryNodes.insert( _queryNodes.end(), nodeIds, nodeIds + count );
+	_queryQueue.push_back( query );
+	++_queryCount;
 }
 
-void OcclusionQueryManager::beginGeometryQuery( Node* node )
+void OcclusionQueryManager::beginGeometryQuery( int nodeId, const Box& box )
 {
-	glBeginQueryARB( GL_SAMPLES_PASSED_ARB, _queryIds[node->getId()] );
-	_queryQueue.push_back( node );
+	_backend->beginGeometryQuery( nodeId, box );
+
+	Query query;
+	query.firstNode = (int)_queryNodes.size();
+	query.nodeCount = 1;
+	_queryNodes.push_back( nodeId );
+	_queryQueue.push_back( query );
+	++_queryCount;
 }
 
 void OcclusionQueryManager::endGeometryQuery()
 {
-	glEndQueryARB( GL_SAMPLES_PASSED_ARB );
+	_backend->endGeometryQuery( _queryNodes.back() );
 }
 
 bool OcclusionQueryManager::done() const
@@ -44,23 +73,32 @@ bool OcclusionQueryManager::done() const
 	return _queryQueue.empty();
 }
 
-Node* OcclusionQueryManager::popFrontNode()
+bool OcclusionQueryManager::frontResultAvailable() const
 {
-	Node* frontNode = _queryQueue.front();
-	_queryQueue.pop_front();
-	return frontNode;
+	return _backend->isResultAvailable( getFrontNode( 0 ) );
 }
 
-bool OcclusionQueryManager::frontResultAvailable() const
+unsigned int OcclusionQueryManager::getFrontResult() const
 {
-	unsigned int result;
-	glGetQueryObjectuivARB( _queryIds[_queryQueue.front()->getId()], GL_QUERY_RESULT_AVAILABLE_ARB, &result );
-	return ( result == GL_TRUE );
+	return _backend->getResult( getFrontNode( 0 ) );
+}
+
+int OcclusionQueryManager::getFrontNodeCount() const
+{
+	return _queryQueue.front().nodeCount;
+}
+
+int OcclusionQueryManager::getFrontNode( int i ) const
+{
+	return _queryNodes[_queryQueue.front().firstNode + i];
+}
+
+void OcclusionQueryManager::popFront()
+{
+	_queryQueue.pop_front();
 }
 
-unsigned int OcclusionQueryManager::getQueryResult( Node* node ) const
+int OcclusionQueryManager::getQueryCount() const
 {
-	unsigned int result;
-	glGetQueryObjectuivARB( _queryIds[node->getId()], GL_QUERY_RESULT_ARB, &result );
-	return result;
+	return _queryCount;
 }
@@ -0,0 +1,105 @@
+#include <vdlib/OpenGLQueryBackend.h>
+#include <vdlib/Box.h>
+#include <vdlib/OpenGL.h>
+
+using namespace vdlib;
+
+//////////////////////////////////////////////////////////////////////////
+// Global functions
+static void renderBoundingBox( const Box& box )
+{
+	vr::vec3f vertices[8];
+	box.computeVertices( vertices );
+
+	glBegin( GL_QUADS );
+	// -z
+	glVertex3fv( vertices[0].ptr );
+	glVertex3fv( vertices[1].ptr );
+	glVertex3fv( vertices[5].ptr );
+	glVertex3fv( vertices[4].ptr );
+
+	// +x
+	glVertex3fv( vertices[1].ptr );
+	glVertex3fv( vertices[2].ptr );
+	glVertex3fv( vertices[6].ptr );
+	glVertex3fv( vertices[5].ptr );
+
+	// +z
+	glVertex3fv( vertices[2].ptr );
+	glVertex3fv( vertices[3].ptr );
+	glVertex3fv( vertices[7].ptr );
+	glVertex3fv( vertices[6].ptr );
+
+	// -x
+	glVertex3fv( vertices[3].ptr );
+	glVertex3fv( vertices[0].ptr );
+	glVertex3fv( vertices[4].ptr );
+	glVertex3fv( vertices[7].ptr );
+
+	// +y
+	glVertex3fv( vertices[4].ptr );
+	glVertex3fv( vertices[5].ptr );
+	glVertex3fv( vertices[6].ptr );
+	glVertex3fv( vertices[7].ptr );
+
+	// -y
+	glVertex3fv( vertices[0].ptr );
+	glVertex3fv( vertices[3].ptr );
+	glVertex3fv( vertices[2].ptr );
+	glVertex3fv( vertices[1].ptr );
+
+	glEnd();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// OpenGLQueryBackend
+void OpenGLQueryBackend::init( int queryCount )
+{
+	if( !_queryIds.empty() )
+		glDeleteQueriesARB( (GLsizei)_queryIds.size(), &_queryIds[0] );
+
+	vr::vectorExactResize( _queryIds, queryCount );
+
+	if( queryCount > 0 )
+		glGenQueriesARB( queryCount, &_queryIds[0] );
+}
+
+void OpenGLQueryBackend::issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount )
+{
+	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+	glDepthMask( GL_FALSE );
+	glDisable( GL_LIGHTING );
+	glBeginQueryARB( GL_SAMPLES_PASSED_ARB, _queryIds[queryId] );
+
+	for( int i = 0; i < boxCount; ++i )
+		renderBoundingBox( boxes[i] );
+
+	glEndQueryARB( GL_SAMPLES_PASSED_ARB );
+	glEnable( GL_LIGHTING );
+	glDepthMask( GL_TRUE );
+	glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+}
+
+void OpenGLQueryBackend::beginGeometryQuery( int queryId, const Box& box )
+{
+	glBeginQueryARB( GL_SAMPLES_PASSED_ARB, _queryIds[queryId] );
+}
+
+void OpenGLQueryBackend::endGeometryQuery( int queryId )
+{
+	glEndQueryARB( GL_SAMPLES_PASSED_ARB );
+}
+
+bool OpenGLQueryBackend::isResultAvailable( int queryId )
+{
+	unsigned int result;
+	glGetQueryObjectuivARB( _queryIds[queryId], GL_QUERY_RESULT_AVAILABLE_ARB, &result );
+	return ( result == GL_TRUE );
+}
+
+unsigned int OpenGLQueryBackend::getResult( int queryId )
+{
+	unsigned int result;
+	glGetQueryObjectuivARB( _queryIds[queryId], GL_QUERY_RESULT_ARB, &result );
+	return result;
+}
@@ -2,6 +2,8 @@
 #include <vdlib/Node.h>
 #include <vdlib/Geometry.h>
 #include <vdlib/BoxFactory.h>
+#include <vdlib/Box.h>
+#include <vdlib/Statistics.h>
 
 using namespace vdlib;
 
@@ -9,12 +11,27 @@ RawNode::RawNode()
 {
 	_treeDepth = 0;
 	_node = new Node();
+	_vertexPool = &_vertices;
+	_geometryPool = &_geometryInfos;
+	setGeometryRange( 0, 0, 0 );
 }
 
 RawNode::RawNode( int id )
 {
 	_treeDepth = 0;
 	_node = new Node( id );
+	_vertexPool = &_vertices;
+	_geometryPool = &_geometryInfos;
+	setGeometryRange( 0, 0, 0 );
+}
+
+RawNode::RawNode( RawNode* parent )
+{
+	_treeDepth = 0;
+	_node = new Node();
+	_vertexPool = parent->_vertexPool;
+	_geometryPool = parent->_geometryPool;
+	setGeometryRange( 0, 0, 0 );
 }
 
 void RawNode::setLeftChild( RawNode* child )
@@ -56,24 +73,51 @@ int RawNode::getTreeDepth() const
 	return _treeDepth;
 }
 
-std::vector<float>& RawNode::getVertices()
+VertexPool& RawNode::getVertexPool()
 {
-	return _vertices;
+	return *_vertexPool;
 }
 
-const std::vector<float>& RawNode::getVertices() const
+const VertexPool& RawNode::getVertexPool() const
 {
-	return _vertices;
+	return *_vertexPool;
 }
 
 GeometryInfoVector& RawNode::getGeometryInfos()
 {
-	return _geometryInfos;
+	return *_geometryPool;
 }
 
 const GeometryInfoVector& RawNode::getGeometryInfos() const
 {
-	return _geometryInfos;
+	return *_geometryPool;
+}
+
+void RawNode::setGeometryRange( int start, int count, vr::int64 vertexCount )
+{
+	_geometryStart = start;
+	_geometryCount = count;
+	_vertexCount = vertexCount;
+}
+
+int RawNode::getGeometryStart() const
+{
+	return _geometryStart;
+}
+
+int RawNode::getGeometryCount() const
+{
+	return _geometryCount;
+}
+
+vr::int64 RawNode::getVertexCount() const
+{
+	return _vertexCount;
+}
+
+GeometryInfo* RawNode::getGeometryInfo( int index )
+{
+	return (*_geometryPool)[_geometryStart + index].get();
 }
 
 Node* RawNode::getHierarchyNode()
@@ -84,18 +128,71 @@ Node* RawNode::getHierarchyNode()
 void RawNode::computeBoundingBox()
 {
 	// If only 1 geometry, reuse its box
-	if( _geometryInfos.size() == 1 )
-		_node->getBoundingBox() = _geometryInfos[0]->geometry->getBoundingBox();
-	else 
-		BoxFactory::createBox( _node->getBoundingBox(), &_vertices[0], _vertices.size() );
+	if( _geometryCount == 1 )
+	{
+		_node->getBoundingBox() = getGeometryInfo( 0 )->geometry->getBoundingBox();
+		return;
+	}
+
+	std::vector<VertexRange> ranges;
+	getVertexRanges( ranges );
+
+	BoxFactory::createBox( _node->getBoundingBox(), &ranges[0], _geometryCount );
+}
+
+void RawNode::computeMergedBoundingBox()
+{
+	// If only 1 geometry, reuse its box
+	if( _geometryCount == 1 )
+	{
+		_node->getBoundingBox() = getGeometryInfo( 0 )->geometry->getBoundingBox();
+		return;
+	}
+
+	std::vector<Box> boxes( _geometryCount );
+	std::vector<Moments> moments( _geometryCount );
+
+	for( int i = 0; i < _geometryCount; ++i )
+	{
+		GeometryInfo* info = getGeometryInfo( i );
+		boxes[i] = info->geometry->getBoundingBox();
+		moments[i] = info->moments;
+	}
+
+	BoxFactory::createBox( _node->getBoundingBox(), &boxes[0], &moments[0], _geometryCount );
+}
+
+void RawNode::refitBoundingBox()
+{
+	// Single geometry box is already tight
+	if( _geometryCount == 1 )
+		return;
+
+	std::vector<VertexRange> ranges;
+	getVertexRanges( ranges );
+
+	BoxFactory::refitBox( _node->getBoundingBox(), &ranges[0], _geometryCount );
 }
 
 void RawNode::assignGeometriesToHierarchyNode()
 {
 	GeometryVector& geometries = _node->getGeometries();
 
-	vr::vectorExactResize( geometries, _geometryInfos.size() );
+	vr::vectorExactResize( geometries, _geometryCount );
+
+	for( int i = 0; i < _geometryCount; ++i )
+		geometries[i] = getGeometryInfo( i )->geometry;
+}
+
+void RawNode::getVertexRanges( std::vector<VertexRange>& ranges )
+{
+	// Vertices of each geometry are contiguous in the shared pool
+	ranges.resize( _geometryCount );
 
-	for( unsigned int i = 0; i < _geometryInfos.size(); ++i )
-		geometries[i] = _geometryInfos[i]->geometry;
+	for( int i = 0; i < _geometryCount; ++i )
+	{
+		GeometryInfo* info = getGeometryInfo( i );
+		ranges[i].vertices = info->vertices;
+		ranges[i].size = info->verticesSize;
+	}
 }
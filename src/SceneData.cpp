@@ -2,9 +2,18 @@
 #include <vdlib/RawNode.h>
 #include <vdlib/BoxFactory.h>
 #include <vdlib/Geometry.h>
+#include <algorithm>
+#include <cstdio>
 
 using namespace vdlib;
 
+SceneData::SceneData()
+{
+	_sharedVertices = NULL;
+	_sharedVertexCount = 0;
+	_currentStamp = 0;
+}
+
 void SceneData::beginScene()
 {
 	_sceneRoot = new RawNode();
@@ -12,45 +21,100 @@ void SceneData::beginScene()
 
 void SceneData::beginGeometry( Geometry* geometry )
 {
+	// Vertices of new geometry are stored contiguously in a new block
+	_sceneRoot->getVertexPool().beginBlock();
+
 	// Create geometry info for new geometry
 	GeometryInfo* di = new GeometryInfo();
-	di->verticesStart = _sceneRoot->getVertices().size();
+	di->vertices = _sceneRoot->getVertexPool().getBlock();
 	di->verticesSize = 0;
 	di->geometry = geometry;
+	di->moments.reset();
 
 	// Store it in root node
 	_sceneRoot->getGeometryInfos().push_back( di );
 }
 
-void SceneData::addVertices( const float* vertices, int size )
+void SceneData::setSharedVertices( const float* vertices, vr::int64 size )
+{
+	_sharedVertices = vertices;
+	_sharedVertexCount = size / 3;
+
+	// No geometry has referenced these vertices yet
+	_vertexStamps.assign( (size_t)_sharedVertexCount, 0 );
+	_currentStamp = 0;
+}
+
+void SceneData::beginGeometry( Geometry* geometry, const unsigned int* indices, vr::int64 indexCount )
 {
-	std::vector<float>& destVertices = _sceneRoot->getVertices();
+	beginGeometry( geometry );
+
+	VertexPool& pool = _sceneRoot->getVertexPool();
+	GeometryInfo* currInfo = _sceneRoot->getGeometryInfos().back().get();
+
+	// Mark vertices referenced by this geometry, so that each one is only stored once
+	++_currentStamp;
+	bool invalidIndex = false;
+
+	for( vr::int64 i = 0; i < indexCount; ++i )
+	{
+		const unsigned int index = indices[i];
+
+		if( (vr::int64)index >= _sharedVertexCount )
+		{
+			invalidIndex = true;
+			continue;
+		}
 
-	// Reserve space for new vertices
-	unsigned int previousSize = destVertices.size();
-	destVertices.resize( previousSize + size );
+		if( _vertexStamps[index] == _currentStamp )
+			continue;
 
-	// Append to current buffer vertices
-	std::copy( vertices, vertices + size, destVertices.begin() + previousSize );
+		_vertexStamps[index] = _currentStamp;
 
-	// Increment vertex size in GeometryInfo
-	_sceneRoot->getGeometryInfos().back()->verticesSize += size;
+		// Vertices are appended in order of first reference
+		float* destVertex = pool.append( 3 );
+		const float* vertex = _sharedVertices + (vr::int64)index * 3;
+		destVertex[0] = vertex[0];
+		destVertex[1] = vertex[1];
+		destVertex[2] = vertex[2];
+
+		currInfo->verticesSize += 3;
+	}
+
+	if( invalidIndex )
+		printf( "SceneData: vertex index out of range of shared vertices!\n" );
+
+	// Update vertex location in GeometryInfo
+	currInfo->vertices = pool.getBlock();
 }
 
-void SceneData::addVertices( const double* vertices, int size )
+void SceneData::addVertices( const float* vertices, vr::int64 size )
 {
-	std::vector<float>& destVertices = _sceneRoot->getVertices();
+	VertexPool& pool = _sceneRoot->getVertexPool();
 
-	// Reserve space for new vertices
-	unsigned int previousSize = destVertices.size();
-	destVertices.resize( previousSize + size );
+	// Append to current geometry's block, only this block may be moved
+	float* destVertices = pool.append( size );
+	std::copy( vertices, vertices + size, destVertices );
 
-	// Append to current buffer vertices
-	for( int src = 0, dst = previousSize; src < size; ++src, ++dst )
-		destVertices[dst] = (float)vertices[src];
+	// Update vertex location and size in GeometryInfo
+	GeometryInfo* currInfo = _sceneRoot->getGeometryInfos().back().get();
+	currInfo->vertices = pool.getBlock();
+	currInfo->verticesSize += size;
+}
 
-	// Increment vertex size in GeometryInfo
-	_sceneRoot->getGeometryInfos().back()->verticesSize += size;
+void SceneData::addVertices( const double* vertices, vr::int64 size )
+{
+	VertexPool& pool = _sceneRoot->getVertexPool();
+
+	// Append to current geometry's block, only this block may be moved
+	float* destVertices = pool.append( size );
+	for( vr::int64 i = 0; i < size; ++i )
+		destVertices[i] = (float)vertices[i];
+
+	// Update vertex location and size in GeometryInfo
+	GeometryInfo* currInfo = _sceneRoot->getGeometryInfos().back().get();
+	currInfo->vertices = pool.getBlock();
+	currInfo->verticesSize += size;
 }
 
 void SceneData::transformVertices( const float* matrix )
@@ -62,10 +126,10 @@ void SceneData::transformVertices( const float* matrix )
 		return;
 
 	// Only update vertices for current geometry
-	int verticesStart = _sceneRoot->getGeometryInfos().back()->verticesStart;
-	std::vector<float>& destVertices = _sceneRoot->getVertices();
+	GeometryInfo* currInfo = _sceneRoot->getGeometryInfos().back().get();
+	float* destVertices = currInfo->vertices;
 
-	for( int i = verticesStart; i < (int)destVertices.size(); i+=3 )
+	for( vr::int64 i = 0; i < currInfo->verticesSize; i+=3 )
 	{
 		// Get vertex
 		vr::vec3f vertex( &destVertices[i] );
@@ -83,8 +147,7 @@ void SceneData::transformVertices( const float* matrix )
 const float* SceneData::getCurrentVertices() const
 {
 	// Pointer to the beginning of current geometry's vertices
-	int verticesStart = _sceneRoot->getGeometryInfos().back()->verticesStart;
-	return &_sceneRoot->getVertices()[verticesStart];
+	return _sceneRoot->getGeometryInfos().back()->vertices;
 }
 
 void SceneData::endGeometry()
@@ -92,18 +155,18 @@ void SceneData::endGeometry()
 	// Get geometry information
 	GeometryInfo* currInfo = _sceneRoot->getGeometryInfos().back().get();
 
-	int vertStart = currInfo->verticesStart;
-	int vertSize = currInfo->verticesSize;
-
 	// Create bounding volume using current vertices only
-	BoxFactory::createBox( currInfo->geometry->getBoundingBox(), &_sceneRoot->getVertices()[vertStart], vertSize );
+	BoxFactory::createBox( currInfo->geometry->getBoundingBox(), currInfo->vertices, currInfo->verticesSize );
 }
 
 void SceneData::endScene()
 {
-	// Save memory
-	vr::vectorTrim( _sceneRoot->getVertices() );
+	// Save memory, vertex chunks are never trimmed to avoid copying them
 	vr::vectorTrim( _sceneRoot->getGeometryInfos() );
+	vr::vectorFreeMemory( _vertexStamps );
+
+	// Scene node contains all geometries
+	_sceneRoot->setGeometryRange( 0, _sceneRoot->getGeometryInfos().size(), _sceneRoot->getVertexPool().getSize() );
 }
 
 RawNode* SceneData::getSceneNode()
@@ -0,0 +1,68 @@
+#include <vdlib/SoftwareQueryBackend.h>
+#include <vdlib/SoftwareRasterizer.h>
+#include <vdlib/Box.h>
+
+using namespace vdlib;
+
+SoftwareQueryBackend::SoftwareQueryBackend( SoftwareRasterizer* rasterizer )
+{
+	_rasterizer = rasterizer;
+	_exactCounts = false;
+	_sampleLimit = 0;
+}
+
+SoftwareRasterizer* SoftwareQueryBackend::getRasterizer() const
+{
+	return _rasterizer;
+}
+
+void SoftwareQueryBackend::init( int queryCount )
+{
+	vr::vectorExactResize( _results, queryCount );
+}
+
+void SoftwareQueryBackend::setExactCounts( bool enabled )
+{
+	_exactCounts = enabled;
+}
+
+void SoftwareQueryBackend::beginFrame( unsigned int visibilityThreshold )
+{
+	// One sample above threshold is enough to classify as visible, zero counts all samples
+	_sampleLimit = _exactCounts ? 0 : (int)vr::min( visibilityThreshold + 1, 0x7fffffffu );
+}
+
+void SoftwareQueryBackend::issueBoundingBoxQuery( int queryId, const Box* boxes, int boxCount )
+{
+	// Multiquery counts samples of all boxes together
+	int samples = 0;
+	for( int i = 0; i < boxCount; ++i )
+	{
+		if( _sampleLimit > 0 && samples >= _sampleLimit )
+			break;
+
+		samples += _rasterizer->testBox( boxes[i], _sampleLimit > 0 ? _sampleLimit - samples : 0 );
+	}
+
+	_results[queryId] = samples;
+}
+
+void SoftwareQueryBackend::beginGeometryQuery( int queryId, const Box& box )
+{
+	_results[queryId] = _rasterizer->testBox( box, _sampleLimit );
+}
+
+void SoftwareQueryBackend::endGeometryQuery( int queryId )
+{
+	// empty
+}
+
+bool SoftwareQueryBackend::isResultAvailable( int queryId )
+{
+	return true;
+}
+
+unsigned int SoftwareQueryBackend::getResult( int queryId )
+{
+	return _results[queryId];
+}
@@ -0,0 +1,450 @@
+#include <vdlib/SoftwareRasterizer.h>
+#include <vdlib/Box.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( VDLIB_SSE )
+	#include <xmmintrin.h>
+#endif
+
+using namespace vdlib;
+
+// Box faces as quads of Box::computeVertices() indices, counter-clockwise seen from outside
+// when box axes are right-handed.
+static const int s_boxFaces[6][4] =
+{
+	{ 0, 3, 2, 1 }, // -z
+	{ 4, 5, 6, 7 }, // +z
+	{ 0, 4, 7, 3 }, // -x
+	{ 1, 2, 6, 5 }, // +x
+	{ 0, 1, 5, 4 }, // -y
+	{ 3, 7, 6, 2 }  // +y
+};
+
+// Number of bits set in a 4-bit mask
+static const int s_bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Intersection of segment a-b with near plane z = -w, in clip space
+static void clipNear( const float* a, const float* b, float* result )
+{
+	const float da = a[2] + a[3];
+	const float db = b[2] + b[3];
+	const float t = da / ( da - db );
+
+	for( int i = 0; i < 4; ++i )
+		result[i] = a[i] + t * ( b[i] - a[i] );
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+{
+	_width = 0;
+	_height = 0;
+	_tilesX = 0;
+	_tilesY = 0;
+
+	for( int i = 0; i < 16; ++i )
+		_viewProj[i] = ( i % 5 == 0 ) ? 1.0f : 0.0f;
+}
+
+void SoftwareRasterizer::setViewport( int width, int height )
+{
+	_width = vr::max( width, 0 );
+	_height = vr::max( height, 0 );
+	_tilesX = ( _width + Tile_Width - 1 ) / Tile_Width;
+	_tilesY = ( _height + Tile_Height - 1 ) / Tile_Height;
+
+	vr::vectorExactResize( _depth, _tilesX * _tilesY * Tile_Size );
+	vr::vectorExactResize( _tileMaxDepth, _tilesX * _tilesY );
+
+	clear();
+}
+
+int SoftwareRasterizer::getWidth() const
+{
+	return _width;
+}
+
+int SoftwareRasterizer::getHeight() const
+{
+	return _height;
+}
+
+void SoftwareRasterizer::setViewProjection( const float* viewProjMatrix )
+{
+	for( int i = 0; i < 16; ++i )
+		_viewProj[i] = viewProjMatrix[i];
+}
+
+void SoftwareRasterizer::clear()
+{
+	for( int ty = 0; ty < _tilesY; ++ty )
+	{
+		for( int tx = 0; tx < _tilesX; ++tx )
+		{
+			const int tile = ty * _tilesX + tx;
+			float* depth = &_depth[tile * Tile_Size];
+
+			// Padding pixels outside the viewport are at depth 0, so nothing ever passes there
+			for( int y = 0; y < Tile_Height; ++y )
+			{
+				const bool insideY = ( ty * Tile_Height + y ) < _height;
+				for( int x = 0; x < Tile_Width; ++x )
+				{
+					const bool insideX = ( tx * Tile_Width + x ) < _width;
+					depth[y * Tile_Width + x] = ( insideX && insideY ) ? 1.0f : 0.0f;
+				}
+			}
+
+			_tileMaxDepth[tile] = 1.0f;
+		}
+	}
+}
+
+void SoftwareRasterizer::drawTriangles( const float* vertices, const int* indices, int indexCount )
+{
+	Triangle triangles[2];
+
+	for( int i = 0; i + 2 < indexCount; i += 3 )
+	{
+		const int count = clipTriangle( &vertices[3*indices[i]], &vertices[3*indices[i+1]], &vertices[3*indices[i+2]],
+		                                true, triangles );
+
+		for( int t = 0; t < count; ++t )
+			drawTriangle( triangles[t] );
+	}
+}
+
+int SoftwareRasterizer::testBox( const Box& box, int maxSamples ) const
+{
+	vr::vec3f vertices[8];
+	box.computeVertices( vertices );
+
+	// Keep front faces counter-clockwise if box axes are left-handed
+	const bool flip = box.axis[0].cross( box.axis[1] ).dot( box.axis[2] ) < 0.0f;
+
+	Triangle triangles[2];
+	int samples = 0;
+
+	for( int f = 0; f < 6; ++f )
+	{
+		const int* q = s_boxFaces[f];
+		for( int t = 0; t < 2; ++t )
+		{
+			int b = q[t+1];
+			int c = q[t+2];
+			if( flip )
+				std::swap( b, c );
+
+			const int count = clipTriangle( vertices[q[0]].ptr, vertices[b].ptr, vertices[c].ptr, false, triangles );
+
+			for( int i = 0; i < count; ++i )
+			{
+				samples += testTriangle( triangles[i], maxSamples > 0 ? maxSamples - samples : 0 );
+
+				if( maxSamples > 0 && samples >= maxSamples )
+					return samples;
+			}
+		}
+	}
+
+	return samples;
+}
+
+float SoftwareRasterizer::getDepth( int x, int y ) const
+{
+	const int tile = ( y / Tile_Height ) * _tilesX + ( x / Tile_Width );
+	return _depth[tile * Tile_Size + ( y % Tile_Height ) * Tile_Width + ( x % Tile_Width )];
+}
+
+int SoftwareRasterizer::clipTriangle( const float* v0, const float* v1, const float* v2, bool draw, Triangle* triangles ) const
+{
+	if( _depth.empty() )
+		return 0;
+
+	// Transform to clip space
+	const float* m = _viewProj;
+	const float* v[3] = { v0, v1, v2 };
+	float clip[3][4];
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int c = 0; c < 4; ++c )
+			clip[i][c] = m[c] * v[i][0] + m[4+c] * v[i][1] + m[8+c] * v[i][2] + m[12+c];
+	}
+
+	// Trivially reject if all vertices are outside the same frustum plane
+	for( int c = 0; c < 3; ++c )
+	{
+		if( clip[0][c] < -clip[0][3] && clip[1][c] < -clip[1][3] && clip[2][c] < -clip[2][3] )
+			return 0;
+		if( clip[0][c] > clip[0][3] && clip[1][c] > clip[1][3] && clip[2][c] > clip[2][3] )
+			return 0;
+	}
+
+	// Clip against near plane, results in a triangle or a quad
+	float polygon[4][4];
+	int count = 0;
+
+	for( int i = 0; i < 3; ++i )
+	{
+		const float* a = clip[i];
+		const float* b = clip[(i + 1) % 3];
+		const bool insideA = ( a[2] + a[3] ) >= 0.0f;
+		const bool insideB = ( b[2] + b[3] ) >= 0.0f;
+
+		if( insideA )
+		{
+			for( int c = 0; c < 4; ++c )
+				polygon[count][c] = a[c];
+			++count;
+		}
+
+		if( insideA != insideB )
+			clipNear( a, b, polygon[count++] );
+	}
+
+	int triangleCount = 0;
+	for( int i = 2; i < count; ++i )
+	{
+		if( setupTriangle( triangles[triangleCount], polygon[0], polygon[i-1], polygon[i], draw ) )
+			++triangleCount;
+	}
+
+	return triangleCount;
+}
+
+bool SoftwareRasterizer::setupTriangle( Triangle& triangle, const float* c0, const float* c1, const float* c2, bool draw ) const
+{
+	// Project to window coordinates, origin at lower left corner like OpenGL
+	const float* clip[3] = { c0, c1, c2 };
+	float x[3], y[3], z[3];
+
+	for( int i = 0; i < 3; ++i )
+	{
+		const float invW = 1.0f / clip[i][3];
+		x[i] = ( clip[i][0] * invW * 0.5f + 0.5f ) * _width;
+		y[i] = ( clip[i][1] * invW * 0.5f + 0.5f ) * _height;
+		z[i] = clip[i][2] * invW * 0.5f + 0.5f;
+	}
+
+	float area2 = ( x[1] - x[0] ) * ( y[2] - y[0] ) - ( x[2] - x[0] ) * ( y[1] - y[0] );
+
+	if( area2 == 0.0f )
+		return false;
+
+	if( area2 < 0.0f )
+	{
+		// Occluders are double-sided, query boxes only need their front faces
+		if( !draw )
+			return false;
+
+		std::swap( x[1], x[2] );
+		std::swap( y[1], y[2] );
+		std::swap( z[1], z[2] );
+		area2 = -area2;
+	}
+
+	// Pixel bounds, clamped before conversion since projected vertices may be far off screen
+	const float minX = vr::max( vr::min( x[0], vr::min( x[1], x[2] ) ), 0.0f );
+	const float maxX = vr::min( vr::max( x[0], vr::max( x[1], x[2] ) ), (float)_width );
+	const float minY = vr::max( vr::min( y[0], vr::min( y[1], y[2] ) ), 0.0f );
+	const float maxY = vr::min( vr::max( y[0], vr::max( y[1], y[2] ) ), (float)_height );
+
+	triangle.minX = (int)std::floor( minX );
+	triangle.minY = (int)std::floor( minY );
+	triangle.maxX = vr::min( (int)std::ceil( maxX ), _width - 1 );
+	triangle.maxY = vr::min( (int)std::ceil( maxY ), _height - 1 );
+
+	if( triangle.minX > triangle.maxX || triangle.minY > triangle.maxY )
+		return false;
+
+	// Edge i goes from vertex i to vertex i+1, positive on the left side (inside)
+	for( int i = 0; i < 3; ++i )
+	{
+		const int j = ( i + 1 ) % 3;
+		triangle.edgeA[i] = y[i] - y[j];
+		triangle.edgeB[i] = x[j] - x[i];
+		triangle.edgeC[i] = x[i] * y[j] - x[j] * y[i];
+	}
+
+	// Depth is linear in window coordinates
+	const float invArea = 1.0f / area2;
+	triangle.depthA = ( ( z[1] - z[0] ) * ( y[2] - y[0] ) - ( z[2] - z[0] ) * ( y[1] - y[0] ) ) * invArea;
+	triangle.depthB = ( ( z[2] - z[0] ) * ( x[1] - x[0] ) - ( z[1] - z[0] ) * ( x[2] - x[0] ) ) * invArea;
+	triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+	triangle.minDepth = vr::min( z[0], vr::min( z[1], z[2] ) );
+
+	return true;
+}
+
+bool SoftwareRasterizer::overlapsTile( const Triangle& triangle, int tileX, int tileY ) const
+{
+	// Triangle is behind everything already in this tile
+	if( triangle.minDepth >= _tileMaxDepth[tileY * _tilesX + tileX] )
+		return false;
+
+	// Reject tile if it is totally outside any edge, using the corner farthest inside
+	const float x0 = tileX * Tile_Width + 0.5f;
+	const float y0 = tileY * Tile_Height + 0.5f;
+	const float x1 = x0 + ( Tile_Width - 1 );
+	const float y1 = y0 + ( Tile_Height - 1 );
+
+	for( int e = 0; e < 3; ++e )
+	{
+		const float x = triangle.edgeA[e] > 0.0f ? x1 : x0;
+		const float y = triangle.edgeB[e] > 0.0f ? y1 : y0;
+		if( ( triangle.edgeA[e] * x + triangle.edgeB[e] * y + triangle.edgeC[e] ) < 0.0f )
+			return false;
+	}
+
+	return true;
+}
+
+void SoftwareRasterizer::drawTriangle( const Triangle& triangle )
+{
+	for( int ty = triangle.minY / Tile_Height; ty <= triangle.maxY / Tile_Height; ++ty )
+	{
+		for( int tx = triangle.minX / Tile_Width; tx <= triangle.maxX / Tile_Width; ++tx )
+		{
+			if( !overlapsTile( triangle, tx, ty ) )
+				continue;
+
+			const int tile = ty * _tilesX + tx;
+			rasterizeTile( triangle, tx, ty, &_depth[tile * Tile_Size], 0 );
+			updateTileMaxDepth( tile );
+		}
+	}
+}
+
+int SoftwareRasterizer::testTriangle( const Triangle& triangle, int maxSamples ) const
+{
+	int samples = 0;
+	for( int ty = triangle.minY / Tile_Height; ty <= triangle.maxY / Tile_Height; ++ty )
+	{
+		for( int tx = triangle.minX / Tile_Width; tx <= triangle.maxX / Tile_Width; ++tx )
+		{
+			if( !overlapsTile( triangle, tx, ty ) )
+				continue;
+
+			samples += rasterizeTile( triangle, tx, ty, NULL, maxSamples > 0 ? maxSamples - samples : 0 );
+
+			if( maxSamples > 0 && samples >= maxSamples )
+				return samples;
+		}
+	}
+
+	return samples;
+}
+
+int SoftwareRasterizer::rasterizeTile( const Triangle& triangle, int tileX, int tileY, float* target, int maxSamples ) const
+{
+	const int originX = tileX * Tile_Width;
+	const int originY = tileY * Tile_Height;
+
+	// Rows and 4-pixel column groups covered by the triangle bounds
+	const int rowBegin = vr::max( triangle.minY - originY, 0 );
+	const int rowEnd   = vr::min( triangle.maxY - originY, Tile_Height - 1 );
+	const int groupBegin = vr::max( triangle.minX - originX, 0 ) / 4;
+	const int groupEnd   = vr::min( triangle.maxX - originX, Tile_Width - 1 ) / 4;
+
+	const float* depth = &_depth[( tileY * _tilesX + tileX ) * Tile_Size];
+	int samples = 0;
+
+#if defined( VDLIB_SSE )
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+
+	for( int row = rowBegin; row <= rowEnd; ++row )
+	{
+		const float py = originY + row + 0.5f;
+
+		for( int group = groupBegin; group <= groupEnd; ++group )
+		{
+			const __m128 px = _mm_add_ps( _mm_set1_ps( (float)( originX + group * 4 ) ), offsets );
+
+			__m128 inside = _mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( triangle.edgeA[0] ), px ),
+			                                          _mm_set1_ps( triangle.edgeB[0] * py + triangle.edgeC[0] ) ), zero );
+			for( int e = 1; e < 3; ++e )
+			{
+				inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( triangle.edgeA[e] ), px ),
+				                                                       _mm_set1_ps( triangle.edgeB[e] * py + triangle.edgeC[e] ) ), zero ) );
+			}
+
+			if( _mm_movemask_ps( inside ) == 0 )
+				continue;
+
+			const int offset = row * Tile_Width + group * 4;
+			const __m128 z = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( triangle.depthA ), px ),
+			                             _mm_set1_ps( triangle.depthB * py + triangle.depthC ) );
+			const __m128 current = _mm_loadu_ps( &depth[offset] );
+			const __m128 pass = _mm_and_ps( inside, _mm_cmplt_ps( z, current ) );
+
+			if( target != NULL )
+			{
+				_mm_storeu_ps( &target[offset], _mm_or_ps( _mm_and_ps( pass, z ), _mm_andnot_ps( pass, current ) ) );
+			}
+			else
+			{
+				samples += s_bitCount[_mm_movemask_ps( pass )];
+				if( maxSamples > 0 && samples >= maxSamples )
+					return samples;
+			}
+		}
+	}
+
+#else
+
+	const int colBegin = groupBegin * 4;
+	const int colEnd = groupEnd * 4 + 3;
+
+	for( int row = rowBegin; row <= rowEnd; ++row )
+	{
+		const float py = originY + row + 0.5f;
+
+		for( int col = colBegin; col <= colEnd; ++col )
+		{
+			const float px = originX + col + 0.5f;
+
+			bool inside = true;
+			for( int e = 0; e < 3 && inside; ++e )
+				inside = ( triangle.edgeA[e] * px + triangle.edgeB[e] * py + triangle.edgeC[e] ) >= 0.0f;
+
+			if( !inside )
+				continue;
+
+			const int offset = row * Tile_Width + col;
+			const float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+
+			if( z >= depth[offset] )
+				continue;
+
+			if( target != NULL )
+			{
+				target[offset] = z;
+			}
+			else
+			{
+				++samples;
+				if( maxSamples > 0 && samples >= maxSamples )
+					return samples;
+			}
+		}
+	}
+
+#endif
+
+	return samples;
+}
+
+void SoftwareRasterizer::updateTileMaxDepth( int tileIndex )
+{
+	const float* depth = &_depth[tileIndex * Tile_Size];
+
+	float maxDepth = depth[0];
+	for( int i = 1; i < Tile_Size; ++i )
+		maxDepth = vr::max( maxDepth, depth[i] );
+
+	_tileMaxDepth[tileIndex] = maxDepth;
+}
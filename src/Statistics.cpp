@@ -1,23 +1,337 @@
 #include <vdlib/Statistics.h>
 #include <vdlib/Box.h>
 
+#if defined( VDLIB_SSE )
+	#include <xmmintrin.h>
+#endif
+
 using namespace vdlib;
 
-void Statistics::average( vr::vec3f& avg, const float* vertices, int size )
+vr::int64 Statistics::s_parallelThreshold = 1024 * 1024;
+
+// Update minimum and maximum projections of vertices in [begin, end) along box axes
+static void projectVertices( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center, 
+                             const float* vertices, vr::int64 begin, vr::int64 end )
+{
+	for( vr::int64 i = begin; i < end; i+=3 )
+	{
+		vr::vec3f vertexMinusCenter = vr::vec3f( &vertices[i] ) - center;
+
+		for( int a = 0; a < 3; ++a )
+		{
+			float d = vertexMinusCenter.dot( axis[a] );
+			if( d < result.minValues[a] )
+				result.minValues[a] = d;
+			else if( d > result.maxValues[a] )
+				result.maxValues[a] = d;
+		}
+	}
+}
+
+#if defined( VDLIB_SSE )
+
+// Same as above, 4 vertices at a time. Return number of floats processed, a multiple of 12.
+static vr::int64 projectVerticesSimd( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center, 
+                                      const float* vertices, vr::int64 size )
+{
+	const vr::int64 simdSize = size - size % 12;
+	if( simdSize == 0 )
+		return 0;
+
+	const __m128 cx = _mm_set1_ps( center.x );
+	const __m128 cy = _mm_set1_ps( center.y );
+	const __m128 cz = _mm_set1_ps( center.z );
+
+	__m128 ax[3], ay[3], az[3], minValues[3], maxValues[3];
+	for( int a = 0; a < 3; ++a )
+	{
+		ax[a] = _mm_set1_ps( axis[a].x );
+		ay[a] = _mm_set1_ps( axis[a].y );
+		az[a] = _mm_set1_ps( axis[a].z );
+		minValues[a] = _mm_set1_ps( result.minValues[a] );
+		maxValues[a] = _mm_set1_ps( result.maxValues[a] );
+	}
+
+	for( vr::int64 i = 0; i < simdSize; i+=12 )
+	{
+		// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		const __m128 a = _mm_loadu_ps( vertices + i );
+		const __m128 b = _mm_loadu_ps( vertices + i + 4 );
+		const __m128 c = _mm_loadu_ps( vertices + i + 8 );
+
+		// Transpose into x0 x1 x2 x3, y0 y1 y2 y3 and z0 z1 z2 z3
+		const __m128 x = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 3, 0 ) );
+		const __m128 y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ), 
+		                                 _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		const __m128 z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ), 
+		                                 _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+
+		const __m128 dx = _mm_sub_ps( x, cx );
+		const __m128 dy = _mm_sub_ps( y, cy );
+		const __m128 dz = _mm_sub_ps( z, cz );
+
+		for( int k = 0; k < 3; ++k )
+		{
+			const __m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, ax[k] ), _mm_mul_ps( dy, ay[k] ) ), _mm_mul_ps( dz, az[k] ) );
+			minValues[k] = _mm_min_ps( minValues[k], d );
+			maxValues[k] = _mm_max_ps( maxValues[k], d );
+		}
+	}
+
+	// Reduce lanes
+	for( int k = 0; k < 3; ++k )
+	{
+		float lanes[4];
+		_mm_storeu_ps( lanes, minValues[k] );
+		result.minValues[k] = vr::min( vr::min( lanes[0], lanes[1] ), vr::min( lanes[2], lanes[3] ) );
+		_mm_storeu_ps( lanes, maxValues[k] );
+		result.maxValues[k] = vr::max( vr::max( lanes[0], lanes[1] ), vr::max( lanes[2], lanes[3] ) );
+	}
+
+	return simdSize;
+}
+
+#endif
+
+// Update minimum and maximum values along X, Y and Z with vertices in [vertices, vertices + size)
+static void minMaxRange( MinMax& result, const float* vertices, vr::int64 size )
+{
+	vr::int64 begin = 0;
+
+#if defined( VDLIB_SSE )
+	// Vertices are not transposed: 12 floats are 4 whole vertices in three registers,
+	// with components rotated by one lane from register to register.
+	// x y z x | y z x y | z x y z
+	const vr::int64 simdSize = size - size % 12;
+	if( simdSize > 0 )
+	{
+		__m128 minA = _mm_loadu_ps( vertices );
+		__m128 minB = _mm_loadu_ps( vertices + 4 );
+		__m128 minC = _mm_loadu_ps( vertices + 8 );
+		__m128 maxA = minA;
+		__m128 maxB = minB;
+		__m128 maxC = minC;
+
+		for( vr::int64 i = 12; i < simdSize; i+=12 )
+		{
+			const __m128 a = _mm_loadu_ps( vertices + i );
+			const __m128 b = _mm_loadu_ps( vertices + i + 4 );
+			const __m128 c = _mm_loadu_ps( vertices + i + 8 );
+			minA = _mm_min_ps( minA, a );
+			minB = _mm_min_ps( minB, b );
+			minC = _mm_min_ps( minC, c );
+			maxA = _mm_max_ps( maxA, a );
+			maxB = _mm_max_ps( maxB, b );
+			maxC = _mm_max_ps( maxC, c );
+		}
+
+		// Lane i of the 12 floats holds component i % 3
+		float lanes[12];
+		_mm_storeu_ps( lanes, minA );
+		_mm_storeu_ps( lanes + 4, minB );
+		_mm_storeu_ps( lanes + 8, minC );
+		for( int i = 0; i < 12; ++i )
+			result.minValues[i % 3] = vr::min( result.minValues[i % 3], lanes[i] );
+
+		_mm_storeu_ps( lanes, maxA );
+		_mm_storeu_ps( lanes + 4, maxB );
+		_mm_storeu_ps( lanes + 8, maxC );
+		for( int i = 0; i < 12; ++i )
+			result.maxValues[i % 3] = vr::max( result.maxValues[i % 3], lanes[i] );
+
+		begin = simdSize;
+	}
+#endif
+
+	for( vr::int64 i = begin; i < size; i+=3 )
+	{
+		for( int a = 0; a < 3; ++a )
+		{
+			result.minValues[a] = vr::min( result.minValues[a], vertices[i+a] );
+			result.maxValues[a] = vr::max( result.maxValues[a], vertices[i+a] );
+		}
+	}
+}
+
+#ifdef _OPENMP
+
+// Vertex floats reduced by one thread at a time, whole SIMD groups
+static const vr::int64 Parallel_Block_Size = 12 * 16384;
+
+// Same as above, splitting ranges into blocks reduced by different threads.
+// Result must already hold valid initial values.
+static void minMaxParallel( MinMax& result, const VertexRange* ranges, int rangeCount )
+{
+	std::vector<VertexRange> blocks;
+	for( int r = 0; r < rangeCount; ++r )
+	{
+		for( vr::int64 offset = 0; offset < ranges[r].size; offset += Parallel_Block_Size )
+		{
+			VertexRange block;
+			block.vertices = ranges[r].vertices + offset;
+			block.size = vr::min( Parallel_Block_Size, ranges[r].size - offset );
+			blocks.push_back( block );
+		}
+	}
+
+	// OpenMP 2.0 has no min/max reduction, keep one result per block
+	const int blockCount = (int)blocks.size();
+	std::vector<MinMax> partial( blockCount, result );
+
+	#pragma omp parallel for schedule( static )
+	for( int b = 0; b < blockCount; ++b )
+		minMaxRange( partial[b], blocks[b].vertices, blocks[b].size );
+
+	for( int b = 0; b < blockCount; ++b )
+	{
+		for( int a = 0; a < 3; ++a )
+		{
+			result.minValues[a] = vr::min( result.minValues[a], partial[b].minValues[a] );
+			result.maxValues[a] = vr::max( result.maxValues[a], partial[b].maxValues[a] );
+		}
+	}
+}
+
+#endif
+
+void Moments::reset()
+{
+	count = 0;
+
+	for( int i = 0; i < 3; ++i )
+		sum[i] = 0.0;
+
+	for( int i = 0; i < 6; ++i )
+		sumProd[i] = 0.0;
+}
+
+void Moments::add( const Moments& other )
+{
+	count += other.count;
+
+	for( int i = 0; i < 3; ++i )
+		sum[i] += other.sum[i];
+
+	for( int i = 0; i < 6; ++i )
+		sumProd[i] += other.sumProd[i];
+}
+
+void Statistics::setParallelThreshold( vr::int64 size )
+{
+	s_parallelThreshold = size;
+}
+
+vr::int64 Statistics::getParallelThreshold()
+{
+	return s_parallelThreshold;
+}
+
+void Statistics::moments( Moments& result, const float* vertices, vr::int64 size )
+{
+	result.reset();
+
+	// For each vertex
+	for( vr::int64 k = 0; k < size; k+=3 )
+	{
+		const double x = vertices[k];
+		const double y = vertices[k+1];
+		const double z = vertices[k+2];
+
+		result.sum[0] += x;
+		result.sum[1] += y;
+		result.sum[2] += z;
+
+		result.sumProd[0] += x * x;
+		result.sumProd[1] += x * y;
+		result.sumProd[2] += x * z;
+		result.sumProd[3] += y * y;
+		result.sumProd[4] += y * z;
+		result.sumProd[5] += z * z;
+	}
+
+	result.count = size / 3;
+}
+
+void Statistics::covariance( float covariance[3][3], vr::vec3f& average, const Moments& moments )
+{
+	// Average = 1/n * SUM( v )
+	// C[i][j] = 1/n * SUM( v[i] * v[j] ) - Average[i] * Average[j]
+	const double invCount = 1.0 / (double)moments.count;
+
+	const double mx = moments.sum[0] * invCount;
+	const double my = moments.sum[1] * invCount;
+	const double mz = moments.sum[2] * invCount;
+
+	average.set( (float)mx, (float)my, (float)mz );
+
+	covariance[0][0] = (float)( moments.sumProd[0] * invCount - mx * mx );
+	covariance[0][1] = (float)( moments.sumProd[1] * invCount - mx * my );
+	covariance[0][2] = (float)( moments.sumProd[2] * invCount - mx * mz );
+	covariance[1][1] = (float)( moments.sumProd[3] * invCount - my * my );
+	covariance[1][2] = (float)( moments.sumProd[4] * invCount - my * mz );
+	covariance[2][2] = (float)( moments.sumProd[5] * invCount - mz * mz );
+	covariance[1][0] = covariance[0][1];
+	covariance[2][0] = covariance[0][2];
+	covariance[2][1] = covariance[1][2];
+}
+
+void Statistics::average( vr::vec3f& avg, const float* vertices, vr::int64 size )
+{
+	VertexRange range;
+	range.vertices = vertices;
+	range.size = size;
+	average( avg, &range, 1 );
+}
+
+void Statistics::covariance( float covariance[3][3], const vr::vec3f& average, const float* vertices, vr::int64 size )
+{
+	VertexRange range;
+	range.vertices = vertices;
+	range.size = size;
+	Statistics::covariance( covariance, average, &range, 1 );
+}
+
+void Statistics::minMaxVertices( MinMax& result, const float* vertices, vr::int64 size )
+{
+	VertexRange range;
+	range.vertices = vertices;
+	range.size = size;
+	minMaxVertices( result, &range, 1 );
+}
+
+void Statistics::axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center,
+				                  const float* vertices, vr::int64 size )
+{
+	VertexRange range;
+	range.vertices = vertices;
+	range.size = size;
+	axisMinMaxValues( result, axis, center, &range, 1 );
+}
+
+void Statistics::average( vr::vec3f& avg, const VertexRange* ranges, int rangeCount )
 {
 	// Average equation:
 	// Average = 1/n * SUM( all vertices )
 	avg.set( 0.0f, 0.0f, 0.0f );
 
+	vr::int64 size = 0;
+
 	// For each vertex
-	for( int i = 0; i < size; i+=3 )
-		avg += vr::vec3f( &vertices[i] );
+	for( int r = 0; r < rangeCount; ++r )
+	{
+		const float* rangeVertices = ranges[r].vertices;
+
+		for( vr::int64 i = 0; i < ranges[r].size; i+=3 )
+			avg += vr::vec3f( &rangeVertices[i] );
+
+		size += ranges[r].size;
+	}
 
 	// 1/n = 1 / (size/3)
 	avg *= ( 3.0f / (float)size );
 }
 
-void Statistics::covariance( float covariance[3][3], const vr::vec3f& average, const float* vertices, int size )
+void Statistics::covariance( float covariance[3][3], const vr::vec3f& average, const VertexRange* ranges, int rangeCount )
 {
 	vr::vec3f vertex;
 
@@ -32,18 +346,27 @@ void Statistics::covariance( float covariance[3][3], const vr::vec3f& average, c
 	float sumYZ = 0;
 	float sumZZ = 0;
 
+	vr::int64 size = 0;
+
 	// For each vertex
-	for( int k = 0; k < size; k+=3 )
+	for( int r = 0; r < rangeCount; ++r )
 	{
-		vertex.set( &vertices[k] );
-		vertex -= average;
+		const float* rangeVertices = ranges[r].vertices;
+
+		for( vr::int64 k = 0; k < ranges[r].size; k+=3 )
+		{
+			vertex.set( &rangeVertices[k] );
+			vertex -= average;
 
-		sumXX += vertex.x * vertex.x;
-		sumXY += vertex.x * vertex.y;
-		sumXZ += vertex.x * vertex.z;
-		sumYY += vertex.y * vertex.y;
-		sumYZ += vertex.y * vertex.z;
-		sumZZ += vertex.z * vertex.z;
+			sumXX += vertex.x * vertex.x;
+			sumXY += vertex.x * vertex.y;
+			sumXZ += vertex.x * vertex.z;
+			sumYY += vertex.y * vertex.y;
+			sumYZ += vertex.y * vertex.z;
+			sumZZ += vertex.z * vertex.z;
+		}
+
+		size += ranges[r].size;
 	}
 
 	// 1/n = 1 / (size/3)
@@ -61,45 +384,39 @@ void Statistics::covariance( float covariance[3][3], const vr::vec3f& average, c
 	covariance[2][2] = sumZZ * invCount;
 }
 
-void Statistics::minMaxVertices( MinMax& result, const float* vertices, int size )
+void Statistics::minMaxVertices( MinMax& result, const VertexRange* ranges, int rangeCount )
 {
 	// Get initial values
-	result.minValues.set( &vertices[0] );
-	result.maxValues.set( &vertices[0] );
-
-	// For each vertex beyond first
-	for( int i = 3; i < size; i+=3 )
-	{
-		// X
-		if( vertices[i] < result.minValues[0] )
-			result.minValues[0] = vertices[i];
-		else if( vertices[i] > result.maxValues[0] )
-			result.maxValues[0] = vertices[i];
+	result.minValues.set( ranges[0].vertices );
+	result.maxValues.set( ranges[0].vertices );
 
-		// Y
-		if( vertices[i+1] < result.minValues[1] )
-			result.minValues[1] = vertices[i+1];
-		else if( vertices[i+1] > result.maxValues[1] )
-			result.maxValues[1] = vertices[i+1];
+#ifdef _OPENMP
+	vr::int64 size = 0;
+	for( int r = 0; r < rangeCount; ++r )
+		size += ranges[r].size;
 
-		// Z
-		if( vertices[i+2] < result.minValues[2] )
-			result.minValues[2] = vertices[i+2];
-		else if( vertices[i+2] > result.maxValues[2] )
-			result.maxValues[2] = vertices[i+2];
+	if( size >= s_parallelThreshold )
+	{
+		minMaxParallel( result, ranges, rangeCount );
+		return;
 	}
+#endif
+
+	// For each vertex, first one is visited again
+	for( int r = 0; r < rangeCount; ++r )
+		minMaxRange( result, ranges[r].vertices, ranges[r].size );
 }
 
-void Statistics::axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center, 
-				                  const float* vertices, int size )
+void Statistics::axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], const vr::vec3f& center,
+				                  const VertexRange* ranges, int rangeCount )
 {
 	// Get initial values
-	vr::vec3f vertex( &vertices[0] );
+	vr::vec3f vertex( ranges[0].vertices );
 
 	const vr::vec3f diff = vertex - center;
-	float di = diff.dot( axis[0] );
-	float dj = diff.dot( axis[1] );
-	float dk = diff.dot( axis[2] );
+	const float di = diff.dot( axis[0] );
+	const float dj = diff.dot( axis[1] );
+	const float dk = diff.dot( axis[2] );
 
 	result.minValues[0] = di;
 	result.maxValues[0] = di;
@@ -108,31 +425,120 @@ void Statistics::axisMinMaxValues( MinMax& result, const vr::vec3f axis[3], cons
 	result.minValues[2] = dk;
 	result.maxValues[2] = dk;
 
-	// For each vertex beyond first
-	for( int i = 3; i < size; i+=3 )
-	{
-		vertex.set( &vertices[i] );
-		vr::vec3f vertexMinusCenter = vertex - center;
-
-		// I
-		di = vertexMinusCenter.dot( axis[0] );
-		if( di < result.minValues[0] )
-			result.minValues[0] = di;
-		else if( di > result.maxValues[0] )
-			result.maxValues[0] = di;
-
-		// J
-		dj = vertexMinusCenter.dot( axis[1] );
-		if( dj < result.minValues[1] )
-			result.minValues[1] = dj;
-		else if( dj > result.maxValues[1] )
-			result.maxValues[1] = dj;
-
-		// K
-		dk = vertexMinusCenter.dot( axis[2] );
-		if( dk < result.minValues[2] )
-			result.minValues[2] = dk;
-		else if( dk > result.maxValues[2] )
-			result.maxValues[2] = dk;
+	// For each vertex, first one is visited again
+	for( int r = 0; r < rangeCount; ++r )
+	{
+		vr::int64 begin = 0;
+#if defined( VDLIB_SSE )
+		begin = projectVerticesSimd( result, axis, center, ranges[r].vertices, ranges[r].size );
+#endif
+		projectVertices( result, axis, center, ranges[r].vertices, begin, ranges[r].size );
+	}
+}
+
+void Statistics::averageAndCovariance( vr::vec3f& average, float covariance[3][3], const VertexRange* ranges, int rangeCount )
+{
+	// Shift origin to first vertex: covariance does not change, but sums stay small
+	const double ox = ranges[0].vertices[0];
+	const double oy = ranges[0].vertices[1];
+	const double oz = ranges[0].vertices[2];
+
+	double sumX = 0.0;
+	double sumY = 0.0;
+	double sumZ = 0.0;
+	double sumXX = 0.0;
+	double sumXY = 0.0;
+	double sumXZ = 0.0;
+	double sumYY = 0.0;
+	double sumYZ = 0.0;
+	double sumZZ = 0.0;
+
+	vr::int64 size = 0;
+
+	// For each vertex
+	for( int r = 0; r < rangeCount; ++r )
+	{
+		const float* rangeVertices = ranges[r].vertices;
+
+		for( vr::int64 k = 0; k < ranges[r].size; k+=3 )
+		{
+			const double x = rangeVertices[k]   - ox;
+			const double y = rangeVertices[k+1] - oy;
+			const double z = rangeVertices[k+2] - oz;
+
+			sumX += x;
+			sumY += y;
+			sumZ += z;
+			sumXX += x * x;
+			sumXY += x * y;
+			sumXZ += x * z;
+			sumYY += y * y;
+			sumYZ += y * z;
+			sumZZ += z * z;
+		}
+
+		size += ranges[r].size;
+	}
+
+	// Average = 1/n * SUM( v )
+	// C[i][j] = 1/n * SUM( v[i] * v[j] ) - Average[i] * Average[j]
+	const double invCount = 3.0 / (double)size;
+	const double mx = sumX * invCount;
+	const double my = sumY * invCount;
+	const double mz = sumZ * invCount;
+
+	average.set( (float)( mx + ox ), (float)( my + oy ), (float)( mz + oz ) );
+
+	covariance[0][0] = (float)( sumXX * invCount - mx * mx );
+	covariance[0][1] = (float)( sumXY * invCount - mx * my );
+	covariance[0][2] = (float)( sumXZ * invCount - mx * mz );
+	covariance[1][1] = (float)( sumYY * invCount - my * my );
+	covariance[1][2] = (float)( sumYZ * invCount - my * mz );
+	covariance[2][2] = (float)( sumZZ * invCount - mz * mz );
+	covariance[1][0] = covariance[0][1];
+	covariance[2][0] = covariance[0][2];
+	covariance[2][1] = covariance[1][2];
+}
+
+void Statistics::extremalVertices( vr::vec3f* minVertices, vr::vec3f* maxVertices, const vr::vec3f* directions, int directionCount,
+		                           const VertexRange* ranges, int rangeCount )
+{
+	// Get initial values
+	const vr::vec3f first( ranges[0].vertices );
+
+	std::vector<float> minProjections( directionCount );
+	std::vector<float> maxProjections( directionCount );
+
+	for( int d = 0; d < directionCount; ++d )
+	{
+		minProjections[d] = maxProjections[d] = first.dot( directions[d] );
+		minVertices[d] = first;
+		maxVertices[d] = first;
+	}
+
+	// For each vertex, first one is visited again
+	for( int r = 0; r < rangeCount; ++r )
+	{
+		const float* rangeVertices = ranges[r].vertices;
+
+		for( vr::int64 k = 0; k < ranges[r].size; k+=3 )
+		{
+			const vr::vec3f vertex( &rangeVertices[k] );
+
+			for( int d = 0; d < directionCount; ++d )
+			{
+				const float projection = vertex.dot( directions[d] );
+				if( projection < minProjections[d] )
+				{
+					minProjections[d] = projection;
+					minVertices[d] = vertex;
+				}
+				else if( projection > maxProjections[d] )
+				{
+					maxProjections[d] = projection;
+					maxVertices[d] = vertex;
+				}
+			}
+		}
 	}
 }
@@ -4,23 +4,149 @@
 #include <vdlib/RawNode.h>
 #include <vdlib/Geometry.h>
 #include <vdlib/Distance.h>
+#include <vdlib/BoxFactory.h>
+#include <vdlib/Statistics.h>
+
+#include <float.h>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 
 using namespace vdlib;
 
+//////////////////////////////////////////////////////////////////////////
+// Surface Area Heuristic helpers
+//////////////////////////////////////////////////////////////////////////
+
+// Candidate split positions per axis are the boundaries between bins
+static const int Sah_Bin_Count = 16;
+
+// Relative cost of visiting one node and of processing one geometry
+static const float Sah_Traversal_Cost = 1.0f;
+static const float Sah_Geometry_Cost = 1.0f;
+
+// Bounds given by intervals along the three axes of a node's box
+class SahBounds
+{
+public:
+	void reset()
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			minimum[i] = FLT_MAX;
+			maximum[i] = -FLT_MAX;
+		}
+	}
+
+	void expand( const float* center, const float* radius )
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			minimum[i] = vr::min( minimum[i], center[i] - radius[i] );
+			maximum[i] = vr::max( maximum[i], center[i] + radius[i] );
+		}
+	}
+
+	void expand( const SahBounds& other )
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			minimum[i] = vr::min( minimum[i], other.minimum[i] );
+			maximum[i] = vr::max( maximum[i], other.maximum[i] );
+		}
+	}
+
+	float getSurfaceArea() const
+	{
+		if( minimum[0] > maximum[0] )
+			return 0.0f;
+
+		float dx = maximum[0] - minimum[0];
+		float dy = maximum[1] - minimum[1];
+		float dz = maximum[2] - minimum[2];
+		return 2.0f * ( dx * dy + dy * dz + dz * dx );
+	}
+
+	float minimum[3];
+	float maximum[3];
+};
+
+// Geometries whose centers fall inside one bin
+class SahBin
+{
+public:
+	void reset()
+	{
+		bounds.reset();
+		geometryCount = 0;
+		vertexCount = 0;
+	}
+
+	SahBounds bounds;
+	int geometryCount;
+	vr::int64 vertexCount;
+};
+
+static float computeSurfaceArea( const Box& box )
+{
+	return 8.0f * ( box.extents[0] * box.extents[1] + box.extents[1] * box.extents[2] + box.extents[2] * box.extents[0] );
+}
+
 void TreeBuilder::Statistics::reset()
 {
 	leafCount = 0;
 	nodeCount = 0;
 	treeDepth = 0;
+	sahCost = 0.0f;
 }
 
 // TreeBuilder implementation
 TreeBuilder::TreeBuilder()
 {
 	_stats.reset();
+	_splitHeuristic = Split_Average_Center;
+	_boundsMode = Bounds_Vertices;
 	_maxTreeDepth = 24;
 	_minVertexCount = 3000;
 	_minGeometryCount = 1;
+	_parallelBuild = false;
+	_parallelCutoff = 300000;
+}
+
+void TreeBuilder::setSplitHeuristic( SplitHeuristic heuristic )
+{
+	_splitHeuristic = heuristic;
+}
+
+TreeBuilder::SplitHeuristic TreeBuilder::getSplitHeuristic() const
+{
+	return _splitHeuristic;
+}
+
+void TreeBuilder::setBoundsMode( BoundsMode mode )
+{
+	_boundsMode = mode;
+}
+
+TreeBuilder::BoundsMode TreeBuilder::getBoundsMode() const
+{
+	return _boundsMode;
+}
+
+void TreeBuilder::setMinVertexCount( vr::int64 count )
+{
+	_minVertexCount = count;
+}
+
+void TreeBuilder::setParallelBuild( bool enabled )
+{
+	_parallelBuild = enabled;
+}
+
+void TreeBuilder::setParallelCutoff( vr::int64 vertexCount )
+{
+	_parallelCutoff = vertexCount;
 }
 
 vr::ref_ptr<Node> TreeBuilder::createTree( SceneData& sceneData )
@@ -32,13 +158,43 @@ vr::ref_ptr<Node> TreeBuilder::createTree( SceneData& sceneData )
 
 	// TODO: to be verified
 	// Set maximum tree depth based on number of geometries on scene
-	_maxTreeDepth = (int)( 1.2 * vr::log2( (double)sceneNode->getGeometryInfos().size() ) + 2.0 );
+	_maxTreeDepth = (int)( 1.2 * vr::log2( (double)sceneNode->getGeometryCount() ) + 2.0 );
 
-	// Count root node
-	++_stats.nodeCount;
+	// Merged covariance OBBs need the moments of each geometry
+	if( _boundsMode == Bounds_Merged && BoxFactory::getDefaultBoxType() == BoxFactory::Type_Obb )
+		computeGeometryMoments( sceneNode );
 
 	// Recursive hierarchy construction
+#if defined( _OPENMP ) && ( _OPENMP >= 200805 )
+	// Task-based recursion, started by a single thread of the team
+	if( _parallelBuild )
+	{
+		#pragma omp parallel
+		{
+			#pragma omp single
+			recursiveCreateHierarchy( sceneNode );
+		}
+	}
+	else
+	{
+		recursiveCreateHierarchy( sceneNode );
+	}
+#elif defined( _OPENMP )
+	// Nested parallel sections (OpenMP 2.0)
+	int wasNested = omp_get_nested();
+	omp_set_nested( _parallelBuild ? 1 : 0 );
 	recursiveCreateHierarchy( sceneNode );
+	omp_set_nested( wasNested );
+#else
+	recursiveCreateHierarchy( sceneNode );
+#endif
+
+	// Node ids and statistics
+	finishHierarchy( sceneNode->getHierarchyNode() );
+
+	// Geometry information is no longer needed, hierarchy nodes reference geometries directly
+	vr::vectorFreeMemory( sceneNode->getGeometryInfos() );
+	sceneNode->setGeometryRange( 0, 0, sceneNode->getVertexCount() );
 
 	// Return stored scene root
 	return vr::ref_ptr<Node>( sceneNode->getHierarchyNode() );
@@ -52,10 +208,26 @@ const TreeBuilder::Statistics& TreeBuilder::getStatistics() const
 //////////////////////////////////////////////////////////////////////////
 // Private
 //////////////////////////////////////////////////////////////////////////
+void TreeBuilder::computeGeometryMoments( RawNode* sceneNode )
+{
+	const int geometryCount = sceneNode->getGeometryCount();
+
+	// Each geometry is independent
+	#pragma omp parallel for if( _parallelBuild ) schedule( dynamic, 64 )
+	for( int i = 0; i < geometryCount; ++i )
+	{
+		GeometryInfo* info = sceneNode->getGeometryInfo( i );
+		vdlib::Statistics::moments( info->moments, info->vertices, info->verticesSize );
+	}
+}
+
 void TreeBuilder::recursiveCreateHierarchy( RawNode* node )
 {
 	// Create node's bounding box
-	node->computeBoundingBox();
+	if( _boundsMode == Bounds_Merged )
+		node->computeMergedBoundingBox();
+	else
+		node->computeBoundingBox();
 
 	// Heuristic criteria to stop recursive construction algorithm
 	if( checkTerminateRecursion( node ) != Condition_Ok )
@@ -78,11 +250,40 @@ void TreeBuilder::recursiveCreateHierarchy( RawNode* node )
 		// Recursively create hierarchy for both sub-trees
 		// Delete all construction nodes except for root.
 		// Actual tree will be preserved in hierarchy node inside root node.
-		recursiveCreateHierarchy( node->getLeftChild() );
-		node->removeLeftChild();
-	
-		recursiveCreateHierarchy( node->getRightChild() );
-		node->removeRightChild();
+		if( isParallelNode( node ) )
+		{
+			// Each subtree only touches its own nodes and geometries
+			RawNode* left = node->getLeftChild();
+			RawNode* right = node->getRightChild();
+
+#if defined( _OPENMP ) && ( _OPENMP >= 200805 )
+			#pragma omp task firstprivate( left )
+			recursiveCreateHierarchy( left );
+
+			recursiveCreateHierarchy( right );
+
+			#pragma omp taskwait
+#else
+			#pragma omp parallel sections num_threads( 2 )
+			{
+				#pragma omp section
+				recursiveCreateHierarchy( left );
+
+				#pragma omp section
+				recursiveCreateHierarchy( right );
+			}
+#endif
+			node->removeLeftChild();
+			node->removeRightChild();
+		}
+		else
+		{
+			recursiveCreateHierarchy( node->getLeftChild() );
+			node->removeLeftChild();
+		
+			recursiveCreateHierarchy( node->getRightChild() );
+			node->removeRightChild();
+		}
 	}
 	else
 	{
@@ -93,10 +294,10 @@ void TreeBuilder::recursiveCreateHierarchy( RawNode* node )
 
 TreeBuilder::Condition TreeBuilder::checkTerminateRecursion( RawNode* node )
 {
-	if( (int)node->getVertices().size() <= _minVertexCount )
+	if( node->getVertexCount() <= _minVertexCount )
 		return Condition_Min_Vertex_Count;
 
-	if( (int)node->getGeometryInfos().size() <= _minGeometryCount )
+	if( node->getGeometryCount() <= _minGeometryCount )
 		return Condition_Min_Geometry_Count;
 
 	if( (int)node->getTreeDepth() >= _maxTreeDepth )
@@ -106,16 +307,25 @@ TreeBuilder::Condition TreeBuilder::checkTerminateRecursion( RawNode* node )
 }
 
 void TreeBuilder::findSplitPlane( Plane& plane, RawNode* node )
+{
+	// Fall back to average center if SAH finds no valid split
+	if( _splitHeuristic == Split_Sah && findSahSplit( plane, node ) )
+		return;
+
+	findAverageCenterSplit( plane, node );
+}
+
+void TreeBuilder::findAverageCenterSplit( Plane& plane, RawNode* node )
 {
 	// Average center split
-	GeometryInfoVector& geometryInfos = node->getGeometryInfos();
+	const int geometryCount = node->getGeometryCount();
 	vr::vec3f averageCenter( 0.0f, 0.0f, 0.0f );
 
 	// Compute center
-	for( unsigned int i = 0; i < geometryInfos.size(); ++i )
-		averageCenter += geometryInfos[i]->geometry->getBoundingBox().center;
+	for( int i = 0; i < geometryCount; ++i )
+		averageCenter += node->getGeometryInfo( i )->geometry->getBoundingBox().center;
 
-	averageCenter *= 1.0f / (float)geometryInfos.size();
+	averageCenter *= 1.0f / (float)geometryCount;
 
 	// Plane normal follows the longest axis of node's bounding box.
 	const vr::vec3f& normal = node->getHierarchyNode()->getBoundingBox().getLongestAxis();
@@ -124,99 +334,237 @@ void TreeBuilder::findSplitPlane( Plane& plane, RawNode* node )
 	plane.set( normal, averageCenter );
 }
 
+bool TreeBuilder::findSahSplit( Plane& plane, RawNode* node )
+{
+	const int geometryCount = node->getGeometryCount();
+
+	// Candidate plane normals are the node's box axes
+	const Box& nodeBox = node->getHierarchyNode()->getBoundingBox();
+
+	// Project geometry boxes onto node axes: center coordinate and half-length along each axis
+	std::vector<float> centers( geometryCount * 3 );
+	std::vector<float> radii( geometryCount * 3 );
+
+	SahBounds nodeBounds;
+	SahBounds centerBounds;
+	nodeBounds.reset();
+	centerBounds.reset();
+
+	const float zero[3] = { 0.0f, 0.0f, 0.0f };
+
+	for( int i = 0; i < geometryCount; ++i )
+	{
+		const Box& box = node->getGeometryInfo( i )->geometry->getBoundingBox();
+		float* center = &centers[i*3];
+		float* radius = &radii[i*3];
+
+		for( int a = 0; a < 3; ++a )
+		{
+			center[a] = box.center.dot( nodeBox.axis[a] );
+			radius[a] = vr::abs( box.axis[0].dot( nodeBox.axis[a] ) ) * box.extents[0] +
+			            vr::abs( box.axis[1].dot( nodeBox.axis[a] ) ) * box.extents[1] +
+			            vr::abs( box.axis[2].dot( nodeBox.axis[a] ) ) * box.extents[2];
+		}
+
+		nodeBounds.expand( center, radius );
+		centerBounds.expand( center, zero );
+	}
+
+	const float nodeArea = nodeBounds.getSurfaceArea();
+	if( nodeArea <= 0.0f )
+		return false;
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	float bestPosition = 0.0f;
+
+	SahBin bins[Sah_Bin_Count];
+	SahBin rightBins[Sah_Bin_Count];
+
+	for( int a = 0; a < 3; ++a )
+	{
+		const float centerMin = centerBounds.minimum[a];
+		const float centerExtent = centerBounds.maximum[a] - centerMin;
+
+		// All centers are on the same position, no split possible along this axis
+		if( centerExtent <= 0.0f )
+			continue;
+
+		const float binScale = (float)Sah_Bin_Count / centerExtent;
+
+		// Fill bins
+		for( int b = 0; b < Sah_Bin_Count; ++b )
+			bins[b].reset();
+
+		for( int i = 0; i < geometryCount; ++i )
+		{
+			int b = (int)( ( centers[i*3+a] - centerMin ) * binScale );
+			b = vr::clampTo( b, 0, Sah_Bin_Count - 1 );
+
+			bins[b].bounds.expand( &centers[i*3], &radii[i*3] );
+			++bins[b].geometryCount;
+			bins[b].vertexCount += node->getGeometryInfo( i )->verticesSize;
+		}
+
+		// Accumulate from the right, rightBins[b] holds bins b to last
+		rightBins[Sah_Bin_Count-1] = bins[Sah_Bin_Count-1];
+		for( int b = Sah_Bin_Count - 2; b >= 0; --b )
+		{
+			rightBins[b] = rightBins[b+1];
+			rightBins[b].bounds.expand( bins[b].bounds );
+			rightBins[b].geometryCount += bins[b].geometryCount;
+			rightBins[b].vertexCount += bins[b].vertexCount;
+		}
+
+		// Sweep from the left, evaluating the boundary after each bin
+		SahBin left;
+		left.reset();
+
+		for( int b = 0; b < Sah_Bin_Count - 1; ++b )
+		{
+			left.bounds.expand( bins[b].bounds );
+			left.geometryCount += bins[b].geometryCount;
+			left.vertexCount += bins[b].vertexCount;
+
+			const SahBin& right = rightBins[b+1];
+
+			// Same restrictions as partitionGeometries
+			if( left.geometryCount == 0 || right.geometryCount == 0 )
+				continue;
+
+			if( left.vertexCount < _minVertexCount || right.vertexCount < _minVertexCount )
+				continue;
+
+			float cost = Sah_Traversal_Cost + Sah_Geometry_Cost *
+				( left.bounds.getSurfaceArea() * (float)left.geometryCount +
+				  right.bounds.getSurfaceArea() * (float)right.geometryCount ) / nodeArea;
+
+			if( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestPosition = centerMin + (float)( b + 1 ) / binScale;
+			}
+		}
+	}
+
+	if( bestAxis < 0 )
+		return false;
+
+	// Geometries with center projection below split position go to the left child
+	const vr::vec3f& normal = nodeBox.axis[bestAxis];
+	plane.set( normal.x, normal.y, normal.z, -bestPosition );
+	return true;
+}
+
 TreeBuilder::Condition TreeBuilder::partitionGeometries( RawNode* node, const Plane& splitPlane )
 {
-	GeometryInfoVector& srcGeoms = node->getGeometryInfos();
-	GeometryInfoVector leftGeoms;
-	GeometryInfoVector rightGeoms;
+	// Partition node's range of the geometry pool in place:
+	// left geometries are moved to the beginning of the range, right geometries to the end.
+	GeometryInfoVector& geometryInfos = node->getGeometryInfos();
+
+	const int start = node->getGeometryStart();
+	int first = start;
+	int last = start + node->getGeometryCount() - 1;
 
-	int leftVertexCount = 0;
-	int rightVertexCount = 0;
+	vr::int64 leftVertexCount = 0;
+	vr::int64 rightVertexCount = 0;
 
-	for( unsigned int i = 0; i < srcGeoms.size(); ++i )
+	while( first <= last )
 	{
-		GeometryInfo* geom = srcGeoms[i].get();
-		
+		GeometryInfo* geom = geometryInfos[first].get();
+
 		float distanceToPlane = Distance::between( geom->geometry->getBoundingBox().center, splitPlane );
 
 		// This way, geometries that lie on the split plane are assigned to right child only
 		if( distanceToPlane < 0 )
 		{
 			leftVertexCount += geom->verticesSize;
-			leftGeoms.push_back( geom );
+			++first;
 		}
 		else
 		{
 			rightVertexCount += geom->verticesSize;
-			rightGeoms.push_back( geom );
+			std::swap( geometryInfos[first], geometryInfos[last] );
+			--last;
 		}
 	}
 
 	// If any of the children's complexity falls below minimum vertex count, we don't subdivide the current node.
+	// Geometries keep their new order, which is irrelevant to the current node.
 	if( ( leftVertexCount < _minVertexCount ) || ( rightVertexCount < _minVertexCount ) )
 		return Condition_Min_Vertex_Count;
 
-	// Go ahead and create children
-	RawNode* left  = new RawNode( _stats.nodeCount++ );
-	RawNode* right = new RawNode( _stats.nodeCount++ );
+	// Go ahead and create children, sharing vertex and geometry pools
+	const int leftGeometryCount = first - start;
 
-	// Source vertices to be partitioned
-	const std::vector<float>& vertices = node->getVertices();
+	RawNode* left  = new RawNode( node );
+	left->setGeometryRange( start, leftGeometryCount, leftVertexCount );
 
-	// Assign vertices to left child
-	std::vector<float>& leftVertices = left->getVertices();
-	leftVertices.reserve( leftVertexCount );
+	RawNode* right = new RawNode( node );
+	right->setGeometryRange( first, node->getGeometryCount() - leftGeometryCount, rightVertexCount );
 
-	for( unsigned int i = 0; i < leftGeoms.size(); ++i )
-	{
-		// Get iterator to source vertices
-		std::vector<float>::const_iterator startItr = vertices.begin() + leftGeoms[i]->verticesStart;
-		
-		// Update geometry info with new vertex start index
-		leftGeoms[i]->verticesStart = leftVertices.size();
+	// Add children
+	node->setLeftChild( left );
+	node->setRightChild( right );
 
-		// Copy source vertices to destination
-		leftVertices.insert( leftVertices.end(), startItr, startItr + leftGeoms[i]->verticesSize );
-	}
+	return Condition_Ok;
+}
+
+void TreeBuilder::setLeafNode( RawNode* node )
+{
+	// Merged AABBs are already tight, OBBs are shrunk to the leaf's vertices
+	if( _boundsMode == Bounds_Merged && BoxFactory::getDefaultBoxType() != BoxFactory::Type_Aabb )
+		node->refitBoundingBox();
 
-	left->getGeometryInfos() = leftGeoms;
+	node->assignGeometriesToHierarchyNode();
+}
 
-	// Assign vertices to right child
-	std::vector<float>& rightVertices = right->getVertices();
-	rightVertices.reserve( rightVertexCount );
+bool TreeBuilder::isParallelNode( RawNode* node ) const
+{
+#ifdef _OPENMP
+	return _parallelBuild && ( node->getVertexCount() >= _parallelCutoff );
+#else
+	return false;
+#endif
+}
 
-	for( unsigned int i = 0; i < rightGeoms.size(); ++i )
-	{
-		// Get iterator to source vertices
-		std::vector<float>::const_iterator startItr = vertices.begin() + rightGeoms[i]->verticesStart;
+void TreeBuilder::finishHierarchy( Node* root )
+{
+	// Surface areas are relative to the root
+	const float rootArea = computeSurfaceArea( root->getBoundingBox() );
+	const float invRootArea = ( rootArea > 0.0f ) ? 1.0f / rootArea : 0.0f;
 
-		// Update geometry info with new vertex start index
-		rightGeoms[i]->verticesStart = rightVertices.size();
+	// Pre-order traversal keeping track of node depth
+	std::vector< std::pair<Node*, int> > stack;
+	stack.push_back( std::make_pair( root, 0 ) );
 
-		// Copy source vertices to destination
-		rightVertices.insert( rightVertices.end(), startItr, startItr + rightGeoms[i]->verticesSize );
-	}
+	while( !stack.empty() )
+	{
+		Node* node = stack.back().first;
+		int depth = stack.back().second;
+		stack.pop_back();
 
-	right->getGeometryInfos() = rightGeoms;
+		node->setId( _stats.nodeCount++ );
 
-	// Add children
-	node->setLeftChild( left );
-	node->setRightChild( right );
+		const float relativeArea = computeSurfaceArea( node->getBoundingBox() ) * invRootArea;
 
-	// Save memory
-	vr::vectorTrim( left->getGeometryInfos() );
-	vr::vectorTrim( right->getGeometryInfos() );
-	vr::vectorFreeMemory( node->getGeometryInfos() );
+		if( node->isLeaf() )
+		{
+			_stats.sahCost += relativeArea * Sah_Geometry_Cost * (float)node->getGeometries().size();
+			++_stats.leafCount;
 
-	return Condition_Ok;
-}
+			if( depth > _stats.treeDepth )
+				_stats.treeDepth = depth;
+			continue;
+		}
 
-void TreeBuilder::setLeafNode( RawNode* node )
-{
-	node->assignGeometriesToHierarchyNode();
+		_stats.sahCost += relativeArea * Sah_Traversal_Cost;
 
-	if( node->getTreeDepth() > _stats.treeDepth )
-		_stats.treeDepth = node->getTreeDepth();
+		if( node->getRightChild() != NULL )
+			stack.push_back( std::make_pair( node->getRightChild(), depth + 1 ) );
 
-	++_stats.leafCount;
+		if( node->getLeftChild() != NULL )
+			stack.push_back( std::make_pair( node->getLeftChild(), depth + 1 ) );
+	}
 }
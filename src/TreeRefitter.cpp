@@ -0,0 +1,627 @@
+#include <vdlib/TreeRefitter.h>
+#include <vdlib/BoxFactory.h>
+#include <vdlib/PreOrderIterator.h>
+#include <algorithm>
+#include <cstdio>
+
+using namespace vdlib;
+
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+
+// Orders geometries by box center along one axis
+class GeometryCenterLess
+{
+public:
+	explicit GeometryCenterLess( int axis ) : _axis( axis ) {}
+
+	bool operator()( const vr::ref_ptr<Geometry>& a, const vr::ref_ptr<Geometry>& b ) const
+	{
+		return a->getBoundingBox().center[_axis] < b->getBoundingBox().center[_axis];
+	}
+
+private:
+	int _axis;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// TreeRefitter implementation
+
+TreeRefitter::TreeRefitter()
+{
+	_root = NULL;
+	_rebuildThreshold = 2.0f;
+	_refitNodeCount = 0;
+	_rebuiltNodeCount = 0;
+	_rotationCount = 0;
+}
+
+void TreeRefitter::init( Node* root )
+{
+	_root = root;
+	_geometryLeaves.clear();
+	_dirtyLeaves.clear();
+	_freeIds.clear();
+	_changedIds.clear();
+	_refitNodeCount = 0;
+	_rebuiltNodeCount = 0;
+	_rotationCount = 0;
+
+	if( root == NULL )
+		return;
+
+	// Ids are consecutive in pre-order, the last node has the largest id
+	int nodeCount = 0;
+	for( PreOrderIterator it( root ); !it.done(); it.next() )
+		nodeCount = vr::max( nodeCount, it->getId() + 1 );
+
+	_referenceAreas.assign( nodeCount, 0.0f );
+	_dirty.assign( nodeCount, 0 );
+
+	indexSubtree( root );
+}
+
+void TreeRefitter::setRebuildThreshold( float ratio )
+{
+	_rebuildThreshold = vr::max( ratio, 0.0f );
+}
+
+float TreeRefitter::getRebuildThreshold() const
+{
+	return _rebuildThreshold;
+}
+
+void TreeRefitter::updateGeometry( Geometry* geometry, const Box& box )
+{
+	std::map<const Geometry*, Node*>::const_iterator leaf = _geometryLeaves.find( geometry );
+	if( leaf == _geometryLeaves.end() )
+	{
+		printf( "TreeRefitter: geometry is not in the hierarchy!\n" );
+		return;
+	}
+
+	geometry->getBoundingBox() = box;
+	_dirtyLeaves.push_back( leaf->second );
+}
+
+void TreeRefitter::updateGeometries( Geometry* const* geometries, const Box* boxes, int count )
+{
+	for( int i = 0; i < count; ++i )
+		updateGeometry( geometries[i], boxes[i] );
+}
+
+void TreeRefitter::insertGeometry( Geometry* geometry )
+{
+	if( _root == NULL )
+	{
+		printf( "TreeRefitter: no hierarchy!\n" );
+		return;
+	}
+
+	if( _geometryLeaves.find( geometry ) != _geometryLeaves.end() )
+	{
+		printf( "TreeRefitter: geometry is already in the hierarchy!\n" );
+		return;
+	}
+
+	// Every geometry was removed, root is an empty leaf
+	if( _root->isLeaf() && _root->getGeometries().empty() )
+	{
+		_root->getGeometries().push_back( geometry );
+		_geometryLeaves[geometry] = _root;
+		fitBox( _root, false );
+		markStructure( _root );
+		return;
+	}
+
+	// New nodes and the sibling are kept alive while they are detached
+	vr::ref_ptr<Node> sibling = findSibling( geometry->getBoundingBox() );
+
+	vr::ref_ptr<Node> leaf = createNode();
+	leaf->getGeometries().push_back( geometry );
+	_geometryLeaves[geometry] = leaf.get();
+	fitBox( leaf.get(), false );
+
+	vr::ref_ptr<Node> parent = createNode();
+	if( sibling == _root )
+	{
+		// Client holds the root: its content moves down instead
+		moveContent( _root, parent.get() );
+		_root->setLeftChild( parent.get() );
+		_root->setRightChild( leaf.get() );
+		fitBox( _root, false );
+	}
+	else
+	{
+		replaceChild( sibling->getParent(), sibling.get(), parent.get() );
+		parent->setLeftChild( sibling.get() );
+		parent->setRightChild( leaf.get() );
+		fitBox( parent.get(), false );
+	}
+
+	markStructure( leaf.get() );
+}
+
+void TreeRefitter::removeGeometry( Geometry* geometry )
+{
+	std::map<const Geometry*, Node*>::iterator found = _geometryLeaves.find( geometry );
+	if( found == _geometryLeaves.end() )
+	{
+		printf( "TreeRefitter: geometry is not in the hierarchy!\n" );
+		return;
+	}
+
+	Node* leaf = found->second;
+	_geometryLeaves.erase( found );
+
+	GeometryVector& geometries = leaf->getGeometries();
+	for( unsigned int i = 0; i < geometries.size(); ++i )
+	{
+		if( geometries[i].get() == geometry )
+		{
+			geometries.erase( geometries.begin() + i );
+			break;
+		}
+	}
+
+	if( !geometries.empty() || leaf == _root )
+	{
+		markStructure( leaf );
+		return;
+	}
+
+	// Sibling takes the place of the parent. Detached nodes are kept alive until their ids are released.
+	Node* parent = leaf->getParent();
+	vr::ref_ptr<Node> keepLeaf = leaf;
+	vr::ref_ptr<Node> keepParent = parent;
+	vr::ref_ptr<Node> sibling = ( parent->getLeftChild() == leaf ) ? parent->getRightChild() : parent->getLeftChild();
+
+	parent->setLeftChild( NULL );
+	parent->setRightChild( NULL );
+
+	if( parent == _root )
+	{
+		// Client holds the root: sibling content moves up instead
+		moveContent( sibling.get(), parent );
+		releaseNode( sibling.get() );
+		markStructure( parent );
+	}
+	else
+	{
+		Node* grandparent = parent->getParent();
+		replaceChild( grandparent, parent, sibling.get() );
+		releaseNode( parent );
+		markStructure( grandparent );
+	}
+
+	releaseNode( leaf );
+}
+
+void TreeRefitter::refit()
+{
+	_refitNodeCount = 0;
+	_rebuiltNodeCount = 0;
+	_rotationCount = 0;
+
+	if( _root == NULL || ( !_dirty[_root->getId()] && _dirtyLeaves.empty() ) )
+		return;
+
+	// Mark leaves and their ancestors, stop at ancestors already marked by another geometry
+	for( unsigned int i = 0; i < _dirtyLeaves.size(); ++i )
+	{
+		for( Node* node = _dirtyLeaves[i]; node != NULL && !_dirty[node->getId()]; node = node->getParent() )
+			_dirty[node->getId()] = Dirty_Refit;
+	}
+	_dirtyLeaves.clear();
+
+	refitNode( _root );
+
+	if( _rebuildThreshold > 0.0f )
+	{
+		rebuildDegraded( _root );
+
+		// Ancestors of rebuilt subtrees enclose their new boxes
+		if( _rebuiltNodeCount > 0 )
+			refitNode( _root );
+	}
+
+	std::fill( _dirty.begin(), _dirty.end(), 0 );
+}
+
+int TreeRefitter::getRefitNodeCount() const
+{
+	return _refitNodeCount;
+}
+
+int TreeRefitter::getRebuiltNodeCount() const
+{
+	return _rebuiltNodeCount;
+}
+
+int TreeRefitter::getRotationCount() const
+{
+	return _rotationCount;
+}
+
+int TreeRefitter::getNodeCapacity() const
+{
+	return (int)_referenceAreas.size();
+}
+
+int TreeRefitter::compactIds()
+{
+	if( _root == NULL )
+		return 0;
+
+	std::vector<float> referenceAreas;
+	std::vector<char> dirty;
+
+	int nodeCount = 0;
+	for( PreOrderIterator it( _root ); !it.done(); it.next() )
+	{
+		referenceAreas.push_back( _referenceAreas[it->getId()] );
+		dirty.push_back( _dirty[it->getId()] );
+		it->setId( nodeCount++ );
+	}
+
+	_referenceAreas.swap( referenceAreas );
+	_dirty.swap( dirty );
+	vr::vectorFreeMemory( _freeIds );
+
+	_changedIds.resize( nodeCount );
+	for( int i = 0; i < nodeCount; ++i )
+		_changedIds[i] = i;
+
+	return nodeCount;
+}
+
+void TreeRefitter::takeChangedIds( std::vector<int>& ids )
+{
+	std::sort( _changedIds.begin(), _changedIds.end() );
+	_changedIds.erase( std::unique( _changedIds.begin(), _changedIds.end() ), _changedIds.end() );
+
+	ids.swap( _changedIds );
+	_changedIds.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+void TreeRefitter::refitNode( Node* node )
+{
+	const char dirty = _dirty[node->getId()];
+	if( !dirty )
+		return;
+
+	if( !node->isLeaf() )
+	{
+		refitNode( node->getLeftChild() );
+		refitNode( node->getRightChild() );
+
+		if( dirty == Dirty_Structure )
+			rotateNode( node );
+	}
+
+	fitBox( node, true );
+	++_refitNodeCount;
+
+	// Growth caused by inserted geometries is not degradation
+	if( dirty == Dirty_Structure )
+	{
+		_referenceAreas[node->getId()] = surfaceArea( node->getBoundingBox() );
+		_changedIds.push_back( node->getId() );
+	}
+}
+
+void TreeRefitter::rebuildDegraded( Node* node )
+{
+	if( !_dirty[node->getId()] )
+		return;
+
+	// Topmost degraded node: rebuilding it also fixes everything below
+	if( surfaceArea( node->getBoundingBox() ) > _rebuildThreshold * _referenceAreas[node->getId()] )
+	{
+		rebuildSubtree( node );
+		return;
+	}
+
+	if( !node->isLeaf() )
+	{
+		rebuildDegraded( node->getLeftChild() );
+		rebuildDegraded( node->getRightChild() );
+	}
+}
+
+void TreeRefitter::rebuildSubtree( Node* root )
+{
+	// Nodes are kept alive here while they are detached from each other
+	std::vector< vr::ref_ptr<Node> > nodes;
+	std::vector<int> ids;
+	GeometryVector geometries;
+
+	for( PreOrderIterator it( root ); !it.done(); it.next() )
+	{
+		nodes.push_back( it.current() );
+		ids.push_back( it->getId() );
+		if( it->isLeaf() )
+			geometries.insert( geometries.end(), it->getGeometries().begin(), it->getGeometries().end() );
+	}
+
+	// Same node count, so the same number of leaves
+	const int leafCount = ( (int)nodes.size() + 1 ) / 2;
+	if( (int)geometries.size() < leafCount )
+	{
+		printf( "TreeRefitter: subtree has empty leaves, not rebuilt!\n" );
+		return;
+	}
+
+	for( unsigned int i = 0; i < nodes.size(); ++i )
+	{
+		nodes[i]->setLeftChild( NULL );
+		nodes[i]->setRightChild( NULL );
+		nodes[i]->getGeometries().clear();
+	}
+
+	// Smallest id first: consecutive pre-order ids stay so
+	std::sort( ids.begin(), ids.end() );
+
+	// First node is the subtree root, so its parent does not change
+	int next = 0;
+	buildNode( nodes, ids, next, geometries, 0, (int)geometries.size(), leafCount );
+
+	indexSubtree( root );
+	_changedIds.insert( _changedIds.end(), ids.begin(), ids.end() );
+	_rebuiltNodeCount += (int)nodes.size();
+}
+
+Node* TreeRefitter::buildNode( std::vector< vr::ref_ptr<Node> >& nodes, const std::vector<int>& ids, int& next, GeometryVector& geometries, int begin, int end, int leafCount )
+{
+	Node* node = nodes[next].get();
+	node->setId( ids[next] );
+	++next;
+
+	if( leafCount == 1 )
+	{
+		node->getGeometries().assign( geometries.begin() + begin, geometries.begin() + end );
+		fitBox( node, false );
+		return node;
+	}
+
+	// Split along longest extent of geometry centers
+	vr::vec3f minCenter = geometries[begin]->getBoundingBox().center;
+	vr::vec3f maxCenter = minCenter;
+	for( int i = begin + 1; i < end; ++i )
+	{
+		const vr::vec3f& center = geometries[i]->getBoundingBox().center;
+		for( int a = 0; a < 3; ++a )
+		{
+			minCenter[a] = vr::min( minCenter[a], center[a] );
+			maxCenter[a] = vr::max( maxCenter[a], center[a] );
+		}
+	}
+
+	const vr::vec3f size = maxCenter - minCenter;
+	int axis = 0;
+	if( size[1] > size[axis] )
+		axis = 1;
+	if( size[2] > size[axis] )
+		axis = 2;
+
+	// Geometries are divided in proportion to leaves, each leaf gets at least one
+	const int leftLeaves = leafCount / 2;
+	const int rightLeaves = leafCount - leftLeaves;
+	const int count = end - begin;
+	const int leftCount = vr::clampTo( count * leftLeaves / leafCount, leftLeaves, count - rightLeaves );
+
+	std::nth_element( geometries.begin() + begin, geometries.begin() + begin + leftCount, geometries.begin() + end, GeometryCenterLess( axis ) );
+
+	node->setLeftChild( buildNode( nodes, ids, next, geometries, begin, begin + leftCount, leftLeaves ) );
+	node->setRightChild( buildNode( nodes, ids, next, geometries, begin + leftCount, end, rightLeaves ) );
+
+	fitBox( node, false );
+	return node;
+}
+
+void TreeRefitter::fitBox( Node* node, bool refit )
+{
+	std::vector<Box>& boxes = _boxes;
+
+	if( node->isLeaf() )
+	{
+		// Only the root may be an empty leaf
+		GeometryVector& geometries = node->getGeometries();
+		if( geometries.empty() )
+		{
+			node->getBoundingBox().extents.set( 0.0f, 0.0f, 0.0f );
+			return;
+		}
+
+		boxes.resize( geometries.size() );
+		for( unsigned int i = 0; i < geometries.size(); ++i )
+			boxes[i] = geometries[i]->getBoundingBox();
+	}
+	else
+	{
+		boxes.resize( 2 );
+		boxes[0] = node->getLeftChild()->getBoundingBox();
+		boxes[1] = node->getRightChild()->getBoundingBox();
+	}
+
+	if( refit )
+	{
+		BoxFactory::refitBox( node->getBoundingBox(), &boxes[0], (int)boxes.size() );
+		return;
+	}
+
+	// Geometry moments are no longer available, OBBs are fit to the corners of the boxes
+	BoxFactory::BoxType type = BoxFactory::getDefaultBoxType();
+	if( type != BoxFactory::Type_Aabb )
+		type = BoxFactory::Type_Obb_Tight;
+
+	BoxFactory::createBox( node->getBoundingBox(), &boxes[0], NULL, (int)boxes.size(), type );
+}
+
+void TreeRefitter::indexSubtree( Node* root )
+{
+	for( PreOrderIterator it( root ); !it.done(); it.next() )
+	{
+		_referenceAreas[it->getId()] = surfaceArea( it->getBoundingBox() );
+		_dirty[it->getId()] = 0;
+
+		GeometryVector& geometries = it->getGeometries();
+		for( unsigned int i = 0; i < geometries.size(); ++i )
+			_geometryLeaves[geometries[i].get()] = it.current();
+	}
+}
+
+Node* TreeRefitter::findSibling( const Box& box )
+{
+	// Greedy descent: a new parent here costs its whole area,
+	// going down costs at least the growth of this node, which all nodes below must also enclose
+	Node* node = _root;
+	while( !node->isLeaf() )
+	{
+		const Box& nodeBox = node->getBoundingBox();
+		const float cost = mergedArea( nodeBox, nodeBox, box );
+		const float inheritedCost = cost - surfaceArea( nodeBox );
+
+		Node* children[2] = { node->getLeftChild(), node->getRightChild() };
+		float childCosts[2];
+		for( int i = 0; i < 2; ++i )
+		{
+			const Box& childBox = children[i]->getBoundingBox();
+			childCosts[i] = mergedArea( childBox, childBox, box ) + inheritedCost;
+			if( !children[i]->isLeaf() )
+				childCosts[i] -= surfaceArea( childBox );
+		}
+
+		if( cost < childCosts[0] && cost < childCosts[1] )
+			break;
+
+		node = ( childCosts[0] < childCosts[1] ) ? children[0] : children[1];
+	}
+
+	return node;
+}
+
+void TreeRefitter::rotateNode( Node* node )
+{
+	Node* children[2] = { node->getLeftChild(), node->getRightChild() };
+
+	float bestGain = 0.0f;
+	Node* bestChild = NULL;
+	Node* bestGrandchild = NULL;
+
+	for( int i = 0; i < 2; ++i )
+	{
+		Node* other = children[1 - i];
+		if( other->isLeaf() )
+			continue;
+
+		// Child takes the place of one grandchild, which moves up
+		const Box& otherBox = other->getBoundingBox();
+		Node* grandchildren[2] = { other->getLeftChild(), other->getRightChild() };
+		for( int j = 0; j < 2; ++j )
+		{
+			const float gain = surfaceArea( otherBox ) - mergedArea( otherBox, children[i]->getBoundingBox(), grandchildren[1 - j]->getBoundingBox() );
+			if( gain > bestGain )
+			{
+				bestGain = gain;
+				bestChild = children[i];
+				bestGrandchild = grandchildren[j];
+			}
+		}
+	}
+
+	if( bestChild == NULL )
+		return;
+
+	vr::ref_ptr<Node> child = bestChild;
+	vr::ref_ptr<Node> grandchild = bestGrandchild;
+	Node* other = grandchild->getParent();
+
+	replaceChild( node, child.get(), grandchild.get() );
+	replaceChild( other, grandchild.get(), child.get() );
+
+	fitBox( other, true );
+	_referenceAreas[other->getId()] = surfaceArea( other->getBoundingBox() );
+	_changedIds.push_back( other->getId() );
+	++_rotationCount;
+}
+
+Node* TreeRefitter::createNode()
+{
+	int id;
+	if( !_freeIds.empty() )
+	{
+		id = _freeIds.back();
+		_freeIds.pop_back();
+	}
+	else
+	{
+		id = (int)_referenceAreas.size();
+		_referenceAreas.push_back( 0.0f );
+		_dirty.push_back( 0 );
+	}
+
+	_referenceAreas[id] = 0.0f;
+	_dirty[id] = 0;
+	_changedIds.push_back( id );
+	return new Node( id );
+}
+
+void TreeRefitter::releaseNode( Node* node )
+{
+	_freeIds.push_back( node->getId() );
+	_dirty[node->getId()] = 0;
+	_dirtyLeaves.erase( std::remove( _dirtyLeaves.begin(), _dirtyLeaves.end(), node ), _dirtyLeaves.end() );
+}
+
+void TreeRefitter::moveContent( Node* from, Node* to )
+{
+	to->setLeftChild( from->getLeftChild() );
+	to->setRightChild( from->getRightChild() );
+	from->setLeftChild( NULL );
+	from->setRightChild( NULL );
+
+	to->getGeometries().swap( from->getGeometries() );
+	GeometryVector& geometries = to->getGeometries();
+	for( unsigned int i = 0; i < geometries.size(); ++i )
+		_geometryLeaves[geometries[i].get()] = to;
+
+	to->getBoundingBox() = from->getBoundingBox();
+	_referenceAreas[to->getId()] = _referenceAreas[from->getId()];
+
+	// Pending refits below must still be reached
+	_dirty[to->getId()] = _dirty[from->getId()];
+	std::replace( _dirtyLeaves.begin(), _dirtyLeaves.end(), from, to );
+}
+
+void TreeRefitter::markStructure( Node* node )
+{
+	for( ; node != NULL; node = node->getParent() )
+		_dirty[node->getId()] = Dirty_Structure;
+}
+
+void TreeRefitter::replaceChild( Node* parent, Node* child, Node* newChild )
+{
+	if( parent->getLeftChild() == child )
+		parent->setLeftChild( newChild );
+	else
+		parent->setRightChild( newChild );
+}
+
+float TreeRefitter::mergedArea( const Box& axes, const Box& first, const Box& second )
+{
+	Box boxes[2] = { first, second };
+	Box merged = axes;
+	BoxFactory::refitBox( merged, boxes, 2 );
+	return surfaceArea( merged );
+}
+
+float TreeRefitter::surfaceArea( const Box& box )
+{
+	const vr::vec3f& e = box.extents;
+	return 8.0f * ( e[0] * e[1] + e[1] * e[2] + e[2] * e[0] );
+}
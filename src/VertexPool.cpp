@@ -0,0 +1,121 @@
+#include <vdlib/VertexPool.h>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using namespace vdlib;
+
+VertexPool::VertexPool()
+{
+	_chunkSize = Default_Chunk_Size;
+	_blockStart = 0;
+	_size = 0;
+}
+
+VertexPool::~VertexPool()
+{
+	clear();
+}
+
+void VertexPool::setChunkSize( vr::int64 size )
+{
+	_chunkSize = vr::max( size, (vr::int64)1 );
+}
+
+vr::int64 VertexPool::getChunkSize() const
+{
+	return _chunkSize;
+}
+
+void VertexPool::beginBlock()
+{
+	_blockStart = _chunks.empty() ? 0 : _chunks.back().used;
+}
+
+float* VertexPool::append( vr::int64 size )
+{
+	if( _chunks.empty() || _chunks.back().used + size > _chunks.back().capacity )
+		allocateChunk( getBlockSize() + size );
+
+	Chunk& chunk = _chunks.back();
+	float* result = chunk.data + chunk.used;
+	chunk.used += size;
+	_size += size;
+	return result;
+}
+
+float* VertexPool::getBlock() const
+{
+	if( _chunks.empty() )
+		return NULL;
+	return _chunks.back().data + _blockStart;
+}
+
+vr::int64 VertexPool::getBlockSize() const
+{
+	if( _chunks.empty() )
+		return 0;
+	return _chunks.back().used - _blockStart;
+}
+
+void VertexPool::clear()
+{
+	for( unsigned int i = 0; i < _chunks.size(); ++i )
+		free( _chunks[i].data );
+
+	vr::vectorFreeMemory( _chunks );
+	_blockStart = 0;
+	_size = 0;
+}
+
+vr::int64 VertexPool::getSize() const
+{
+	return _size;
+}
+
+vr::int64 VertexPool::getCapacity() const
+{
+	vr::int64 capacity = 0;
+	for( unsigned int i = 0; i < _chunks.size(); ++i )
+		capacity += _chunks[i].capacity;
+	return capacity;
+}
+
+void VertexPool::allocateChunk( vr::int64 size )
+{
+	vr::int64 blockSize = getBlockSize();
+
+	// Blocks larger than a chunk grow geometrically, so that appending to them stays linear
+	const vr::int64 capacity = vr::max( _chunkSize, ( blockSize > 0 ) ? 2 * size : size );
+
+	// Block alone in its chunk: grow the chunk itself, so that the allocator can extend or remap it without a copy
+	if( blockSize > 0 && _blockStart == 0 )
+	{
+		Chunk& chunk = _chunks.back();
+		float* data = (float*)realloc( chunk.data, (size_t)capacity * sizeof( float ) );
+		if( data == NULL )
+			throw std::bad_alloc();
+
+		chunk.data = data;
+		chunk.capacity = capacity;
+		return;
+	}
+
+	Chunk chunk;
+	chunk.capacity = capacity;
+	chunk.data = (float*)malloc( (size_t)capacity * sizeof( float ) );
+	if( chunk.data == NULL )
+		throw std::bad_alloc();
+	chunk.used = blockSize;
+
+	// Block shares previous chunk with finished blocks, which must not move: copy it
+	if( blockSize > 0 )
+	{
+		Chunk& previous = _chunks.back();
+		std::copy( previous.data + _blockStart, previous.data + previous.used, chunk.data );
+		previous.used = _blockStart;
+	}
+
+	_chunks.push_back( chunk );
+	_blockStart = 0;
+}